@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string_view>
+
+namespace Airship::Bench {
+
+// Keeps the optimizer from discarding a value we only compute for timing
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory"); // NOLINT(hicpp-no-assembler)
+}
+
+// Runs fn(iterations) after a warm-up pass and returns the average nanoseconds per iteration
+template <typename Fn>
+double MeasureNs(size_t iterations, Fn&& fn) {
+    fn(iterations / 10);
+
+    const auto start = std::chrono::steady_clock::now();
+    fn(iterations);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(iterations);
+}
+
+inline void Report(std::string_view name, double nsPerIteration) {
+    std::printf("%-40.*s %10.2f ns/op %14.0f ops/s\n", static_cast<int>(name.size()), name.data(), nsPerIteration,
+                1e9 / nsPerIteration);
+}
+
+} // namespace Airship::Bench
@@ -0,0 +1,256 @@
+#include "core/event.h"
+
+#include <any>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bench/common.h"
+
+// Events/sec through EventPublisher, against the std::any dispatch and mutex-guarded queue it replaced (reproduced
+// below)
+
+namespace {
+constexpr size_t ITERATIONS = 2'000'000;
+constexpr int SUBSCRIBERS = 4;
+
+// Each event has something cheap to read, so the callbacks can't be optimized away
+struct SmallEvent {
+    int value;
+    [[nodiscard]] uint64_t payloadSum() const { return static_cast<uint64_t>(value); }
+};
+
+// Past std::any's small buffer, so the old path allocated for every callback
+struct LargeEvent {
+    std::array<uint64_t, 16> payload;
+    [[nodiscard]] uint64_t payloadSum() const { return payload[0] + payload[15]; }
+};
+
+class LegacyPublisher {
+    struct WrapperInterface {
+        virtual ~WrapperInterface() = default;
+        virtual void PublishSync(LegacyPublisher* publisher) = 0;
+    };
+    template <class EventType>
+    struct Wrapper : WrapperInterface {
+        Wrapper(const EventType& e) : event(e) {}
+        void PublishSync(LegacyPublisher* publisher) override { publisher->PublishSync(event); }
+        EventType event;
+    };
+
+public:
+    template <class EventType, class CallbackType>
+    void AddSubscriber(const CallbackType& callback) {
+        m_EventCallbacks.emplace(typeid(EventType),
+                                 [callback](std::any event) { callback(std::any_cast<EventType>(event)); });
+    }
+
+    template <class EventType>
+    void PublishSync(const EventType& event) {
+        auto eventsRange = m_EventCallbacks.equal_range(typeid(EventType));
+        for (auto it = eventsRange.first; it != eventsRange.second; ++it)
+            it->second(std::any(event));
+    }
+
+    template <class EventType>
+    void Publish(const EventType& event) {
+        std::scoped_lock const lock(m_QueueMutex);
+        m_QueuedEvents.push_back(std::make_unique<Wrapper<EventType>>(event));
+    }
+
+    void Process() {
+        std::unique_lock<std::mutex> lock(m_QueueMutex);
+        std::vector<std::unique_ptr<WrapperInterface>> events;
+        std::swap(events, m_QueuedEvents);
+        lock.unlock();
+        for (const auto& event : events)
+            event->PublishSync(this);
+    }
+
+private:
+    std::unordered_multimap<std::type_index, std::function<void(const std::any&)>> m_EventCallbacks;
+    std::vector<std::unique_ptr<WrapperInterface>> m_QueuedEvents;
+    std::mutex m_QueueMutex;
+};
+
+template <class EventType>
+double LegacyPublishSync() {
+    LegacyPublisher pub;
+    uint64_t sink = 0;
+    for (int i = 0; i < SUBSCRIBERS; ++i)
+        pub.AddSubscriber<EventType>([&sink](const EventType& e) { sink += e.payloadSum(); });
+
+    const EventType event{};
+    double ns = Airship::Bench::MeasureNs(ITERATIONS, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i)
+            pub.PublishSync(event);
+    });
+    Airship::Bench::DoNotOptimize(sink);
+    return ns;
+}
+
+template <class EventType>
+double TypedPublishSync() {
+    Airship::EventPublisher pub;
+    std::array<Airship::EventSubscriber, SUBSCRIBERS> subscribers;
+    uint64_t sink = 0;
+    for (auto& subscriber : subscribers)
+        subscriber.SubscribeTo<EventType>(pub, [&sink](const EventType& e) { sink += e.payloadSum(); });
+
+    const EventType event{};
+    double ns = Airship::Bench::MeasureNs(ITERATIONS, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i)
+            pub.PublishSync(event);
+    });
+    Airship::Bench::DoNotOptimize(sink);
+    return ns;
+}
+
+// PRODUCERS threads publish while the main thread calls Process, like worker threads feeding the game loop
+template <class Publisher, class EventType>
+double ThreadedPublish() {
+    constexpr int PRODUCERS = 4;
+    Publisher pub;
+    uint64_t sink = 0;
+    std::array<Airship::EventSubscriber, SUBSCRIBERS> subscribers;
+    for (auto& subscriber : subscribers) {
+        const auto callback = [&sink](const EventType& e) { sink += e.payloadSum(); };
+        if constexpr (std::is_same_v<Publisher, LegacyPublisher>)
+            pub.template AddSubscriber<EventType>(callback);
+        else
+            subscriber.template SubscribeTo<EventType>(pub, callback);
+    }
+
+    const EventType event{};
+    double ns = Airship::Bench::MeasureNs(ITERATIONS, [&](size_t n) {
+        std::atomic<int> finished = 0;
+        std::vector<std::thread> producers;
+        for (int p = 0; p < PRODUCERS; ++p) {
+            producers.emplace_back([&] {
+                for (size_t i = 0; i < n / PRODUCERS; ++i)
+                    pub.Publish(event);
+                ++finished;
+            });
+        }
+        while (finished < PRODUCERS)
+            pub.Process();
+        for (auto& producer : producers)
+            producer.join();
+        pub.Process();
+    });
+    Airship::Bench::DoNotOptimize(sink);
+    return ns;
+}
+// A frame's worth of queued events, consumed by per-event or batch subscribers
+template <class EventType, bool Batch>
+double QueuedFrame() {
+    constexpr size_t FRAME_EVENTS = 10000;
+    Airship::EventPublisher pub;
+    std::array<Airship::EventSubscriber, SUBSCRIBERS> subscribers;
+    uint64_t sink = 0;
+    for (auto& subscriber : subscribers) {
+        if constexpr (Batch) {
+            subscriber.template SubscribeBatch<EventType>(pub, [&sink](std::span<const EventType> events) {
+                for (const auto& e : events)
+                    sink += e.payloadSum();
+            });
+        } else {
+            subscriber.template SubscribeTo<EventType>(pub, [&sink](const EventType& e) { sink += e.payloadSum(); });
+        }
+    }
+
+    const EventType event{};
+    double ns = Airship::Bench::MeasureNs(ITERATIONS, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            pub.Publish(event);
+            if (i % FRAME_EVENTS == FRAME_EVENTS - 1) pub.Process();
+        }
+        pub.Process();
+    });
+    Airship::Bench::DoNotOptimize(sink);
+    return ns;
+}
+
+// A frame of events whose handlers each do a few microseconds of work, run serially or spread over the job system
+double HeavyHandlerFrame(Airship::JobSystem* jobs) {
+    constexpr size_t FRAME_EVENTS = 1000;
+    constexpr int WORK_ROUNDS = 500;
+    Airship::EventPublisher pub;
+    pub.SetJobSystem(jobs);
+    std::array<Airship::EventSubscriber, SUBSCRIBERS> subscribers;
+    std::atomic<uint64_t> sink = 0;
+    for (auto& subscriber : subscribers) {
+        subscriber.SubscribeTo<SmallEvent>(
+            pub,
+            [&sink](const SmallEvent& e) {
+                uint64_t hash = e.payloadSum();
+                for (int i = 0; i < WORK_ROUNDS; ++i)
+                    hash = hash * 6364136223846793005ULL + 1442695040888963407ULL;
+                sink.fetch_add(hash, std::memory_order_relaxed);
+            },
+            Airship::ThreadAffinity::AnyThread);
+    }
+
+    const SmallEvent event{.value = 1};
+    double ns = Airship::Bench::MeasureNs(ITERATIONS / 100, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            pub.Publish(event);
+            if (i % FRAME_EVENTS == FRAME_EVENTS - 1) pub.Process();
+        }
+        pub.Process();
+    });
+    Airship::Bench::DoNotOptimize(sink);
+    return ns;
+}
+
+// Despawning: destroy subscribers, each holding one subscription, out of a large publisher
+double SubscriberTeardown() {
+    constexpr size_t SUBSCRIBERS = 10000;
+    Airship::EventPublisher pub;
+    uint64_t sink = 0;
+    double ns = Airship::Bench::MeasureNs(SUBSCRIBERS * 20, [&](size_t n) {
+        for (size_t done = 0; done < n; done += SUBSCRIBERS) {
+            std::vector<std::unique_ptr<Airship::EventSubscriber>> subscribers(SUBSCRIBERS);
+            for (auto& subscriber : subscribers) {
+                subscriber = std::make_unique<Airship::EventSubscriber>();
+                subscriber->SubscribeTo<SmallEvent>(pub, [&sink](const SmallEvent& e) { sink += e.payloadSum(); });
+            }
+            subscribers.clear();
+        }
+    });
+    Airship::Bench::DoNotOptimize(sink);
+    return ns;
+}
+} // namespace
+
+int main() {
+    std::printf("%d subscribers, times are per published event\n", SUBSCRIBERS);
+    Airship::Bench::Report("legacy PublishSync small", LegacyPublishSync<SmallEvent>());
+    Airship::Bench::Report("typed PublishSync small", TypedPublishSync<SmallEvent>());
+    Airship::Bench::Report("legacy PublishSync 128B", LegacyPublishSync<LargeEvent>());
+    Airship::Bench::Report("typed PublishSync 128B", TypedPublishSync<LargeEvent>());
+    Airship::Bench::Report("legacy 4-thread Publish small", ThreadedPublish<LegacyPublisher, SmallEvent>());
+    Airship::Bench::Report("queued 4-thread Publish small", ThreadedPublish<Airship::EventPublisher, SmallEvent>());
+    Airship::Bench::Report("legacy 4-thread Publish 128B", ThreadedPublish<LegacyPublisher, LargeEvent>());
+    Airship::Bench::Report("queued 4-thread Publish 128B", ThreadedPublish<Airship::EventPublisher, LargeEvent>());
+    Airship::Bench::Report("queued frame, per-event callbacks", QueuedFrame<SmallEvent, false>());
+    Airship::Bench::Report("queued frame, batch callbacks", QueuedFrame<SmallEvent, true>());
+    Airship::Bench::Report("subscribe + destroy subscriber (10k)", SubscriberTeardown());
+
+    Airship::JobSystem jobs;
+    Airship::Bench::Report("heavy handlers, serial", HeavyHandlerFrame(nullptr));
+    std::printf("%zu workers\n", jobs.WorkerCount());
+    Airship::Bench::Report("heavy handlers, job system", HeavyHandlerFrame(&jobs));
+}
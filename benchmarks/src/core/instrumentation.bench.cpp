@@ -0,0 +1,47 @@
+#include "core/instrumentation.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "bench/common.h"
+
+// Reports the cost of reading each clock source, and the full per-scope overhead (two timestamps plus two ring
+// buffer pushes) when tracing with it. Build with AIRSHIP_INSTRUMENTATION, otherwise scopes compile to nothing.
+
+namespace {
+constexpr size_t ITERATIONS = 10'000'000;
+
+constexpr std::array<std::pair<Airship::Profiling::ClockSource, const char*>, 3> sources = {{
+    {Airship::Profiling::ClockSource::SteadyClock, "steady_clock"},
+    {Airship::Profiling::ClockSource::MonotonicRaw, "CLOCK_MONOTONIC_RAW"},
+    {Airship::Profiling::ClockSource::Tsc, "rdtsc"},
+}};
+} // namespace
+
+int main() {
+    // Keep the buffers small enough to stay in cache; we only care about the recording cost
+    Airship::Profiling::setBufferCapacity(4096);
+
+    for (const auto& [source, name] : sources) {
+        if (!Airship::Profiling::setClockSource(source)) {
+            std::printf("%-40s unavailable on this platform\n", name);
+            continue;
+        }
+
+        double clockNs = Airship::Bench::MeasureNs(ITERATIONS, [](size_t n) {
+            for (size_t i = 0; i < n; ++i)
+                Airship::Bench::DoNotOptimize(Airship::Profiling::now());
+        });
+        Airship::Bench::Report(std::string(name) + " read", clockNs);
+
+        double scopeNs = Airship::Bench::MeasureNs(ITERATIONS, [](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                PROFILE_SCOPE("bench scope");
+            }
+        });
+        Airship::Bench::Report(std::string(name) + " PROFILE_SCOPE", scopeNs);
+    }
+}
@@ -0,0 +1,59 @@
+#include "core/job_system.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "bench/common.h"
+
+// Scheduling overhead per job, and ParallelFor over a cheap loop body against running it serially
+
+namespace {
+constexpr size_t ITERATIONS = 1'000'000;
+
+// Empty jobs scheduled from the main thread, then waited on as one batch
+double RunAndWait(Airship::JobSystem& jobs) {
+    constexpr size_t BATCH = 1000;
+    std::atomic<uint64_t> sink = 0;
+    double ns = Airship::Bench::MeasureNs(ITERATIONS, [&](size_t n) {
+        Airship::JobCounter counter;
+        for (size_t i = 0; i < n; ++i) {
+            jobs.Run([&sink] { sink.fetch_add(1, std::memory_order_relaxed); }, &counter);
+            if (i % BATCH == BATCH - 1) jobs.Wait(counter);
+        }
+        jobs.Wait(counter);
+    });
+    Airship::Bench::DoNotOptimize(sink);
+    return ns;
+}
+
+// Per element, over a 64k element array
+template <bool Parallel>
+double Transform(Airship::JobSystem& jobs) {
+    constexpr size_t ELEMENTS = 65536;
+    std::vector<float> values(ELEMENTS, 1.0f);
+    double ns = Airship::Bench::MeasureNs(ITERATIONS * 20, [&](size_t n) {
+        for (size_t done = 0; done < n; done += ELEMENTS) {
+            const auto body = [&values](size_t i) { values[i] = values[i] * 0.999f + 0.5f; };
+            if constexpr (Parallel) {
+                jobs.ParallelFor(0, ELEMENTS, body);
+            } else {
+                for (size_t i = 0; i < ELEMENTS; ++i)
+                    body(i);
+            }
+        }
+    });
+    Airship::Bench::DoNotOptimize(values);
+    return ns;
+}
+} // namespace
+
+int main() {
+    Airship::JobSystem jobs;
+    std::printf("%zu workers\n", jobs.WorkerCount());
+    Airship::Bench::Report("Run + Wait, empty job", RunAndWait(jobs));
+    Airship::Bench::Report("transform, serial", Transform<false>(jobs));
+    Airship::Bench::Report("transform, ParallelFor", Transform<true>(jobs));
+}
@@ -0,0 +1,68 @@
+#include "core/pool_allocator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "bench/common.h"
+
+// Allocating and freeing small objects from the pool against new/delete, on one thread and on several at once
+
+namespace {
+constexpr size_t ITERATIONS = 1'000'000;
+constexpr size_t LIVE = 256;
+constexpr size_t THREADS = 4;
+
+struct Object {
+    uint64_t values[8];
+};
+
+// Keeps LIVE objects around, replacing one per iteration in a scattered order
+template <bool Pooled>
+void Churn(size_t n) {
+    std::vector<Object*> live(LIVE, nullptr);
+    for (size_t i = 0; i < n; ++i) {
+        Object*& slot = live[(i * 97) % LIVE];
+        if constexpr (Pooled) {
+            Airship::PoolAllocator::Get().Delete(slot);
+            slot = Airship::PoolAllocator::Get().New<Object>();
+        } else {
+            delete slot;
+            slot = new Object();
+        }
+        slot->values[0] = i;
+    }
+    Airship::Bench::DoNotOptimize(live);
+    for (Object* object : live) {
+        if constexpr (Pooled)
+            Airship::PoolAllocator::Get().Delete(object);
+        else
+            delete object;
+    }
+}
+
+template <bool Pooled>
+double SingleThread() {
+    return Airship::Bench::MeasureNs(ITERATIONS, [](size_t n) { Churn<Pooled>(n); });
+}
+
+// Per iteration on each thread, with THREADS threads churning at once
+template <bool Pooled>
+double MultiThread() {
+    return Airship::Bench::MeasureNs(ITERATIONS, [](size_t n) {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < THREADS; ++t)
+            threads.emplace_back([n] { Churn<Pooled>(n); });
+        for (auto& thread : threads)
+            thread.join();
+    });
+}
+} // namespace
+
+int main() {
+    Airship::Bench::Report("new/delete, 1 thread", SingleThread<false>());
+    Airship::Bench::Report("PoolAllocator, 1 thread", SingleThread<true>());
+    Airship::Bench::Report("new/delete, 4 threads", MultiThread<false>());
+    Airship::Bench::Report("PoolAllocator, 4 threads", MultiThread<true>());
+}
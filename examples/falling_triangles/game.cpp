@@ -4,6 +4,7 @@
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <numbers>
 #include <random>
@@ -11,6 +12,7 @@
 #include <vector>
 
 #include "core/input.h"
+#include "core/task.h"
 #include "core/utils.hpp"
 #include "core/window.h"
 #include "render/color.h"
@@ -23,6 +25,7 @@ constexpr float MIN_TRIANGLE_EXTENT = 0.1f; // Min distance from center to verte
 constexpr float MAX_TRIANGLE_EXTENT = 0.4f; // Max distance from center to vertex
 constexpr float AVOIDANCE_DEGREES = 90.0f; // Hue degrees away from background for triangle spawn
 constexpr float FAST_MODE_MULT = 3.0f; // Multiplier for hue rotation and falling speed in fast mode
+constexpr int MAX_TRIANGLES = 20;
 
 // clang-format off
 const char* const triangleVertexShaderSource =
@@ -180,20 +183,23 @@ void initTriangle(TriangleVertexData& v1, TriangleVertexData& v2, TriangleVertex
 
 void Game::OnStart() {
     CreatePipelines();
-    m_TriBuffer = std::make_unique<Airship::Buffer>();
-    m_BGHuesBuffer = std::make_unique<Airship::Buffer>();
+    // Both rewritten every frame
+    m_TriBuffer = std::make_unique<Airship::Buffer>(Airship::BufferUsage::Stream);
+    m_BGHuesBuffer = std::make_unique<Airship::Buffer>(Airship::BufferUsage::Stream);
     m_BGBuffer = std::make_unique<Airship::Buffer>();
+    m_BGIndexBuffer = std::make_unique<Airship::Buffer>();
 
     // bg moves down at DOWN_VEL screen space/sec
     // This takes t = 2 / DOWN_VEL seconds
     // During this time, the hue rotates by HUE_ROTATION_SPEED * t degrees
     auto bottomBgHue = HUE_ROTATION_SPEED * 2 / DOWN_VEL;
-    m_BGPositions = {{-1.0f, 1.0f, 0.0f}, {1.0f, 1.0f, 0.0f},  {-1.0f, -1.0f, 0.0f},
-                     {1.0f, 1.0f, 0.0f},  {1.0f, -1.0f, 0.0f}, {-1.0f, -1.0f, 0.0f}};
-    m_BGHues = {m_BGHue, m_BGHue, bottomBgHue, m_BGHue, bottomBgHue, bottomBgHue};
+    m_BGPositions = {{-1.0f, 1.0f, 0.0f}, {1.0f, 1.0f, 0.0f}, {-1.0f, -1.0f, 0.0f}, {1.0f, -1.0f, 0.0f}};
+    m_BGHues = {m_BGHue, m_BGHue, bottomBgHue, bottomBgHue};
+    const std::vector<uint32_t> bgIndices = {0, 1, 2, 1, 3, 2};
 
     m_BGBuffer->update(m_BGPositions.size() * sizeof(vec3), m_BGPositions.data());
     m_BGHuesBuffer->update(m_BGHues.size() * sizeof(float), m_BGHues.data());
+    const Airship::IndexType bgIndexType = m_BGIndexBuffer->updateIndices(bgIndices);
 
     m_BGMesh.setAttributeStream(
         "Position",
@@ -202,7 +208,8 @@ void Game::OnStart() {
                                         .stride = sizeof(float),
                                         .offset = 0,
                                         .format = Airship::ShaderDataType::Float});
-    m_BGMesh.setVertexCount(6);
+    m_BGMesh.setVertexCount(static_cast<int>(m_BGPositions.size()));
+    m_BGMesh.setIndexStream({.buffer = m_BGIndexBuffer.get(), .type = bgIndexType}, static_cast<int>(bgIndices.size()));
     m_TriMesh.setAttributeStream("Position", {.buffer = m_TriBuffer.get(),
                                               .stride = sizeof(TriangleVertexData),
                                               .offset = offsetof(TriangleVertexData, position),
@@ -211,42 +218,48 @@ void Game::OnStart() {
                                            .stride = sizeof(TriangleVertexData),
                                            .offset = offsetof(TriangleVertexData, color),
                                            .format = Airship::ShaderDataType::Float4});
+
+    GetTaskScheduler().Spawn(SpawnTriangles());
+}
+
+bool Game::TrySpawnTriangle() {
+    TriangleVertexData *v1, *v2, *v3;
+    if (m_TriMesh.vertexCount() < MAX_TRIANGLES * 3) {
+        m_TriVerts.emplace_back();
+        m_TriVerts.emplace_back();
+        m_TriVerts.emplace_back();
+        m_TriMesh.setVertexCount(static_cast<int>(m_TriVerts.size()));
+        v1 = &m_TriVerts[m_TriVerts.size() - 3];
+        v2 = &m_TriVerts[m_TriVerts.size() - 2];
+        v3 = &m_TriVerts[m_TriVerts.size() - 1];
+    } else {
+        v1 = &m_TriVerts[(m_LowestTriangleIndex * 3) + 0];
+        v2 = &m_TriVerts[(m_LowestTriangleIndex * 3) + 1];
+        v3 = &m_TriVerts[(m_LowestTriangleIndex * 3) + 2];
+
+        // Skip spawn if this triangle is still visible
+        if (v1->position.y() > -1.0f || v2->position.y() > -1.0f || v3->position.y() > -1.0f) return false;
+        m_LowestTriangleIndex = (m_LowestTriangleIndex + 1) % MAX_TRIANGLES;
+    }
+    initTriangle(*v1, *v2, *v3, m_BGHue);
+    return true;
+}
+
+Airship::Task<> Game::SpawnTriangles() {
+    Airship::TaskScheduler& tasks = GetTaskScheduler();
+    while (true) {
+        while (!TrySpawnTriangle())
+            co_await tasks.NextFrame();
+        // Counted in game time, which runs faster in fast mode
+        for (float waited = 0.0f; waited < SPAWN_INTERVAL;)
+            waited += (m_MoveFast ? FAST_MODE_MULT : 1.0f) * co_await tasks.NextFrame();
+    }
 }
 
 void Game::OnGameLoop(float elapsed) {
-    constexpr int maxTriangles = 20;
     elapsed = std::min(elapsed, 0.1f); // Clamp to avoid large jumps
     if (m_MoveFast) elapsed *= FAST_MODE_MULT;
 
-    m_TimeSinceSpawn += elapsed;
-    if (m_TimeSinceSpawn >= SPAWN_INTERVAL) {
-        TriangleVertexData *v1, *v2, *v3;
-        bool skipSpawn = false;
-        if (m_TriMesh.vertexCount() < maxTriangles * 3) {
-            m_TriVerts.emplace_back();
-            m_TriVerts.emplace_back();
-            m_TriVerts.emplace_back();
-            m_TriMesh.setVertexCount(static_cast<int>(m_TriVerts.size()));
-            v1 = &m_TriVerts[m_TriVerts.size() - 3];
-            v2 = &m_TriVerts[m_TriVerts.size() - 2];
-            v3 = &m_TriVerts[m_TriVerts.size() - 1];
-        } else {
-            v1 = &m_TriVerts[(m_LowestTriangleIndex * 3) + 0];
-            v2 = &m_TriVerts[(m_LowestTriangleIndex * 3) + 1];
-            v3 = &m_TriVerts[(m_LowestTriangleIndex * 3) + 2];
-
-            // Skip spawn if this triangle is still visible
-            if (v1->position.y() > -1.0f || v2->position.y() > -1.0f || v3->position.y() > -1.0f) {
-                skipSpawn = true;
-            } else {
-                m_LowestTriangleIndex = (m_LowestTriangleIndex + 1) % maxTriangles;
-            }
-        }
-        if (!skipSpawn) {
-            initTriangle(*v1, *v2, *v3, m_BGHue);
-            m_TimeSinceSpawn = 0;
-        }
-    }
     for (auto& vertex : m_TriVerts) {
         vertex.position.y() -= DOWN_VEL * elapsed;
         vertex.color.a -= 0.1f * elapsed;
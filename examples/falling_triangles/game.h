@@ -3,6 +3,7 @@
 
 #include "core/application.h"
 #include "core/input.h"
+#include "core/task.h"
 #include "core/utils.hpp"
 #include "core/window.h"
 #include "render/color.h"
@@ -26,12 +27,15 @@ public:
 
 private:
     void CreatePipelines();
+    // Reuses the oldest triangle once there are MAX_TRIANGLES, but only after it has fallen off screen
+    bool TrySpawnTriangle();
+    Airship::Task<> SpawnTriangles();
     // TODO: Change to platform management abstraction. Renderer classes have
     // inert constructors plus a factory method from the platform to create/validate.
     // Then we can remove these unique pointers.
     std::unique_ptr<Airship::Pipeline> m_TriPipeline, m_BGPipeline;
     std::unique_ptr<Airship::Material> m_TriMaterial, m_BGMaterial;
-    std::unique_ptr<Airship::Buffer> m_TriBuffer, m_BGBuffer, m_BGHuesBuffer;
+    std::unique_ptr<Airship::Buffer> m_TriBuffer, m_BGBuffer, m_BGHuesBuffer, m_BGIndexBuffer;
     Airship::Mesh m_TriMesh, m_BGMesh;
 
     std::vector<TriangleVertexData> m_TriVerts;
@@ -39,7 +43,6 @@ private:
     std::vector<float> m_BGHues;
     float m_BGHue = 0.0f;
 
-    float m_TimeSinceSpawn = 1.0f;
     int m_LowestTriangleIndex = 0;
     bool m_MoveFast = false;
 };
@@ -11,12 +11,12 @@
 #include "core/window.h"
 #include "grid.h"
 #include "render/color.h"
+#include "render/opengl/dynamic_mesh.h"
 #include "render/opengl/renderer.h"
 #include "snake.h"
 
 #define UNUSED(x) ((void) x)
 
-constexpr float FRAME_TIME = 0.1f;
 constexpr float LINE_WIDTH = 0.005f;
 
 // clang-format off
@@ -32,6 +32,20 @@ const char* const vertexShaderSource =
     "   vertexColor = aColor;\n"
     "}\0";
 
+// Per-instance offset and color, over a shared per-vertex shape
+const char* const instancedVertexShaderSource =
+    "#version 330 core\n"
+    "layout (location = 0) in vec2 aPos;\n"
+    "layout (location = 1) in vec4 aColor;\n"
+    "layout (location = 2) in vec2 aOffset;\n"
+    "out vec4 vertexColor;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "   gl_Position = vec4(aPos.x + aOffset.x, aPos.y + aOffset.y, 0.0, 1.0);\n"
+    "   vertexColor = aColor;\n"
+    "}\0";
+
 const char* const fragmentShaderSource =
     "#version 330 core\n"
     "in vec4 vertexColor;\n"
@@ -53,6 +67,15 @@ void Game::CreatePipelines() {
                                                          {"Color", 1, Airship::ShaderDataType::Float4},
                                                      });
     flatShadedMaterial = std::make_unique<Airship::Material>(m_Pipeline.get());
+    // Same coloring, for instanced meshes
+    Airship::Shader instancedVertexShader(Airship::ShaderType::Vertex, instancedVertexShaderSource);
+    m_InstancedPipeline = std::make_unique<Airship::Pipeline>(instancedVertexShader, fragmentShader,
+                                                              std::vector<Airship::Pipeline::VertexAttributeDesc>{
+                                                                  {"Position", 0, Airship::ShaderDataType::Float2},
+                                                                  {"Color", 1, Airship::ShaderDataType::Float4},
+                                                                  {"Offset", 2, Airship::ShaderDataType::Float2},
+                                                              });
+    instancedMaterial = std::make_unique<Airship::Material>(m_InstancedPipeline.get());
     // BG coloring pipeline - stored in text files
     auto bgVertShader = Airship::Shader::from_file(Airship::ShaderType::Vertex, "assets/grass.vert");
     auto bgFragShader = Airship::Shader::from_file(Airship::ShaderType::Fragment, "assets/grass.frag");
@@ -105,9 +128,10 @@ void Game::OnStart() {
 
     // Gridlines on the dual grid
     Grid dualGrid(GRID_SIZE, vec2{GRID_UL, GRID_UL}, {GRID_DIMS + 1, GRID_DIMS + 1});
-    OwningStream<vec2>& positionStream = m_GridMesh.addStream<vec2>("Position", Airship::ShaderDataType::Float2);
+    Airship::OwningStream<vec2>& positionStream =
+        m_GridMesh.addStream<vec2>("Position", Airship::ShaderDataType::Float2);
     std::vector<vec2>& positions = positionStream.data();
-    OwningStream<Airship::Color>& colorStream =
+    Airship::OwningStream<Airship::Color>& colorStream =
         m_GridMesh.addStream<Airship::Color>("Color", Airship::ShaderDataType::Float4);
     std::vector<Airship::Color>& colors = colorStream.data();
 
@@ -154,11 +178,12 @@ void Game::OnStart() {
     // BG mesh: just has positions, composed of a square across the background.
     auto& bgstream = m_BGMesh.addStream<vec2>("Position", Airship::ShaderDataType::Float2);
     auto& bgpos = bgstream.data();
-    for (const auto& pt : canonicalSquare) {
+    for (const auto& pt : canonicalQuad) {
         bgpos.emplace_back(pt * 2 - vec2(1.0f, 1.0f));
     }
     bgstream.invalidate();
-    m_BGMesh.setVertexCount(canonicalSquare.size());
+    m_BGMesh.setVertexCount(canonicalQuad.size());
+    m_BGMesh.setIndices(canonicalQuadIndices);
 
     m_Snake.Initialize({5, 5});
     ivec2 applePos;
@@ -170,7 +195,7 @@ void Game::OnStart() {
     backgroundMaterial->SetUniform("iMaxTipDeviation", 1.0f);
 }
 
-void Game::OnGameLoop(float elapsed) {
+void Game::OnGameLoop(float /*elapsed*/) {
     static const auto start_time = std::chrono::steady_clock::now();
     const auto cur_time = std::chrono::steady_clock::now();
     std::chrono::duration<float> duration = cur_time - start_time;
@@ -179,15 +204,12 @@ void Game::OnGameLoop(float elapsed) {
         constexpr Airship::Color deathColor = {0.2f, 0.0f, 0.0f};
         m_BladeTipColor = Airship::Color::lerp(m_BladeTipColor, deathColor, 0.05f);
         backgroundMaterial->SetUniform("iTip", m_BladeTipColor);
-        draw();
-        return;
     }
-    m_TickTime += elapsed;
-    if (m_TickTime < FRAME_TIME) {
-        draw();
-        return;
-    }
-    m_TickTime = 0;
+}
+
+void Game::OnFixedUpdate(float /*dt*/) {
+    if (!m_Snake.IsAlive()) return;
+
     SHIPLOG_DEBUG("Loop");
     m_Snake.Update(m_Apple->pos());
     if (!m_Snake.IsAlive()) {
@@ -200,5 +222,9 @@ void Game::OnGameLoop(float elapsed) {
         m_Apple->SetPos(applePos);
         m_Tallies.increment();
     }
+}
+
+void Game::OnRender(float /*alpha*/) {
+    // The snake moves a whole cell per tick, so there's nothing to interpolate
     draw();
 }
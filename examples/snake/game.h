@@ -1,8 +1,7 @@
 #include <cassert>
-#include <limits>
+#include <cstdint>
 #include <memory>
 
-#include "addons.h"
 #include "core/application.h"
 #include "core/input.h"
 #include "core/instrumentation.h"
@@ -10,6 +9,7 @@
 #include "core/window.h"
 #include "grid.h"
 #include "render/color.h"
+#include "render/opengl/dynamic_mesh.h"
 #include "render/opengl/renderer.h"
 #include "snake.h"
 #include "tallies.h"
@@ -21,6 +21,9 @@ constexpr float GRID_WIDTH = 2 * (1.0f - GRID_PADDING);
 constexpr float GRID_SIZE = GRID_WIDTH / GRID_DIMS;
 constexpr float GRID_UL = -1.0f + GRID_PADDING;
 
+// The snake moves one cell per tick
+constexpr float TICK_TIME = 0.1f;
+
 class Game : public Airship::Application {
 public:
     Game() :
@@ -28,34 +31,42 @@ public:
         Airship::Application(800, 800, "Snake Example"),
         m_Grid(GRID_SIZE, vec2{GRID_UL, GRID_UL}, {GRID_DIMS, GRID_DIMS}), m_Snake(&m_Grid) {
         Airship::ShipLog::get().SetLevel("default_log", Airship::ShipLog::Level::TRACE);
+        SetFixedTimestep(TICK_TIME);
     }
 
     void OnStart() override;
+    void OnFixedUpdate(float dt) override;
     void OnGameLoop(float elapsed) override;
+    void OnRender(float alpha) override;
     void OnKeyPress(const Airship::Window& window, Airship::Input::Key key, int scancode,
                     Airship::Input::KeyAction action, Airship::Input::KeyMods mods) override;
 
 private:
     void draw() {
         PROFILE_FUNCTION();
+        // Everything is queued and drawn at the end of the frame, one layer at a time
+        constexpr uint8_t BACKGROUND_LAYER = 0;
+        constexpr uint8_t GRID_LAYER = 1;
+        constexpr uint8_t PIECES_LAYER = 2;
         m_Renderer.clear();
-        m_BGMesh.draw(m_Renderer, *backgroundMaterial);
-        m_GridMesh.draw(m_Renderer, *flatShadedMaterial);
-        m_Snake.draw(m_Renderer, *flatShadedMaterial);
-        m_Apple->draw(m_Renderer, *flatShadedMaterial);
-        m_Tallies.draw(m_Renderer, *flatShadedMaterial);
+        m_BGMesh.draw(m_Renderer, *backgroundMaterial, BACKGROUND_LAYER);
+        m_GridMesh.draw(m_Renderer, *flatShadedMaterial, GRID_LAYER);
+        m_Snake.draw(m_Renderer, *instancedMaterial, PIECES_LAYER);
+        m_Apple->draw(m_Renderer, *flatShadedMaterial, PIECES_LAYER);
+        m_Tallies.draw(m_Renderer, *flatShadedMaterial, PIECES_LAYER);
     }
     void CreatePipelines();
     std::unique_ptr<Airship::Pipeline> m_Pipeline;
     std::unique_ptr<Airship::Material> flatShadedMaterial;
+    std::unique_ptr<Airship::Pipeline> m_InstancedPipeline;
+    std::unique_ptr<Airship::Material> instancedMaterial;
     std::unique_ptr<Airship::Pipeline> m_BGPipeline;
     std::unique_ptr<Airship::Material> backgroundMaterial;
-    float m_TickTime = std::numeric_limits<float>::max();
     Grid<2> m_Grid;
     std::unique_ptr<Apple> m_Apple;
     Snake m_Snake;
-    DynamicMesh m_GridMesh;
-    DynamicMesh m_BGMesh;
+    Airship::DynamicMesh m_GridMesh;
+    Airship::DynamicMesh m_BGMesh;
     // Let's use a darker green than what comes with Airship
     Airship::Color m_BladeTipColor = {0.04f, 0.07f, 0.0f};
     Tallies m_Tallies = {vec2(-0.95f, -0.97f), vec2(0.1f, 0.06f)};
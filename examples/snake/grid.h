@@ -33,6 +33,7 @@ public:
         if (boundsCheck) coords = getCoord(coords);
         return remap(coords);
     }
+    [[nodiscard]] float cellSize() const { return m_CellSize; }
     void SetOOBCallback(onOOBFunc<NDIMS> func) { m_OOBCallback = func; }
     [[nodiscard]] ivec<NDIMS> GetBounds() const { return m_Bounds; }
 
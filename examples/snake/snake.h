@@ -7,10 +7,10 @@
 #include <utility>
 #include <vector>
 
-#include "addons.h"
 #include "color.h"
 #include "core/utils.hpp"
 #include "grid.h"
+#include "opengl/dynamic_mesh.h"
 #include "opengl/renderer.h"
 
 constexpr Airship::Color SNAKE_COLOR = Airship::Colors::White;
@@ -68,6 +68,9 @@ private:
 constexpr std::array<ivec2, 6> canonicalSquare =
     {ivec2{0, 0}, ivec2{0, 1}, ivec2{1, 1},
      ivec2{0, 0}, ivec2{1, 1}, ivec2{1, 0}};
+// The same square, indexed
+constexpr std::array<ivec2, 4> canonicalQuad = {ivec2{0, 0}, ivec2{0, 1}, ivec2{1, 1}, ivec2{1, 0}};
+constexpr std::array<uint32_t, 6> canonicalQuadIndices = {0, 1, 2, 0, 2, 3};
 // clang-format on
 
 inline std::array<ivec2, 6> CreateSquare(ivec2 pos) {
@@ -78,45 +81,14 @@ inline std::array<ivec2, 6> CreateSquare(ivec2 pos) {
     return ret;
 }
 
+// Drawn by Snake, one instance per cell
 class SnakeCell {
 public:
-    SnakeCell() = default; // uninitialized Streams
-    void Initialize(ivec2 pos, const Grid<2>* grid) {
-        m_Grid = grid;
-        m_GridPos = pos;
-
-        m_MeshData.addStream<vec2>("Position", Airship::ShaderDataType::Float2);
-        m_MeshData.addStream<Airship::Color>("Color", Airship::ShaderDataType::Float4);
-
-        std::array<ivec2, canonicalSquare.size()> square = CreateSquare(m_GridPos); // on grid
-        std::vector<vec2> positions(square.size()); // on screen
-        std::vector<Airship::Color> colors(square.size());
-        for (size_t i = 0; i < square.size(); i++) {
-            positions[i] = m_Grid->pos(square.at(i));
-            colors[i] = SNAKE_COLOR;
-        }
-        OwningStream<vec2>& positionStream = m_MeshData.getStream<vec2>("Position");
-        positionStream.data() = positions; // on screen
-        positionStream.invalidate();
-
-        OwningStream<Airship::Color>& colorStream = m_MeshData.getStream<Airship::Color>("Color");
-        colorStream.data() = colors;
-        colorStream.invalidate();
-        m_MeshData.setVertexCount(canonicalSquare.size());
-        initialized = true;
-    }
-
-    void draw(const Airship::Renderer& renderer, const Airship::Material& mat) {
-        assert(initialized);
-        m_MeshData.draw(renderer, mat);
-    }
+    void Initialize(ivec2 pos) { m_GridPos = pos; }
     ivec2 pos() const { return m_GridPos; }
 
 private:
-    bool initialized = false;
     ivec2 m_GridPos = ivec2(0, 0);
-    const Grid<2>* m_Grid = nullptr;
-    DynamicMesh m_MeshData;
 };
 
 class Apple {
@@ -131,15 +103,16 @@ public:
             colors[i] = color;
         }
 
-        OwningStream<Airship::Color>& colorStream =
+        Airship::OwningStream<Airship::Color>& colorStream =
             m_MeshData.addStream<Airship::Color>("Color", Airship::ShaderDataType::Float4);
         colorStream.data() = colors;
         colorStream.invalidate();
         m_MeshData.setVertexCount(canonicalSquare.size());
     }
 
-    void draw(const Airship::Renderer& renderer, Airship::Pipeline* pipeline) { m_MeshData.draw(renderer, pipeline); }
-    void draw(const Airship::Renderer& renderer, const Airship::Material& mat) { m_MeshData.draw(renderer, mat); }
+    void draw(const Airship::Renderer& renderer, const Airship::Material& mat, uint8_t layer) {
+        m_MeshData.draw(renderer, mat, layer);
+    }
     ivec2 pos() const { return m_GridPos; }
     void SetPos(ivec2 gridPos) {
         m_GridPos = gridPos;
@@ -149,7 +122,7 @@ public:
         for (size_t i = 0; i < square.size(); i++) {
             positions[i] = m_Grid->pos(square.at(i));
         }
-        OwningStream<vec2>& positionStream = m_MeshData.getStream<vec2>("Position");
+        Airship::OwningStream<vec2>& positionStream = m_MeshData.getStream<vec2>("Position");
         positionStream.data() = positions; // on screen
         positionStream.invalidate();
     }
@@ -157,7 +130,7 @@ public:
 private:
     ivec2 m_GridPos = ivec2(0, 0);
     const Grid<2>* m_Grid = nullptr;
-    DynamicMesh m_MeshData;
+    Airship::DynamicMesh m_MeshData;
 };
 
 enum class Direction : uint8_t {
@@ -190,25 +163,44 @@ inline vec2 operator*(const ivec2& lhs, float scale) {
 class Snake {
 public:
     Snake(const Grid<2>* grid) : m_Grid(grid), m_Cells(256) {}
+    // Needs the renderer up, for the mesh
     void Initialize(ivec<2> location) {
         assert(m_Cells.GetCount() == 0);
         auto& newHead = m_Cells.PushHead();
-        newHead.Initialize(location, m_Grid);
+        newHead.Initialize(location);
+
+        // A single cell-sized square, drawn once per cell at that cell's offset
+        Airship::OwningStream<vec2>& squareStream = m_Mesh.addStream<vec2>("Position", Airship::ShaderDataType::Float2);
+        for (const ivec2& corner : canonicalQuad)
+            squareStream.data().push_back(corner * m_Grid->cellSize());
+        squareStream.invalidate();
+        m_Mesh.setVertexCount(canonicalQuad.size());
+        m_Mesh.setIndices(canonicalQuadIndices);
+        // Rewritten every frame
+        m_Mesh.addStream<vec2>("Offset", Airship::ShaderDataType::Float2, 1, Airship::BufferUsage::Stream);
+        m_Mesh.addStream<Airship::Color>("Color", Airship::ShaderDataType::Float4, 1, Airship::BufferUsage::Stream);
     }
     void Grow() {
         const auto& tailCell = m_Cells.GetElem(m_Cells.GetCount() - 1);
         auto& newTail = m_Cells.PushTail();
-        newTail.Initialize(tailCell.pos(), m_Grid);
+        newTail.Initialize(tailCell.pos());
     }
     [[nodiscard]] ivec2 HeadPos() const { return m_Cells.GetElem(0).pos(); }
     void SetDir(Direction dir) { m_MoveDir = dir; }
     [[nodiscard]] Direction GetDir() { return m_MoveDir; }
     void PopTail() { m_Cells.PopTail(); }
-    void draw(const Airship::Renderer& renderer, const Airship::Material& mat) {
-        for (int i = static_cast<int>(m_Cells.GetCount()) - 1; i >= 0; --i) {
-            auto& cell = m_Cells.GetElem(i);
-            cell.draw(renderer, mat);
-        }
+    // mat has to take per-instance "Offset" and "Color" streams
+    void draw(const Airship::Renderer& renderer, const Airship::Material& mat, uint8_t layer) {
+        Airship::OwningStream<vec2>& offsetStream = m_Mesh.getStream<vec2>("Offset");
+        Airship::OwningStream<Airship::Color>& colorStream = m_Mesh.getStream<Airship::Color>("Color");
+        offsetStream.data().clear();
+        for (size_t i = 0; i < m_Cells.GetCount(); i++)
+            offsetStream.data().push_back(m_Grid->pos(m_Cells.GetElem(i).pos()));
+        colorStream.data().resize(m_Cells.GetCount(), SNAKE_COLOR);
+        offsetStream.invalidate();
+        colorStream.invalidate();
+        m_Mesh.setInstanceCount(static_cast<int>(m_Cells.GetCount()));
+        m_Mesh.draw(renderer, mat, layer);
     }
 
     [[nodiscard]] bool IntersectsSelf(ivec2 pos) const {
@@ -232,7 +224,7 @@ public:
             PopTail();
         }
         auto& newHead = m_Cells.PushHead();
-        newHead.Initialize(nextPos, m_Grid);
+        newHead.Initialize(nextPos);
     }
 
     [[nodiscard]] bool IsAlive() const { return m_IsAlive; }
@@ -241,5 +233,6 @@ private:
     const Grid<2>* m_Grid;
     Direction m_MoveDir = Direction::Right;
     RingBuffer<SnakeCell> m_Cells;
+    Airship::DynamicMesh m_Mesh;
     bool m_IsAlive = true;
 };
\ No newline at end of file
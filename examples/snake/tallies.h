@@ -1,11 +1,13 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
-#include "addons.h"
 #include "core/utils.hpp"
 #include "render/color.h"
+#include "render/opengl/dynamic_mesh.h"
 #include "render/opengl/renderer.h"
 
 constexpr float TALLY_WIDTH = 0.015;
@@ -27,6 +29,8 @@ public:
         std::vector<vec>& positions = positionStream.data();
         auto& colorStream = m_MeshData.getStream<Airship::Color>("Color");
         std::vector<Airship::Color>& colors = colorStream.data();
+        // Only the new tally needs uploading
+        const size_t first = positions.size();
         if (m_Count == MAX_TALLIES - 1) {
             // Slashed tally
             vec shift = m_Offset;
@@ -66,15 +70,17 @@ public:
             colors.emplace_back(0.7f, 0.7f, 0.7f);
         }
         m_MeshData.setVertexCount(m_MeshData.vertexCount() + 6);
-        positionStream.invalidate();
-        colorStream.invalidate();
+        positionStream.invalidate(first, positions.size() - first);
+        colorStream.invalidate(first, colors.size() - first);
         m_Count++;
     }
     bool full() const { return m_Count == MAX_TALLIES; }
-    void draw(Airship::Renderer& renderer, const Airship::Material& mat) { m_MeshData.draw(renderer, mat); }
+    void draw(const Airship::Renderer& renderer, const Airship::Material& mat, uint8_t layer) {
+        m_MeshData.draw(renderer, mat, layer);
+    }
 
 private:
-    DynamicMesh m_MeshData;
+    Airship::DynamicMesh m_MeshData;
     int m_Count = 0;
     vec m_Offset;
     vec m_GroupSize;
@@ -92,9 +98,9 @@ public:
         }
         m_TallyGroups.back().increment();
     }
-    void draw(Airship::Renderer& renderer, const Airship::Material& mat) {
+    void draw(const Airship::Renderer& renderer, const Airship::Material& mat, uint8_t layer) {
         for (auto& group : m_TallyGroups)
-            group.draw(renderer, mat);
+            group.draw(renderer, mat, layer);
     }
 
 private:
@@ -1,25 +1,65 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
 
+#include "core/frame_arena.h"
+#include "core/frame_graph.h"
+#include "core/frame_stats.h"
 #include "core/input.h"
+#include "core/job_system.h"
+#include "core/task.h"
 #include "core/window.h"
 #include "render/opengl/renderer.h"
 
 namespace Airship {
 class Application {
 public:
+    static constexpr float DEFAULT_SERVER_TICK_RATE = 60.0f;
+    static constexpr std::chrono::milliseconds DEFAULT_TASK_BUDGET{2};
+
     Application() = default;
+    // Headless: no window, input or renderer, and the loop ticks at DEFAULT_SERVER_TICK_RATE (see SetTargetFrameRate)
     Application(bool serverMode);
-    Application(int width, int height, std::string title);
+    // An invisible window still gets a GL context, for offscreen rendering through a RenderTarget
+    Application(int width, int height, std::string title, bool visible = true);
     void Run();
     virtual ~Application();
 
+    // Scratch memory for the current frame, recycled FrameArena::FRAME_COUNT frames later. Main thread only.
+    [[nodiscard]] FrameArena& GetFrameArena() { return m_FrameArena; }
+    // Always-on frame timing histograms, independent of AIRSHIP_INSTRUMENTATION
+    [[nodiscard]] const FrameStats& GetFrameStats() const { return m_FrameStats; }
+    void ResetFrameStats() { m_FrameStats.reset(); }
+    // Log frame time percentiles every interval, then reset the stats so each report covers one interval. 0 disables.
+    void SetFrameStatsLogInterval(std::chrono::seconds interval) { m_FrameStatsLogInterval = interval; }
+
+    // Call OnFixedUpdate every `seconds` of game time, running at most maxStepsPerFrame steps per frame to catch up
+    // after a slow frame (the rest of the backlog is dropped). 0 disables fixed updates.
+    void SetFixedTimestep(float seconds, int maxStepsPerFrame = 5);
+    // Sleep at the end of each frame to hold this frame rate. 0 runs unlimited.
+    void SetTargetFrameRate(float framesPerSecond);
+    [[nodiscard]] bool IsServer() const { return m_ServerMode; }
+    // Shared job system, started on first use. Call from the main thread first, as that thread joins the workers.
+    [[nodiscard]] JobSystem& GetJobSystem();
+    // Systems registered here run every frame on the job system, after OnGameLoop and before OnRender
+    [[nodiscard]] FrameGraph& GetFrameGraph() { return m_FrameGraph; }
+    // Coroutines spawned here are resumed every frame, before OnGameLoop, on the main thread. Started on first use.
+    [[nodiscard]] TaskScheduler& GetTaskScheduler();
+    // How long each frame may spend resuming tasks; the rest carry over to the next frame
+    void SetTaskBudget(std::chrono::nanoseconds budget) { m_TaskBudget = budget; }
+
 protected:
     // User-facing hooks
     virtual void OnStart() {}
     virtual void OnGameLoop(float /*dt*/) {}
+    // Deterministic simulation step, see SetFixedTimestep. Runs before OnGameLoop.
+    virtual void OnFixedUpdate(float /*dt*/) {}
+    // Runs after OnGameLoop. alpha is how far (0-1) the current time is between the last fixed update and the next one,
+    // for interpolating simulation state. Always 1 without a fixed timestep.
+    virtual void OnRender(float /*alpha*/) {}
     // For keystroke handling, not text
     virtual void OnKeyPress(const Window& /*window*/, Input::Key /*key*/, int /*scancode*/, Input::KeyAction /*action*/,
                             Input::KeyMods /*mods*/) {}
@@ -27,12 +67,31 @@ protected:
     bool m_ShouldClose = false;
     Renderer m_Renderer;
 
+    // Null in server mode
     std::unique_ptr<Window> m_MainWindow;
     int m_Width = 800, m_Height = 600;
 
 private:
+    void InitWindowAndRenderer();
     void GameLoop();
+    void LogFrameStats() const;
+    void WaitForNextFrame(uint64_t frameStart) const;
     std::string m_Title;
     bool m_ServerMode = false;
+    bool m_Visible = true;
+
+    FrameArena m_FrameArena;
+    FrameStats m_FrameStats;
+    std::chrono::seconds m_FrameStatsLogInterval{0};
+
+    uint64_t m_FixedStepNs = 0;
+    int m_MaxFixedSteps = 5;
+    uint64_t m_TargetFrameNs = 0;
+
+    std::unique_ptr<JobSystem> m_JobSystem;
+    FrameGraph m_FrameGraph;
+    // After the job system, so it's destroyed first: it waits for its jobs
+    std::unique_ptr<TaskScheduler> m_TaskScheduler;
+    std::chrono::nanoseconds m_TaskBudget = DEFAULT_TASK_BUDGET;
 };
 } // namespace Airship
@@ -3,12 +3,13 @@
 #include <cstddef>
 #include <cstdint>
 #include <map>
-#include <memory>
 #include <optional>
 #include <string>
 #include <type_traits>
 #include <utility>
 
+#include "core/pool_allocator.h"
+
 namespace Airship {
 
 template <typename T>
@@ -85,7 +86,7 @@ public:
             return dynamic_cast<Convar<T>*>(val);
         }
 
-        auto it = m_ConvarMap.insert({name, std::make_unique<Convar<T>>(value)}).first;
+        auto it = m_ConvarMap.insert({name, MakePooled<Convar<T>>(value)}).first;
         return dynamic_cast<Convar<T>*>(it->second.get());
     }
     Convar<std::string>* RegisterKey(const std::string& name, const char* value) {
@@ -113,7 +114,7 @@ public:
     [[nodiscard]] size_t size() const { return m_ConvarMap.size(); }
 
 private:
-    std::map<std::string, std::unique_ptr<ConvarValue>> m_ConvarMap;
+    std::map<std::string, PoolPtr<ConvarValue>> m_ConvarMap;
 };
 
 } // namespace Airship
@@ -1,16 +1,26 @@
 #pragma once
 
-#include <any>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <typeindex>
+#include <optional>
+#include <span>
+#include <type_traits>
 #include <unordered_map>
-#include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "core/event_queue.h"
+#include "core/instrumentation.h"
+#include "core/job_system.h"
+#include "core/pool_allocator.h"
+
 // Event system is heavily inspired by DeveloperPaul123's eventbus implementation:
 // https://github.com/DeveloperPaul123/eventbus
 
@@ -19,94 +29,396 @@ namespace Airship {
 class EventSubscriber;
 class EventPublisher;
 
-using EventCallbackFn = std::function<void(const std::any&)>;
-struct EventCallback {
-    EventCallback(const EventCallbackFn& cb) : m_Handle(static_cast<const void*>(&cb)), m_Callback(cb) {}
+// Dense per-type ids, handed out the first time each event type is used. They index straight into a publisher's
+// channel list, so dispatch needs no hashing.
+using EventTypeId = size_t;
+namespace Detail {
+EventTypeId NextEventTypeId();
+} // namespace Detail
 
-    const void* m_Handle;
-    EventCallbackFn m_Callback;
-};
+template <class EventType>
+EventTypeId GetEventTypeId() {
+    static const EventTypeId id = Detail::NextEventTypeId();
+    return id;
+}
 
-class EventWrapperInterface {
-public:
-    virtual ~EventWrapperInterface() = default;
+// Identifies one callback registered with a publisher. Slots are reused, so a handle is only honoured while its
+// generation matches; handles to removed subscriptions are safely ignored.
+struct SubscriptionHandle {
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+    uint32_t m_Index = INVALID_INDEX;
+    uint32_t m_Generation = 0;
 
-    virtual void PublishSync(EventPublisher* eventPublisher) = 0;
+    explicit operator bool() const { return m_Index != INVALID_INDEX; }
+    bool operator==(const SubscriptionHandle&) const = default;
 };
 
-template <class EventType>
-class EventWrapper;
+// Callbacks receive a pointer to count events, already known to be of the channel's type. Per-event callbacks always
+// get a count of 1.
+using EventCallbackFn = std::function<void(const void* events, size_t count)>;
+struct EventCallback {
+    static constexpr uint32_t TOMBSTONE = UINT32_MAX;
+    EventCallbackFn m_Callback;
+    // Subscription slot, or TOMBSTONE once unsubscribed
+    uint32_t m_Slot;
+    ThreadAffinity m_Affinity = ThreadAffinity::MainThread;
+};
+
+// Queued events are processed one lane at a time, most urgent first
+enum class EventPriority : uint8_t {
+    Critical,
+    Normal,
+    Low
+};
 
 class EventPublisher {
 public:
+    EventPublisher() = default;
+    EventPublisher(const EventPublisher&) = delete;
+    EventPublisher& operator=(const EventPublisher&) = delete;
     virtual ~EventPublisher();
 
+    // AnyThread callbacks only make a difference with a job system set
     template <class EventType, std::invocable<EventType> CallbackType>
-    void AddSubscriber(EventSubscriber& subscriber, const CallbackType& callback) {
-        auto it = m_EventCallbacks.emplace(typeid(EventType),
-                                           [callback](std::any event) { callback(std::any_cast<EventType>(event)); });
-        m_SubscriberCallbacks.emplace(&subscriber, it->second.m_Handle);
+    SubscriptionHandle AddSubscriber(EventSubscriber& subscriber, const CallbackType& callback,
+                                     ThreadAffinity affinity = ThreadAffinity::MainThread) {
+        using Event = std::remove_cvref_t<EventType>;
+        EventCallbackFn fn = [callback](const void* event, size_t /*count*/) {
+            callback(*static_cast<const Event*>(event));
+        };
+        return AddCallback(subscriber, GetEventTypeId<Event>(), false, std::move(fn), affinity);
+    }
+    // Batch callbacks are called once per Process with every event of their type queued that frame, after the per-event
+    // callbacks have seen them. PublishSync calls them with a single event.
+    template <class EventType, std::invocable<std::span<const EventType>> CallbackType>
+    SubscriptionHandle AddBatchSubscriber(EventSubscriber& subscriber, const CallbackType& callback) {
+        static_assert(std::is_same_v<EventType, std::remove_cvref_t<EventType>>,
+                      "Batch event types must be unqualified");
+        EventCallbackFn fn = [callback](const void* events, size_t count) {
+            callback(std::span<const EventType>(static_cast<const EventType*>(events), count));
+        };
+        return AddCallback(subscriber, GetEventTypeId<EventType>(), true, std::move(fn), ThreadAffinity::MainThread);
     }
+    // O(1). Returns false if the handle was already unsubscribed.
+    bool Unsubscribe(SubscriptionHandle handle);
     void RemoveSubscriber(EventSubscriber& subscriber);
 
+    // Queue policies are per event type, and must be set before that type is published from other threads. Setting
+    // one never disturbs other types, which can go on publishing meanwhile. Events default to the Normal lane, with
+    // every instance kept. Only the first MAX_POLICY_TYPES event types can have a policy; setting one for any later
+    // type logs an error and leaves the defaults.
+    template <class EventType>
+    void SetPriority(EventPriority priority) {
+        if (TypePolicy* policy = PolicyFor(GetEventTypeId<EventType>())) policy->priority = priority;
+    }
+    // Keep only the latest event of this type that is waiting to be processed
+    template <class EventType>
+    void SetCoalesce() {
+        SetReducer<EventType>({});
+    }
+    // Fold each event of this type into the one already waiting, by calling
+    // reducer(EventType& waiting, const EventType& event)
+    template <class EventType, std::invocable<EventType&, const EventType&> ReducerType>
+    void SetMerge(ReducerType reducer) {
+        SetReducer<EventType>(std::move(reducer));
+    }
+    // Drop new events of this type while maxQueued are already waiting. 0 means no limit.
+    template <class EventType>
+    void SetQueueLimit(size_t maxQueued) {
+        if (TypePolicy* policy = PolicyFor(GetEventTypeId<EventType>())) policy->queueLimit = maxQueued;
+    }
+    // Events refused by a queue limit since the publisher was created
+    [[nodiscard]] size_t DroppedEventCount() const { return m_DroppedEvents.load(std::memory_order_relaxed); }
+
+    // Opt in to parallel dispatch, or back out with nullptr. With a job system, Process first collects the frame's
+    // queued events, then hands AnyThread callbacks to the workers in chunks of events, while MainThread callbacks run
+    // on the calling thread. Batch callbacks run last, once every other callback has finished.
+    //
+    // Ordering is only kept among MainThread callbacks, and only within each event type. AnyThread callbacks may
+    // publish, but not subscribe or unsubscribe. PublishSync is unaffected.
+    void SetJobSystem(JobSystem* jobs) { m_JobSystem = jobs; }
+    static constexpr size_t EVENTS_PER_JOB = 64;
+
     // Process all queued events and fire callbacks.
     void Process();
+    // Critical and Normal events are always processed. Low priority events are left for the next call once budget has
+    // been spent, so a storm of them can't stretch the frame.
+    void Process(std::chrono::nanoseconds budget);
 
-    // Queues an Event to be processed in the next frame.
+    // Queues an Event to be processed in the next frame. Lock-free unless the type is coalesced or merged, and safe to
+    // call from any thread.
     template <class EventType>
     void Publish(const EventType& event) {
-        std::scoped_lock const lock(m_QueueMutex);
-        m_QueuedEvents.push_back(std::make_unique<EventWrapper<EventType>>(event));
+        MEMORY_TAG_SCOPE(Events);
+        using Event = std::remove_cvref_t<EventType>;
+        TypePolicy* policy = FindPolicy(GetEventTypeId<Event>());
+        if (policy == nullptr) {
+            m_Lanes[static_cast<size_t>(EventPriority::Normal)].Push(event, &DispatchQueuedThunk<Event>);
+            return;
+        }
+
+        EventQueue& lane = m_Lanes[static_cast<size_t>(policy->priority)];
+        if (policy->pending) {
+            auto& pending = static_cast<PendingEvent<Event>&>(*policy->pending);
+            {
+                std::scoped_lock lock(pending.mutex);
+                if (pending.event) {
+                    if (pending.reducer)
+                        pending.reducer(*pending.event, event);
+                    else
+                        *pending.event = event;
+                    return;
+                }
+                pending.event.emplace(event);
+            }
+            // The queued record only marks where the event goes in the lane; it's taken from pending when dispatched
+            lane.Push(&pending, &DispatchPendingThunk<Event>);
+            return;
+        }
+
+        if (policy->queueLimit != 0) {
+            if (policy->queued.fetch_add(1, std::memory_order_relaxed) >= policy->queueLimit) {
+                policy->queued.fetch_sub(1, std::memory_order_relaxed);
+                m_DroppedEvents.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            lane.Push(event, &DispatchLimitedThunk<Event>);
+            return;
+        }
+        lane.Push(event, &DispatchQueuedThunk<Event>);
     }
 
-    // Immediately fires event and handles resulting callbacks. Blocking function.
+    // Immediately fires event and handles resulting callbacks. Blocking function. Callbacks may subscribe and
+    // unsubscribe; new subscriptions first see the next event.
     template <class EventType>
     void PublishSync(const EventType& event) {
-        auto eventsRange = m_EventCallbacks.equal_range(typeid(EventType));
-        for (auto it = eventsRange.first; it != eventsRange.second; ++it) {
-            it->second.m_Callback(std::any(event));
-        }
+        MEMORY_TAG_SCOPE(Events);
+        Dispatch(GetEventTypeId<std::remove_cvref_t<EventType>>(), &event, true);
     }
 
-    [[nodiscard]] size_t EventCount() const { return m_EventCallbacks.size(); }
-    [[nodiscard]] size_t SubscriberCount() const { return m_SubscriberCallbacks.size(); }
+    [[nodiscard]] size_t EventCount() const { return m_LiveCount; }
+    [[nodiscard]] size_t SubscriberCount() const { return m_LiveCount; }
 
 private:
-    std::unordered_multimap<std::type_index, EventCallback> m_EventCallbacks;
-    std::unordered_multimap<EventSubscriber*, const void*> m_SubscriberCallbacks;
+    struct CallbackList {
+        std::vector<EventCallback> entries;
+        size_t tombstones = 0;
+    };
+    // A frame's queued events of one type, packed for batch callbacks and parallel dispatch
+    struct StagingBase {
+        virtual ~StagingBase() = default;
+        [[nodiscard]] virtual const std::byte* Data() const = 0;
+        [[nodiscard]] virtual size_t Count() const = 0;
+        virtual void Clear() = 0;
+        size_t stride = 0;
+    };
+    template <class EventType>
+    struct Staging : StagingBase {
+        Staging() { stride = sizeof(EventType); }
+        [[nodiscard]] const std::byte* Data() const override {
+            return reinterpret_cast<const std::byte*>(events.data());
+        }
+        [[nodiscard]] size_t Count() const override { return events.size(); }
+        void Clear() override { events.clear(); }
+        std::vector<EventType> events;
+    };
+    struct Channel {
+        CallbackList single;
+        CallbackList batch;
+        PoolPtr<StagingBase> staging;
+    };
+    static constexpr uint32_t PENDING_POSITION = UINT32_MAX;
+    struct SubscriptionSlot {
+        EventSubscriber* subscriber = nullptr; // Null while the slot is free
+        EventTypeId type = 0;
+        uint32_t position = 0; // Index into the channel's callbacks, or PENDING_POSITION
+        uint32_t subscriberPosition = 0; // Index into the subscriber's handles for this publisher
+        uint32_t generation = 0;
+        bool batch = false;
+    };
+    struct PendingCallback {
+        EventTypeId type;
+        uint32_t generation;
+        EventCallback entry;
+    };
+
+    // The one waiting event of a coalesced or merged type
+    struct PendingEventBase {
+        virtual ~PendingEventBase() = default;
+        std::mutex mutex;
+    };
+    template <class EventType>
+    struct PendingEvent : PendingEventBase {
+        std::optional<EventType> event;
+        // Empty to coalesce
+        std::function<void(EventType&, const EventType&)> reducer;
+    };
+    struct TypePolicy {
+        EventPriority priority = EventPriority::Normal;
+        size_t queueLimit = 0;
+        std::atomic<size_t> queued = 0;
+        PoolPtr<PendingEventBase> pending;
+    };
+
+    // Counts as a dispatch for as long as it's alive, so a throwing callback still unwinds the depth and finishes the
+    // outermost dispatch
+    class DispatchScope {
+    public:
+        explicit DispatchScope(EventPublisher& publisher) : m_Publisher(publisher) { ++m_Publisher.m_DispatchDepth; }
+        DispatchScope(const DispatchScope&) = delete;
+        DispatchScope& operator=(const DispatchScope&) = delete;
+        ~DispatchScope();
 
-    std::vector<std::unique_ptr<EventWrapperInterface>> m_QueuedEvents;
-    std::mutex m_QueueMutex;
+    private:
+        EventPublisher& m_Publisher;
+    };
+    // Staged events only last the frame, so they're dropped when it ends even if a callback throws, whether that's
+    // while draining the lanes or dispatching the staged events. Otherwise the next frame would see them again.
+    class StagingScope {
+    public:
+        explicit StagingScope(EventPublisher& publisher) : m_Publisher(publisher) {}
+        StagingScope(const StagingScope&) = delete;
+        StagingScope& operator=(const StagingScope&) = delete;
+        ~StagingScope();
+
+    private:
+        EventPublisher& m_Publisher;
+    };
+
+    SubscriptionHandle AddCallback(EventSubscriber& subscriber, EventTypeId type, bool batch, EventCallbackFn callback,
+                                   ThreadAffinity affinity);
+    void Dispatch(EventTypeId type, const void* event, bool includeBatch);
+    void FinishDispatch();
+    void Compact(EventTypeId type);
+    // Runs the callbacks that were waiting for the whole frame's events
+    void DispatchStaged();
+    void DispatchParallel();
+    [[nodiscard]] CallbackList& ListFor(const SubscriptionSlot& slot) {
+        Channel& channel = m_Channels[slot.type];
+        return slot.batch ? channel.batch : channel.single;
+    }
+
+    // Creates the type's policy. Null if the type is past MAX_POLICY_TYPES.
+    TypePolicy* PolicyFor(EventTypeId id);
+    [[nodiscard]] TypePolicy* FindPolicy(EventTypeId id) const {
+        if (id >= MAX_POLICY_TYPES) return nullptr;
+        const PolicyPage* page = m_PolicyPages[id / POLICY_PAGE_SIZE].load(std::memory_order_acquire);
+        return page != nullptr ? (*page)[id % POLICY_PAGE_SIZE].get() : nullptr;
+    }
+    // A queued record may point at the pending event, so it's only ever created once. Switching between coalescing
+    // and merging just swaps the reducer, which then applies to the event already waiting.
+    template <class EventType>
+    void SetReducer(std::function<void(EventType&, const EventType&)> reducer) {
+        TypePolicy* policy = PolicyFor(GetEventTypeId<EventType>());
+        if (policy == nullptr) return;
+        if (!policy->pending) policy->pending = MakePooled<PendingEvent<EventType>>();
+        auto& pending = static_cast<PendingEvent<EventType>&>(*policy->pending);
+        std::scoped_lock lock(pending.mutex);
+        pending.reducer = std::move(reducer);
+    }
+
+    // Queue record dispatchers, with the publisher as context
+    template <class EventType>
+    static void DispatchQueuedThunk(void* publisher, const void* event) {
+        static_cast<EventPublisher*>(publisher)->DispatchQueued(*static_cast<const EventType*>(event));
+    }
+    template <class EventType>
+    static void DispatchLimitedThunk(void* publisher, const void* event) {
+        auto* self = static_cast<EventPublisher*>(publisher);
+        self->FindPolicy(GetEventTypeId<EventType>())->queued.fetch_sub(1, std::memory_order_relaxed);
+        self->DispatchQueued(*static_cast<const EventType*>(event));
+    }
+    template <class EventType>
+    static void DispatchPendingThunk(void* publisher, const void* record) {
+        auto& pending = **static_cast<PendingEvent<EventType>* const*>(record);
+        std::optional<EventType> event;
+        {
+            std::scoped_lock lock(pending.mutex);
+            event.swap(pending.event);
+        }
+        static_cast<EventPublisher*>(publisher)->DispatchQueued(*event);
+    }
+
+    template <class EventType>
+    void DispatchQueued(const EventType& event) {
+        using Event = std::remove_cvref_t<EventType>;
+        const EventTypeId id = GetEventTypeId<Event>();
+        // In parallel mode every callback waits for the whole frame
+        if (m_JobSystem == nullptr) Dispatch(id, &event, false);
+        if (id >= m_Channels.size()) return;
+
+        Channel& channel = m_Channels[id];
+        const bool stage = !channel.batch.entries.empty() || (m_JobSystem && !channel.single.entries.empty());
+        if (!stage) return;
+        if (!channel.staging) channel.staging = MakePooled<Staging<Event>>();
+        auto& events = static_cast<Staging<Event>&>(*channel.staging).events;
+        if (events.empty()) m_StagedTypes.push_back(id);
+        events.push_back(event);
+    }
+    [[nodiscard]] bool IsLive(SubscriptionHandle handle) const {
+        return handle.m_Index < m_Slots.size() && m_Slots[handle.m_Index].subscriber != nullptr &&
+               m_Slots[handle.m_Index].generation == handle.m_Generation;
+    }
+
+    // Indexed by EventTypeId
+    std::vector<Channel> m_Channels;
+    std::vector<SubscriptionSlot> m_Slots;
+    std::vector<uint32_t> m_FreeSlots;
+    size_t m_LiveCount = 0;
+
+    // Channels can't change shape while their callbacks run, so subscriptions made from a callback wait here, and
+    // compaction waits until the outermost dispatch returns
+    uint32_t m_DispatchDepth = 0;
+    std::vector<PendingCallback> m_PendingCallbacks;
+    bool m_CompactAfterDispatch = false;
+
+    // Channels with events staged this frame
+    std::vector<EventTypeId> m_StagedTypes;
+    JobSystem* m_JobSystem = nullptr;
+
+    // Indexed by EventTypeId, null for types left on the defaults. Pages are only allocated once a type in them gets a
+    // policy, and never move, so giving one type a policy never disturbs Publish reading another's.
+    static constexpr size_t POLICY_PAGE_SIZE = 64;
+    static constexpr size_t MAX_POLICY_TYPES = 4096;
+    using PolicyPage = std::array<PoolPtr<TypePolicy>, POLICY_PAGE_SIZE>;
+    std::array<std::atomic<PolicyPage*>, MAX_POLICY_TYPES / POLICY_PAGE_SIZE> m_PolicyPages{};
+    std::atomic<size_t> m_DroppedEvents = 0;
+    // One queue per EventPriority
+    std::array<EventQueue, 3> m_Lanes;
 };
 
 class EventSubscriber {
 public:
+    EventSubscriber() = default;
+    EventSubscriber(const EventSubscriber&) = delete;
+    EventSubscriber& operator=(const EventSubscriber&) = delete;
     virtual ~EventSubscriber();
 
-    [[nodiscard]] size_t SubscribedCount() const { return m_Subscribed.size(); }
+    // Number of publishers subscribed to
+    [[nodiscard]] size_t SubscribedCount() const { return m_Subscriptions.size(); }
 
     template <class EventType, std::invocable<EventType> CallbackType>
-    bool SubscribeTo(EventPublisher& pub, CallbackType&& callback) {
-        m_Subscribed.insert(&pub);
-        pub.AddSubscriber<EventType>(*this, std::forward<CallbackType>(callback));
-
-        return true;
+    SubscriptionHandle SubscribeTo(EventPublisher& pub, CallbackType&& callback,
+                                   ThreadAffinity affinity = ThreadAffinity::MainThread) {
+        return pub.AddSubscriber<EventType>(*this, std::forward<CallbackType>(callback), affinity);
+    }
+    // See EventPublisher::AddBatchSubscriber
+    template <class EventType, std::invocable<std::span<const EventType>> CallbackType>
+    SubscriptionHandle SubscribeBatch(EventPublisher& pub, CallbackType&& callback) {
+        return pub.AddBatchSubscriber<EventType>(*this, std::forward<CallbackType>(callback));
     }
 
+    // O(1)
+    bool Unsubscribe(EventPublisher& publisher, SubscriptionHandle handle);
+    // Drop every subscription to publisher
+    void UnsubscribeAll(EventPublisher& publisher);
+    // Called by a publisher that is going away
     void CancelSubscription(EventPublisher& publisher);
 
 private:
-    std::unordered_set<EventPublisher*> m_Subscribed;
+    // Kept up to date by the publisher, which tracks where each handle is so it can be removed in O(1)
+    friend class EventPublisher;
+    std::unordered_map<EventPublisher*, std::vector<SubscriptionHandle>> m_Subscriptions;
 };
 
-template <class EventType>
-class EventWrapper : public EventWrapperInterface {
-public:
-    EventWrapper(EventType e) : EventWrapperInterface(), m_Event(std::move(e)) {}
-
-    void PublishSync(EventPublisher* eventPublisher) override { eventPublisher->PublishSync(m_Event); }
-
-private:
-    EventType m_Event;
-};
 } // namespace Airship
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Airship {
+
+// Multi-producer, single-consumer queue that stores events inline in arena chunks, with no locks and no per-event
+// allocation once the chunks have grown to fit a frame's traffic.
+//
+// Producers claim space with an atomic bump of the current chunk's offset, and register with the arena they write into
+// so the consumer can tell when they're done. Drain() swaps in the other arena for new events, waits out any producers
+// still writing into the old one, then dispatches and destroys its events in the order their space was claimed.
+// An arena's chunks are only allocated on its first push, then kept and reused each frame. A drain given a deadline
+// can stop part way through an arena and resume there on the next call, before swapping again.
+class EventQueue {
+public:
+    using DispatchFn = void (*)(void* context, const void* event);
+
+    EventQueue();
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+    ~EventQueue();
+
+    // Safe to call from any thread, including from a callback that Drain() is running
+    template <class EventType>
+    void Push(const EventType& event, DispatchFn dispatch) {
+        static_assert(alignof(EventType) <= RECORD_ALIGNMENT, "Over-aligned events aren't supported");
+        constexpr size_t recordBytes = AlignUp(sizeof(RecordHeader) + sizeof(EventType));
+
+        Arena& arena = EnterArena();
+        auto* header = static_cast<RecordHeader*>(Reserve(arena, recordBytes));
+        // Left as a skipped record if the copy throws
+        *header = {.dispatch = nullptr, .destroy = nullptr, .bytes = recordBytes};
+        try {
+            new (Payload(header)) EventType(event);
+        } catch (...) {
+            LeaveArena(arena);
+            throw;
+        }
+        header->dispatch = dispatch;
+        if constexpr (!std::is_trivially_destructible_v<EventType>)
+            header->destroy = [](void* e) { static_cast<EventType*>(e)->~EventType(); };
+        LeaveArena(arena);
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    // Dispatches every event pushed before the call. Only one thread may drain at a time, and not recursively; events
+    // pushed by the callbacks are left for the next call. If a callback throws, its event is dropped and the exception
+    // propagates; the next call carries on from the event after it.
+    //
+    // Returns false if the deadline passed first. The events left over stay ahead of anything pushed since, and the
+    // next call starts with them. At least DEADLINE_CHECK_INTERVAL events are dispatched per call, so a queue that is
+    // always over budget still makes progress.
+    bool Drain(void* context, Clock::time_point deadline = Clock::time_point::max());
+
+    static constexpr uint32_t DEADLINE_CHECK_INTERVAL = 16;
+
+private:
+    static constexpr size_t RECORD_ALIGNMENT = alignof(std::max_align_t);
+    static constexpr size_t CHUNK_BYTES = size_t(64) << 10;
+
+    static constexpr size_t AlignUp(size_t bytes) {
+        return (bytes + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+    }
+
+    struct alignas(RECORD_ALIGNMENT) RecordHeader {
+        DispatchFn dispatch;
+        void (*destroy)(void* event);
+        // Including this header. 0 marks the end of a chunk's records.
+        size_t bytes;
+    };
+    static void* Payload(RecordHeader* header) { return reinterpret_cast<std::byte*>(header) + sizeof(RecordHeader); }
+
+    struct Chunk {
+        explicit Chunk(size_t bytes);
+        Chunk(const Chunk&) = delete;
+        Chunk& operator=(const Chunk&) = delete;
+        ~Chunk();
+
+        std::byte* data;
+        size_t capacity;
+        // Claimed bytes. Overshoots capacity once producers have moved on to the next chunk.
+        std::atomic<size_t> used = 0;
+        std::atomic<Chunk*> next = nullptr;
+    };
+
+    struct Arena {
+        std::atomic<uint32_t> writers = 0;
+        // Both null until the first push
+        std::atomic<Chunk*> head = nullptr;
+        std::atomic<Chunk*> tail = nullptr;
+    };
+    // Next record to dispatch in an arena being drained
+    struct Cursor {
+        Chunk* chunk = nullptr;
+        size_t offset = 0;
+    };
+
+    Arena& EnterArena();
+    static void LeaveArena(Arena& arena) { arena.writers.fetch_sub(1, std::memory_order_release); }
+    static void* Reserve(Arena& arena, size_t bytes);
+    static Chunk* FirstChunk(Arena& arena, size_t bytes);
+    // Returns false if it stopped at the deadline, with cursor on the first record left
+    static bool Consume(Cursor& cursor, void* context, bool dispatch, Clock::time_point deadline);
+    // Destroys the record's event and moves the cursor past it
+    static void Retire(Cursor& cursor, RecordHeader* header);
+    static void Reset(Arena& arena);
+
+    std::array<Arena, 2> m_Arenas;
+    std::atomic<Arena*> m_Current;
+    // Only touched by the draining thread. Set while a drain that ran out of time has events left in this arena.
+    Arena* m_Draining = nullptr;
+    Cursor m_Resume;
+};
+
+} // namespace Airship
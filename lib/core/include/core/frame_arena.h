@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace Airship {
+
+// Linear allocator for memory that only lives for a frame or two. Allocating is a pointer bump and freeing is a no-op;
+// NewFrame recycles everything allocated FRAME_COUNT frames ago at once, so anything allocated this frame stays valid
+// through the next FRAME_COUNT - 1 NewFrame calls (long enough for the GPU or a pipelined job to read it).
+//
+// Each frame starts with one block. A frame that outgrows it takes extra blocks from the heap, and the next time that
+// frame comes around they're merged into one block big enough for all of it, so a steady workload stops allocating
+// after a few frames. Not thread-safe: allocate from the thread that calls NewFrame.
+class FrameArena {
+public:
+    static constexpr size_t FRAME_COUNT = 3;
+    static constexpr size_t DEFAULT_FRAME_BYTES = 64 * 1024;
+
+    explicit FrameArena(size_t initialFrameBytes = DEFAULT_FRAME_BYTES);
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Moves on to the next frame's memory, invalidating what was allocated from it FRAME_COUNT frames ago
+    void NewFrame();
+
+    [[nodiscard]] void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        Frame& frame = m_Frames[m_Current];
+        const Block& block = frame.blocks.back();
+        const auto base = reinterpret_cast<uintptr_t>(block.data.get());
+        const size_t start = ((base + frame.offset + alignment - 1) & ~(alignment - 1)) - base;
+        if (start + bytes > block.size) return AllocateSlow(bytes, alignment);
+        frame.used += start + bytes - frame.offset;
+        frame.offset = start + bytes;
+        return block.data.get() + start;
+    }
+    // Uninitialized storage for count Ts
+    template <typename T>
+    [[nodiscard]] T* Allocate(size_t count) {
+        return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // For std::pmr containers. Deallocation does nothing, and the container must be gone (or never touched again) by
+    // the time its memory is recycled.
+    [[nodiscard]] std::pmr::memory_resource* Resource() { return &m_Resource; }
+
+    // Bytes allocated this frame, including alignment padding
+    [[nodiscard]] size_t FrameBytes() const { return m_Frames[m_Current].used; }
+    // Most bytes any frame has used since the last ResetPeak
+    [[nodiscard]] size_t PeakFrameBytes() const { return std::max(m_PeakFrameBytes, FrameBytes()); }
+    void ResetPeak() { m_PeakFrameBytes = 0; }
+    // Heap allocations made for blocks, after construction. Stops growing once the workload is steady.
+    [[nodiscard]] uint64_t BlockAllocations() const { return m_BlockAllocations; }
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+    struct Frame {
+        std::vector<Block> blocks;
+        size_t offset = 0; // Into the last block
+        size_t used = 0;
+    };
+    class MemoryResource : public std::pmr::memory_resource {
+    public:
+        explicit MemoryResource(FrameArena& arena) : m_Arena(arena) {}
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override { return m_Arena.Allocate(bytes, alignment); }
+        void do_deallocate(void* /*p*/, size_t /*bytes*/, size_t /*alignment*/) override {}
+        [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        FrameArena& m_Arena;
+    };
+
+    void* AllocateSlow(size_t bytes, size_t alignment);
+    void AddBlock(Frame& frame, size_t size);
+
+    std::array<Frame, FRAME_COUNT> m_Frames;
+    size_t m_Current = 0;
+    MemoryResource m_Resource{*this};
+    size_t m_PeakFrameBytes = 0;
+    uint64_t m_BlockAllocations = 0;
+};
+
+} // namespace Airship
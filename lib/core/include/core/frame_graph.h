@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/job_system.h"
+
+namespace Airship {
+
+struct FrameInfo {
+    uint64_t index = 0;
+    float dt = 0.0f;
+};
+
+// With pipelining, a frame's Render nodes run alongside the next frame's Simulate nodes.
+// Render nodes are still AnyThread unless they say otherwise, and run on workers. The renderer has a single GL context
+// on the main thread, so nodes that call into it need ThreadAffinity::MainThread; the rest should only prepare data
+// for it, like building draw lists.
+enum class FramePhase : uint8_t {
+    Simulate,
+    Render
+};
+
+struct FrameNodeDesc {
+    // Shown in traces, so it must outlive them; normally a string literal
+    const char* name;
+    // Resources are just names. A node runs after earlier-registered nodes that write what it reads or writes, and
+    // after earlier readers of what it writes.
+    std::vector<std::string> reads = {};
+    std::vector<std::string> writes = {};
+    FramePhase phase = FramePhase::Simulate;
+    ThreadAffinity affinity = ThreadAffinity::AnyThread;
+};
+
+// Per-frame DAG of systems, built from the resources each node declares. Execute runs nodes on the job system as soon
+// as their dependencies are met, MainThread nodes on the calling thread, and records the frame's critical path: the
+// chain of nodes, each held up by the previous one, that decided how long the frame took. The path is drawn on its own
+// "Critical path" track in the Profiling trace.
+class FrameGraph {
+public:
+    using NodeId = uint32_t;
+    using NodeFn = std::function<void(const FrameInfo&)>;
+
+    FrameGraph() = default;
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+
+    // Not while executing
+    NodeId AddNode(FrameNodeDesc desc, NodeFn fn);
+    [[nodiscard]] bool Empty() const { return m_Nodes.empty(); }
+
+    // Overlap the Render nodes of each frame with the Simulate nodes of the next. Nodes that share a resource across
+    // the two still wait for each other, so the usual pattern is a Simulate node that extracts what rendering needs
+    // into its own resource. Render nodes then see frames one Execute late; Flush runs the last one.
+    void SetPipelined(bool pipelined);
+    [[nodiscard]] bool IsPipelined() const { return m_Pipelined; }
+
+    // Runs one frame and returns when every node has finished, rethrowing the first exception a node threw. Without a
+    // job system every node runs on the calling thread, in dependency order.
+    void Execute(JobSystem* jobs, const FrameInfo& frame);
+    // Runs any Render nodes still waiting on a pipelined frame
+    void Flush(JobSystem* jobs);
+
+    // Nodes of the last Execute's critical path, first to last
+    [[nodiscard]] const std::vector<NodeId>& CriticalPath() const { return m_CriticalPath; }
+    // Nanoseconds from the start of the critical path's first node to the end of its last
+    [[nodiscard]] uint64_t CriticalPathNs() const { return m_CriticalPathNs; }
+
+private:
+    struct Node {
+        FrameNodeDesc desc;
+        NodeFn fn;
+        std::vector<uint32_t> reads, writes;
+    };
+    // A node as scheduled in one Execute, for one frame
+    struct Task {
+        NodeId node = 0;
+        bool previousFrame = false;
+        std::vector<uint32_t> successors = {};
+        std::vector<uint32_t> predecessors = {};
+        uint32_t dependencyCount = 0;
+    };
+    struct TaskState {
+        std::atomic<uint32_t> pending = 0;
+        uint64_t start = 0, end = 0;
+    };
+
+    uint32_t ResourceId(const std::string& name);
+    // Tasks in an order where dependencies only point backwards. Render nodes from the previous frame go first.
+    [[nodiscard]] std::vector<Task> BuildSchedule(bool simulate, bool render, bool renderFromPreviousFrame) const;
+    void Run(JobSystem* jobs, const std::vector<Task>& schedule, const FrameInfo& frame,
+             const FrameInfo& previousFrame);
+    void RunTask(JobSystem* jobs, uint32_t task);
+    void Launch(JobSystem* jobs, uint32_t task);
+    void RecordCriticalPath();
+
+    std::vector<Node> m_Nodes;
+    std::unordered_map<std::string, uint32_t> m_ResourceIds;
+    bool m_Pipelined = false;
+
+    // Rebuilt after nodes are added or pipelining changes
+    bool m_Dirty = true;
+    std::vector<Task> m_FullSchedule, m_PipelinedSchedule, m_SimulateSchedule, m_RenderSchedule;
+    bool m_RenderPending = false;
+    FrameInfo m_PendingRenderFrame;
+
+    // State of the Execute in progress
+    const std::vector<Task>* m_Schedule = nullptr;
+    std::unique_ptr<TaskState[]> m_States;
+    size_t m_StateCount = 0;
+    FrameInfo m_Frame, m_PreviousFrame;
+    JobCounter m_Jobs;
+    std::atomic<uint32_t> m_Remaining = 0;
+    std::mutex m_Mutex; // Guards the two below
+    std::vector<uint32_t> m_MainThreadReady;
+    std::exception_ptr m_Error;
+
+    std::vector<NodeId> m_CriticalPath;
+    uint64_t m_CriticalPathNs = 0;
+    uint32_t m_CriticalPathTrack = UINT32_MAX;
+};
+
+} // namespace Airship
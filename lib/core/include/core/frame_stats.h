@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace Airship {
+
+// Log-linear (HDR-style) histogram of nanosecond durations. Each power of two is split into SUB_BUCKET_COUNT linear
+// buckets, so any recorded value is reported within ~3% of its true value across the full 64-bit range. Storage is a
+// fixed array and recording is a handful of integer ops, cheap enough to leave on in release builds.
+class DurationHistogram {
+public:
+    static constexpr uint32_t SUB_BUCKET_BITS = 5;
+    static constexpr uint32_t SUB_BUCKET_COUNT = 1U << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKET_COUNT * (64 - SUB_BUCKET_BITS + 1);
+
+    void record(uint64_t ns) noexcept;
+    void reset() noexcept;
+
+    // Duration below which the given fraction (0-1) of recorded values fall. 0 if nothing was recorded.
+    [[nodiscard]] uint64_t percentile(double fraction) const noexcept;
+
+    [[nodiscard]] uint64_t count() const noexcept { return m_Count; }
+    [[nodiscard]] uint64_t min() const noexcept { return m_Count == 0 ? 0 : m_Min; }
+    [[nodiscard]] uint64_t max() const noexcept { return m_Max; }
+    [[nodiscard]] uint64_t mean() const noexcept { return m_Count == 0 ? 0 : m_Total / m_Count; }
+
+private:
+    static size_t bucketIndex(uint64_t ns) noexcept;
+    static uint64_t bucketMidpoint(size_t index) noexcept;
+
+    std::array<uint32_t, BUCKET_COUNT> m_Buckets{};
+    uint64_t m_Count = 0;
+    uint64_t m_Total = 0;
+    uint64_t m_Min = std::numeric_limits<uint64_t>::max();
+    uint64_t m_Max = 0;
+};
+
+// Per-phase timings collected by Application::GameLoop
+struct FrameStats {
+    DurationHistogram frame; // Start of one frame to the start of the next
+    // End of polling to the renderer flush: fixed updates, tasks, OnGameLoop, the frame graph and OnRender
+    DurationHistogram update;
+    DurationHistogram poll; // Window event polling
+    DurationHistogram flush; // Renderer::endFrame, submitting the frame's queued draws
+    DurationHistogram swap; // Buffer swap, including any vsync wait
+
+    void reset() noexcept {
+        frame.reset();
+        update.reset();
+        poll.reset();
+        flush.reset();
+        swap.reset();
+    }
+};
+
+} // namespace Airship
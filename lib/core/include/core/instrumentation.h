@@ -1,11 +1,19 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 
 #define CONCAt2(a, b) a##b
 #define CONCAT2(a, b) CONCAt2(a, b)
 #define PROFILE_SCOPE(name) ::Airship::Profiling::ScopeTimer CONCAT2(profiler_, __COUNTER__)(name)
 #define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#define MEMORY_TAG_SCOPE(tag)                                                                                          \
+    ::Airship::Profiling::MemoryTagScope CONCAT2(memory_tag_, __COUNTER__)(::Airship::Profiling::MemoryTag::tag)
 
 namespace Airship::Profiling {
 
@@ -18,6 +26,144 @@ private:
     [[maybe_unused]] const char* name;
 };
 
-void dump([[maybe_unused]] const std::string& filename);
+// Where trace timestamps come from. The default is picked at build time with the AIRSHIP_PROFILING_CLOCK CMake option.
+enum class ClockSource : uint8_t {
+    SteadyClock, // std::chrono::steady_clock
+    MonotonicRaw, // clock_gettime(CLOCK_MONOTONIC_RAW), served from the vDSO. Linux only.
+    Tsc // rdtsc, calibrated against steady_clock the first time it's selected. x86 only, needs an invariant TSC.
+};
+
+// Returns false (keeping the current source) if the source isn't available on this platform. Safe to call at any
+// time, since every source is converted to nanoseconds when recorded.
+bool setClockSource(ClockSource source);
+[[nodiscard]] ClockSource clockSource();
+// Nanoseconds since startup, read from the active clock source
+[[nodiscard]] uint64_t now() noexcept;
+
+// What a thread's trace buffer does once it is full
+enum class OverflowPolicy : uint8_t {
+    OverwriteOldest, // Keep recording, losing the oldest undrained events
+    DropNewest // Keep the oldest undrained events, discarding new ones until the buffer is drained
+};
+
+// Each thread records into a fixed-capacity buffer, allocated when it emits its first event. These settings only
+// apply to buffers created after the call, so set them up before spawning any instrumented threads.
+void setBufferCapacity(size_t eventCount);
+void setOverflowPolicy(OverflowPolicy policy);
+
+// Number of events lost because a buffer was full, across all threads
+[[nodiscard]] uint64_t droppedEventCount();
+// Whether this build records trace events (AIRSHIP_INSTRUMENTATION)
+[[nodiscard]] bool instrumentationEnabled();
+
+enum class TraceFormat : uint8_t {
+    Json, // chrome-tracing/perfetto.ui
+    Binary // Compact, see core/trace_format.h. Convert with the airship-trace tool.
+};
+
+// Label the calling thread in traces. Safe to call from any thread, any number of times; the last name wins.
+void setThreadName([[maybe_unused]] std::string_view name);
+
+// Extra timelines in the trace, for spans that don't belong to any one thread (e.g. a frame's critical path). Returns
+// the track's id, which is shown like a thread id. Always 0 without AIRSHIP_INSTRUMENTATION.
+uint32_t createTrack([[maybe_unused]] std::string_view name);
+// Record a span on a track with explicit timestamps from now(). name must outlive the trace, like a scope's.
+void recordSpan([[maybe_unused]] uint32_t track, [[maybe_unused]] const char* name, [[maybe_unused]] uint64_t startNs,
+                [[maybe_unused]] uint64_t endNs) noexcept;
+
+// Record one sample of a counter, shown as its own graph in the trace ("ph":"C"). name must outlive the trace.
+void recordCounter([[maybe_unused]] const char* name, [[maybe_unused]] int64_t value) noexcept;
+
+// Drains all buffered events to a file
+void dump([[maybe_unused]] const std::string& filename, [[maybe_unused]] TraceFormat format = TraceFormat::Json);
+
+struct StreamOptions {
+    // Files are written as <basePath>.<index>.json (or .astrace for the binary format)
+    std::string basePath = "trace";
+    TraceFormat format = TraceFormat::Json;
+    // How often the background thread drains the per-thread buffers
+    std::chrono::milliseconds flushInterval{100};
+    // Start a new file once the current one grows past this size
+    size_t maxFileBytes = size_t(64) << 20;
+    // Number of files to keep on disk; the oldest is deleted on rotation. 0 keeps everything.
+    uint32_t maxFiles = 8;
+};
+
+// Continuously drain events to disk from a background thread, so long sessions run with constant memory and a crash
+// loses at most one flush interval. JSON files use the array format, which the trace viewers accept even when the
+// process dies before the closing bracket is written. Returns false if already streaming.
+bool startStreaming([[maybe_unused]] const StreamOptions& options);
+// Stops the background thread, after draining any remaining events
+void stopStreaming();
+
+// Memory tracking. Heap allocations are charged to the calling thread's current MemoryTag. Building with the
+// AIRSHIP_MEMORY_HOOKS CMake option replaces the global operator new/delete to count every allocation; without it, only
+// what goes through TaggedResource or trackAllocation is counted. Either way, the stats work without
+// AIRSHIP_INSTRUMENTATION, and markMemoryFrame also records them as trace counters when it's on.
+enum class MemoryTag : uint8_t {
+    Untagged,
+    Renderer,
+    Events,
+    Logging,
+    Game
+};
+constexpr size_t MEMORY_TAG_COUNT = 5;
+[[nodiscard]] std::string_view memoryTagName(MemoryTag tag);
+
+// Charges the calling thread's allocations to tag until the scope ends. Scopes nest, and the innermost one wins.
+class MemoryTagScope {
+public:
+    explicit MemoryTagScope(MemoryTag tag) noexcept;
+    MemoryTagScope(const MemoryTagScope&) = delete;
+    MemoryTagScope& operator=(const MemoryTagScope&) = delete;
+    ~MemoryTagScope() noexcept;
+
+private:
+    MemoryTag previous;
+};
+[[nodiscard]] MemoryTag currentMemoryTag() noexcept;
+
+// For memory the hooks can't see, or everything when they're compiled out. Deallocations must use the same tag.
+void trackAllocation(MemoryTag tag, size_t bytes) noexcept;
+void trackDeallocation(MemoryTag tag, size_t bytes) noexcept;
+// GPU memory, such as Buffer data stores
+void trackGpuAllocation(size_t bytes) noexcept;
+void trackGpuDeallocation(size_t bytes) noexcept;
+
+struct MemoryCounters {
+    uint64_t liveBytes = 0;
+    uint64_t liveAllocations = 0;
+    uint64_t totalBytes = 0; // Ever allocated
+    uint64_t totalAllocations = 0;
+};
+struct MemoryStats {
+    std::array<MemoryCounters, MEMORY_TAG_COUNT> tags = {}; // Indexed by MemoryTag
+    MemoryCounters gpu = {};
+    // Across all tags, between the last two markMemoryFrame calls
+    uint64_t frameAllocations = 0;
+    uint64_t frameBytes = 0;
+};
+[[nodiscard]] MemoryStats memoryStats();
+// Whether this build counts every heap allocation (AIRSHIP_MEMORY_HOOKS)
+[[nodiscard]] bool memoryHooksEnabled();
+// Call once per frame, from one thread. Updates the per-frame stats and records every counter on the trace.
+void markMemoryFrame();
+
+// Passes allocations through to upstream, charging them to tag
+class TaggedResource : public std::pmr::memory_resource {
+public:
+    explicit TaggedResource(MemoryTag tag, std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) :
+        m_Tag(tag), m_Upstream(upstream) {}
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    MemoryTag m_Tag;
+    std::pmr::memory_resource* m_Upstream;
+};
 
 } // namespace Airship::Profiling
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Airship {
+
+// Where a callback may run. Main-thread callbacks always run on the thread driving the work (usually the game loop).
+enum class ThreadAffinity : uint8_t {
+    MainThread,
+    AnyThread // The callback is thread-safe, and may run on a worker, concurrently with itself
+};
+
+class JobSystem;
+namespace Detail {
+struct Job;
+class WorkStealingDeque;
+} // namespace Detail
+
+// Counts unfinished jobs. Wait on it with JobSystem::Wait, or pass it as another job's dependency to hold that job back
+// until the count reaches zero. Reusable once it has, but must outlive every job it counts or holds back.
+class JobCounter {
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    // Once this is true no job touches the counter again, so it can be destroyed straight away
+    [[nodiscard]] bool IsDone() const {
+        return m_Pending.load(std::memory_order_acquire) == 0 && m_Finishing.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobSystem;
+    std::atomic<uint32_t> m_Pending = 0;
+    // Jobs that may be the last to finish, and are still releasing the waiting jobs
+    std::atomic<uint32_t> m_Finishing = 0;
+    // Guards the waiting jobs and the error
+    std::mutex m_Mutex;
+    std::vector<Detail::Job*> m_Waiting;
+    std::exception_ptr m_Error;
+};
+
+// Runs jobs on one worker thread per core, less the thread that created it, which joins in whenever it waits.
+//
+// Every worker owns a Chase-Lev deque: it pushes and pops jobs at the bottom without contention, while idle workers
+// steal from the top. Jobs started by other threads go through a shared injection queue. Workers with nothing to do
+// sleep until a job is scheduled. Each worker is named in the Profiling trace, and every job is a trace scope.
+class JobSystem {
+public:
+    // Chunks ParallelFor aims to give each thread, so uneven chunks can be balanced out by stealing
+    static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+    static size_t DefaultWorkerCount();
+
+    explicit JobSystem(size_t workerCount = DefaultWorkerCount());
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    // Finishes every scheduled job before joining the workers
+    ~JobSystem();
+
+    // Not counting the thread that created the system
+    [[nodiscard]] size_t WorkerCount() const { return m_Threads.size(); }
+
+    // Schedule fn from any thread. counter, if given, counts the job until it has finished. The job won't start until
+    // dependency (if given) reaches zero. Exceptions are handed to whoever waits on counter; a job without one must not
+    // throw.
+    void Run(std::function<void()> fn, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+    // Runs other jobs on the calling thread until counter reaches zero, then rethrows the first exception thrown by a
+    // job it counted
+    void Wait(JobCounter& counter);
+    // Runs one scheduled job on the calling thread, if there is one. For threads that interleave their own work with
+    // helping out. Returns false if nothing was waiting.
+    bool RunPending();
+
+    // Calls fn(i) for every i in [begin, end), in chunks of grain indices, and returns when all have finished. A grain
+    // of 0 picks one that gives each thread CHUNKS_PER_THREAD chunks. The caller runs the first chunk itself.
+    template <std::invocable<size_t> Fn>
+    void ParallelFor(size_t begin, size_t end, Fn&& fn, size_t grain = 0) {
+        if (begin >= end) return;
+        const size_t count = end - begin;
+        if (grain == 0) grain = AutoGrain(count);
+        if (count <= grain) {
+            for (size_t i = begin; i < end; ++i)
+                fn(i);
+            return;
+        }
+
+        JobCounter counter;
+        for (size_t first = begin + grain; first < end; first += grain) {
+            const size_t last = first + std::min(grain, end - first);
+            Run(
+                [&fn, first, last] {
+                    for (size_t i = first; i < last; ++i)
+                        fn(i);
+                },
+                &counter);
+        }
+
+        // The other chunks refer to fn, so they have to finish even if this one throws
+        std::exception_ptr error;
+        try {
+            for (size_t i = begin; i < begin + grain; ++i)
+                fn(i);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        Wait(counter);
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    [[nodiscard]] size_t AutoGrain(size_t count) const;
+    void Schedule(Detail::Job* job);
+    // Own deque first, then the injection queue, then steal. worker is SIZE_MAX for threads without a deque.
+    Detail::Job* FindJob(size_t worker);
+    void Execute(Detail::Job* job);
+    // Count a job on counter as finished, and schedule whatever was waiting for it to reach zero
+    void Finish(JobCounter& counter);
+    void WorkerLoop(size_t worker);
+
+    // Index 0 belongs to the thread that created the system, the rest to m_Threads in order
+    std::vector<std::unique_ptr<Detail::WorkStealingDeque>> m_Deques;
+    std::mutex m_InjectionMutex;
+    std::deque<Detail::Job*> m_Injected;
+    std::atomic<size_t> m_InjectedCount = 0;
+
+    // Bumped whenever a job is scheduled. Idle workers sleep on it with atomic wait.
+    std::atomic<uint32_t> m_WorkEpoch = 0;
+    std::atomic<uint32_t> m_Sleeping = 0;
+    std::atomic<bool> m_Stopping = false;
+    std::vector<std::thread> m_Threads;
+};
+
+} // namespace Airship
@@ -11,6 +11,7 @@
 #include <unordered_map>
 #include <utility>
 
+#include "core/instrumentation.h"
 #include "spdlog/common.h"
 #include "spdlog/details/log_msg.h"
 #include "spdlog/logger.h"
@@ -31,6 +32,22 @@
 
 namespace Airship {
 
+// Charges what the sinks allocate (formatting, file writes) to the Logging memory tag
+class TaggedLogger : public spdlog::logger {
+public:
+    using spdlog::logger::logger;
+
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        MEMORY_TAG_SCOPE(Logging);
+        spdlog::logger::sink_it_(msg);
+    }
+    void flush_() override {
+        MEMORY_TAG_SCOPE(Logging);
+        spdlog::logger::flush_();
+    }
+};
+
 class ShipLog {
 public:
     enum class Level : uint8_t {
@@ -52,7 +69,7 @@ public:
         consoleSink->set_level(spdlog::level::info);
         m_ActiveSinks.emplace("default_log", consoleSink);
 
-        m_Logger = std::make_shared<spdlog::logger>("airship", consoleSink);
+        m_Logger = std::make_shared<TaggedLogger>("airship", consoleSink);
         m_Logger->enable_backtrace(32);
         m_Logger->set_pattern("[%l] %^%T.%e %s:%# [%!]: %v%$");
         m_Logger->set_level(spdlog::level::trace);
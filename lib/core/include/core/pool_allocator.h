@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Airship {
+
+namespace Detail {
+struct PoolThreadCache;
+} // namespace Detail
+
+// Process-wide slab allocator for small, frequently created objects. Sizes up to MAX_POOLED_SIZE are rounded up to one
+// of a handful of size classes, each carved out of SLAB_BYTES slabs that are never returned to the system. Every thread
+// keeps a cache of free objects per class and only takes the class lock to move BATCH_SIZE objects at a time between
+// its cache and the shared free list, so objects freed on another thread than the one that allocated them are fine.
+// Larger sizes go straight to operator new.
+//
+// Everything it hands out is aligned to alignof(std::max_align_t). Frees must pass the size that was allocated; PoolPtr
+// remembers it, so it also works through a base class pointer.
+class PoolAllocator {
+public:
+    static constexpr size_t MAX_POOLED_SIZE = 512;
+    static constexpr size_t SLAB_BYTES = 64 * 1024;
+    static constexpr uint32_t BATCH_SIZE = 32;
+    static constexpr std::array<uint32_t, 16> SIZE_CLASSES = {16,  32,  48,  64,  80,  96,  112, 128,
+                                                              160, 192, 224, 256, 320, 384, 448, 512};
+
+    struct SizeClassStats {
+        size_t objectSize;
+        size_t slabs;
+        size_t capacity; // Objects carved from the slabs
+        size_t sharedFree; // In the shared free list; the rest are live or in some thread's cache
+    };
+    struct Stats {
+        std::array<SizeClassStats, SIZE_CLASSES.size()> sizeClasses;
+        size_t reservedBytes; // Slab memory
+        uint64_t largeAllocations; // Live allocations over MAX_POOLED_SIZE
+    };
+
+    static PoolAllocator& Get();
+
+    PoolAllocator(const PoolAllocator&) = delete;
+    PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+    [[nodiscard]] void* Allocate(size_t bytes);
+    void Deallocate(void* ptr, size_t bytes) noexcept;
+
+    template <typename T, typename... Args>
+    [[nodiscard]] T* New(Args&&... args) {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types can't be pooled");
+        void* memory = Allocate(sizeof(T));
+        try {
+            return new (memory) T(std::forward<Args>(args)...);
+        } catch (...) {
+            Deallocate(memory, sizeof(T));
+            throw;
+        }
+    }
+    // bytes is sizeof the most derived type, for deleting through a base pointer
+    template <typename T>
+    void Delete(T* object, size_t bytes = sizeof(T)) noexcept {
+        if (object == nullptr) return;
+        object->~T();
+        Deallocate(object, bytes);
+    }
+
+    // For std::pmr containers
+    [[nodiscard]] std::pmr::memory_resource* Resource() { return &m_Resource; }
+
+    // Takes each class lock in turn, so it's a snapshot rather than an instant
+    [[nodiscard]] Stats GetStats();
+
+private:
+    // Free objects are linked through their first bytes
+    struct FreeObject {
+        FreeObject* next;
+    };
+    struct SizeClass {
+        std::mutex mutex; // Guards everything below
+        FreeObject* free = nullptr;
+        size_t freeCount = 0;
+        std::vector<std::unique_ptr<std::byte[]>> slabs;
+    };
+    class MemoryResource : public std::pmr::memory_resource {
+    public:
+        explicit MemoryResource(PoolAllocator& pool) : m_Pool(pool) {}
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+        [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        PoolAllocator& m_Pool;
+    };
+
+    friend struct Detail::PoolThreadCache;
+
+    PoolAllocator() = default;
+    // Moves up to count objects from the shared list into a linked list, carving a new slab if it's empty
+    FreeObject* TakeBatch(size_t sizeClass, uint32_t& count);
+    void ReturnBatch(size_t sizeClass, FreeObject* head, FreeObject* tail, uint32_t count) noexcept;
+
+    std::array<SizeClass, SIZE_CLASSES.size()> m_SizeClasses;
+    std::atomic<uint64_t> m_LargeAllocations = 0;
+    MemoryResource m_Resource{*this};
+};
+
+// Deleter for objects from PoolAllocator::New. Converts like the pointers do, carrying the size of the allocation.
+template <typename T>
+struct PoolDeleter {
+    size_t bytes = sizeof(T);
+
+    PoolDeleter() = default;
+    template <typename U>
+        requires std::is_convertible_v<U*, T*>
+    PoolDeleter(const PoolDeleter<U>& other) noexcept : bytes(other.bytes) {}
+
+    void operator()(T* object) const noexcept { PoolAllocator::Get().Delete(object, bytes); }
+};
+
+template <typename T>
+using PoolPtr = std::unique_ptr<T, PoolDeleter<T>>;
+
+template <typename T, typename... Args>
+[[nodiscard]] PoolPtr<T> MakePooled(Args&&... args) {
+    return PoolPtr<T>(PoolAllocator::Get().New<T>(std::forward<Args>(args)...));
+}
+
+} // namespace Airship
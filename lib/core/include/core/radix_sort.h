@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Airship::Utils {
+
+template <typename T>
+concept RadixSortable = requires(const T& item) {
+    { item.key } -> std::convertible_to<uint64_t>;
+};
+
+// Stable LSD radix sort on each item's 64-bit key, a byte per pass. A pass is skipped when every key has the same byte
+// there, so keys that leave whole bytes unused (or constant) only pay for the bytes that vary. scratch is resized to
+// match items and its contents are left unspecified; keeping it around between calls avoids the allocation.
+template <RadixSortable T>
+void radixSortByKey(std::vector<T>& items, std::vector<T>& scratch) {
+    constexpr size_t PASSES = sizeof(uint64_t);
+    if (items.size() < 2) return;
+
+    // One read of the keys counts every pass
+    std::array<std::array<size_t, 256>, PASSES> counts{};
+    for (const T& item : items) {
+        const auto key = static_cast<uint64_t>(item.key);
+        for (size_t pass = 0; pass < PASSES; ++pass)
+            ++counts[pass][(key >> (pass * 8)) & 0xFF];
+    }
+
+    scratch.resize(items.size());
+    std::vector<T>* from = &items;
+    std::vector<T>* to = &scratch;
+    for (size_t pass = 0; pass < PASSES; ++pass) {
+        std::array<size_t, 256>& offsets = counts[pass];
+        const uint64_t sharedByte = (static_cast<uint64_t>(from->front().key) >> (pass * 8)) & 0xFF;
+        if (offsets[sharedByte] == items.size()) continue;
+
+        size_t total = 0;
+        for (size_t& offset : offsets)
+            total += std::exchange(offset, total);
+        for (T& item : *from)
+            (*to)[offsets[(static_cast<uint64_t>(item.key) >> (pass * 8)) & 0xFF]++] = std::move(item);
+        std::swap(from, to);
+    }
+    if (from != &items) items.swap(scratch);
+}
+
+} // namespace Airship::Utils
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "core/job_system.h"
+
+namespace Airship {
+
+template <typename T>
+class Task;
+
+namespace Detail {
+struct TaskPromiseBase {
+    // Resumes whoever awaited the task once it finishes, straight from the final suspend point
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            const std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    Task<T> get_return_object() noexcept;
+    template <std::convertible_to<T> U>
+    void return_value(U&& value) {
+        result.emplace(std::forward<U>(value));
+    }
+    T Result() {
+        if (error) std::rethrow_exception(error);
+        return std::move(*result);
+    }
+
+    std::optional<T> result;
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object() noexcept;
+    void return_void() noexcept {}
+    void Result() {
+        if (error) std::rethrow_exception(error);
+    }
+};
+} // namespace Detail
+
+// A coroutine producing a T. Tasks are lazy: nothing runs until the task is co_awaited from another task, or handed to
+// TaskScheduler::Spawn to run on its own. Awaiting a task returns its result or rethrows what it threw. Destroying a
+// task destroys its coroutine, wherever it is suspended.
+template <typename T = void>
+class [[nodiscard]] Task {
+public:
+    using promise_type = Detail::TaskPromise<T>;
+
+    Task() = default;
+    Task(Task&& other) noexcept : m_Handle(std::exchange(other.m_Handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (m_Handle) m_Handle.destroy();
+            m_Handle = std::exchange(other.m_Handle, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (m_Handle) m_Handle.destroy();
+    }
+
+    [[nodiscard]] bool Valid() const { return static_cast<bool>(m_Handle); }
+    [[nodiscard]] bool Done() const { return m_Handle && m_Handle.done(); }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() noexcept { return handle.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume() { return handle.promise().Result(); }
+        };
+        return Awaiter{m_Handle};
+    }
+
+private:
+    friend struct Detail::TaskPromise<T>;
+    friend class TaskScheduler;
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_Handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_Handle;
+};
+
+template <typename T>
+Task<T> Detail::TaskPromise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+inline Task<void> Detail::TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+// Runs spawned tasks on the thread that calls Update, normally the game loop's. Tasks suspend on the awaitables below
+// instead of blocking, and Update resumes whichever have become ready, until its time budget runs out. Work handed to
+// RunJob or ReadFile runs on the job system, and the awaiting task resumes on the next Update after it finishes.
+//
+//     Task<> SpawnWaves(TaskScheduler& tasks) {
+//         const auto level = co_await tasks.ReadFile("waves.txt");
+//         for (const Wave& wave : ParseWaves(*level)) {
+//             SpawnWave(wave);
+//             co_await tasks.Delay(wave.delay);
+//         }
+//     }
+class TaskScheduler {
+public:
+    // Without a job system, RunJob and ReadFile do their work inline, when awaited
+    explicit TaskScheduler(JobSystem* jobs = nullptr);
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+    // Waits for jobs started by RunJob and ReadFile, then destroys any unfinished tasks
+    ~TaskScheduler();
+
+    // Starts task at the next Update. The scheduler owns it until it finishes.
+    void Spawn(Task<> task);
+    // Advances game time by dt seconds and resumes ready tasks, in the order they became ready, until none are left or
+    // budget has passed. Tasks still waiting after that go first next time. At least one task is resumed per call.
+    // Rethrows the first exception to escape a spawned task.
+    void Update(float dt, std::chrono::nanoseconds budget = std::chrono::nanoseconds::max());
+    // Spawned tasks that haven't finished yet
+    [[nodiscard]] size_t TaskCount() const { return m_Tasks.size(); }
+
+    struct NextFrameAwaiter {
+        TaskScheduler& scheduler;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { scheduler.m_NextFrame.push_back(handle); }
+        // The dt of the Update that resumed the task
+        float await_resume() const noexcept { return scheduler.m_LastDt; }
+    };
+    struct DelayAwaiter {
+        TaskScheduler& scheduler;
+        uint64_t dueNs;
+        bool await_ready() const noexcept { return dueNs <= scheduler.m_TimeNs; }
+        void await_suspend(std::coroutine_handle<> handle) { scheduler.AddTimer(dueNs, handle); }
+        void await_resume() const noexcept {}
+    };
+    struct CounterAwaiter {
+        TaskScheduler& scheduler;
+        const JobCounter& counter;
+        bool await_ready() const noexcept { return counter.IsDone(); }
+        void await_suspend(std::coroutine_handle<> handle) { scheduler.m_Polled.emplace_back(&counter, handle); }
+        void await_resume() const noexcept {}
+    };
+    // Runs fn on the job system when awaited, and returns its result or rethrows what it threw
+    template <std::invocable Fn>
+    class JobAwaiter {
+    public:
+        using Result = std::invoke_result_t<Fn&>;
+
+        JobAwaiter(TaskScheduler& scheduler, Fn fn) : m_Scheduler(scheduler), m_Fn(std::move(fn)) {}
+        JobAwaiter(const JobAwaiter&) = delete;
+        JobAwaiter& operator=(const JobAwaiter&) = delete;
+
+        bool await_ready() {
+            if (m_Scheduler.m_JobSystem != nullptr) return false;
+            Invoke();
+            return true;
+        }
+        void await_suspend(std::coroutine_handle<> handle) {
+            // The awaiter lives in the suspended coroutine's frame, and the coroutine can't resume until Post
+            m_Scheduler.m_JobSystem->Run(
+                [this, scheduler = &m_Scheduler, handle] {
+                    Invoke();
+                    scheduler->Post(handle);
+                },
+                &m_Scheduler.m_Jobs);
+        }
+        Result await_resume() {
+            if (m_Error) std::rethrow_exception(m_Error);
+            if constexpr (!std::is_void_v<Result>) return std::move(*m_Result);
+        }
+
+    private:
+        void Invoke() {
+            try {
+                if constexpr (std::is_void_v<Result>)
+                    m_Fn();
+                else
+                    m_Result.emplace(m_Fn());
+            } catch (...) {
+                m_Error = std::current_exception();
+            }
+        }
+
+        TaskScheduler& m_Scheduler;
+        Fn m_Fn;
+        std::optional<std::conditional_t<std::is_void_v<Result>, bool, Result>> m_Result;
+        std::exception_ptr m_Error;
+    };
+
+    // Awaitables. Each resumes the awaiting task from a later Update.
+    // Resumes on the next Update, giving its dt
+    [[nodiscard]] NextFrameAwaiter NextFrame() { return {*this}; }
+    // Resumes once Update has advanced game time by at least seconds. Doesn't suspend for 0 or less.
+    [[nodiscard]] DelayAwaiter Delay(float seconds);
+    // Resumes once counter reaches zero. Checked once per Update, so the jobs needn't know about the scheduler.
+    [[nodiscard]] CounterAwaiter WaitFor(const JobCounter& counter) { return {*this, counter}; }
+    template <std::invocable Fn>
+    [[nodiscard]] JobAwaiter<Fn> RunJob(Fn fn) {
+        return JobAwaiter<Fn>(*this, std::move(fn));
+    }
+    // Reads a whole file on the job system. nullopt, with a warning logged, if it couldn't be read.
+    [[nodiscard]] auto ReadFile(std::filesystem::path path) {
+        return RunJob([path = std::move(path)] { return ReadWholeFile(path); });
+    }
+
+private:
+    struct Timer {
+        uint64_t dueNs;
+        // Keeps timers due at the same time in the order they were set
+        uint64_t sequence;
+        std::coroutine_handle<> handle;
+    };
+
+    static std::optional<std::string> ReadWholeFile(const std::filesystem::path& path);
+    void AddTimer(uint64_t dueNs, std::coroutine_handle<> handle);
+    // From any thread
+    void Post(std::coroutine_handle<> handle);
+
+    JobSystem* m_JobSystem;
+    JobCounter m_Jobs;
+    std::vector<Task<>> m_Tasks;
+    std::deque<std::coroutine_handle<>> m_Ready;
+    std::vector<std::coroutine_handle<>> m_NextFrame;
+    std::vector<Timer> m_Timers; // Min-heap on (dueNs, sequence)
+    uint64_t m_TimerSequence = 0;
+    std::vector<std::pair<const JobCounter*, std::coroutine_handle<>>> m_Polled;
+    uint64_t m_TimeNs = 0;
+    float m_LastDt = 0.0f;
+
+    std::mutex m_PostedMutex; // Guards m_Posted
+    std::vector<std::coroutine_handle<>> m_Posted;
+};
+
+} // namespace Airship
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "core/instrumentation.h"
+
+// Compact binary encoding for Profiling traces, converted to chrome-tracing JSON offline by the airship-trace tool.
+//
+// header:  "ASTR" magic, u8 version, varint nanoseconds per timestamp tick
+// records: u8 tag, then
+//   String: varint id, varint length, bytes - defines a name before its first use
+//   Event:  varint tid, varint name id, varint zigzag(timestamp - previous timestamp on the same tid)
+//           counter events add varint zigzag(value) (version 3)
+// A threadName event labels its tid with its name (version 2).
+//
+// Names are interned by pointer (they're string literals), timestamps are delta-encoded per thread, and every integer
+// is a LEB128 varint, so a typical event costs ~4 bytes instead of ~60 in JSON.
+
+namespace Airship::Profiling {
+
+enum class TraceEventType : uint8_t {
+    start,
+    end,
+    threadName, // Metadata: the event's name is the thread's name, and its timestamp is meaningless
+    counter // One sample of the time series named by the event
+};
+
+constexpr std::string_view BINARY_TRACE_MAGIC = "ASTR";
+constexpr uint8_t BINARY_TRACE_VERSION = 3;
+
+// Event tags are EVENT_RECORD_TAG | TraceEventType
+constexpr uint8_t STRING_RECORD_TAG = 0x01;
+constexpr uint8_t EVENT_RECORD_TAG = 0x80;
+
+// Writes one chrome-tracing event object, followed by a comma. value is only used by counter events. name is escaped,
+// so it may hold any characters.
+void writeJsonEvent(std::ostream& out, std::string_view name, TraceEventType type, uint64_t timestampNs, uint32_t tid,
+                    int64_t value = 0);
+
+class BinaryTraceWriter {
+public:
+    BinaryTraceWriter(std::ostream& out, uint64_t nsPerTick);
+    BinaryTraceWriter(const BinaryTraceWriter&) = delete;
+    BinaryTraceWriter& operator=(const BinaryTraceWriter&) = delete;
+    ~BinaryTraceWriter();
+
+    void write(const char* name, TraceEventType type, uint64_t timestamp, uint32_t tid, int64_t value = 0);
+    void flush();
+    [[nodiscard]] size_t bytesWritten() const { return m_BytesWritten + m_Buffer.size(); }
+
+private:
+    void putVarint(uint64_t value);
+
+    std::ostream& m_Out;
+    std::string m_Buffer;
+    size_t m_BytesWritten = 0;
+    std::unordered_map<const char*, uint32_t> m_StringIds;
+    std::unordered_map<uint32_t, uint64_t> m_LastTimestamp;
+};
+
+class BinaryTraceReader {
+public:
+    struct Event {
+        std::string_view name;
+        TraceEventType type;
+        uint64_t timestamp;
+        uint32_t tid;
+        int64_t value; // Counter events only
+    };
+
+    BinaryTraceReader(std::istream& in);
+
+    // False if the header was missing or a record was malformed
+    [[nodiscard]] bool ok() const { return !m_Failed; }
+    [[nodiscard]] uint64_t nsPerTick() const { return m_NsPerTick; }
+
+    // Reads up to the next event, consuming any string definitions on the way. Returns false at the end of the stream
+    // or on error.
+    bool next(Event& event);
+
+private:
+    bool getVarint(uint64_t& value);
+
+    std::istream& m_In;
+    bool m_Failed = false;
+    uint64_t m_NsPerTick = 1;
+    std::vector<std::string> m_Strings;
+    std::unordered_map<uint32_t, uint64_t> m_LastTimestamp;
+};
+
+} // namespace Airship::Profiling
@@ -3,13 +3,20 @@
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 
+#include "core/frame_arena.h"
+#include "core/frame_graph.h"
+#include "core/frame_stats.h"
 #include "core/input.h"
 #include "core/instrumentation.h"
+#include "core/job_system.h"
 #include "core/logging.h"
+#include "core/task.h"
 #include "core/window.h"
 #include "opengl/renderer.h"
 
@@ -17,60 +24,196 @@ namespace Airship {
 
 Application::Application(bool servermode) : m_ServerMode(servermode) {
     assert(m_ServerMode);
+    SetTargetFrameRate(DEFAULT_SERVER_TICK_RATE);
 }
 
-Application::Application(int width, int height, std::string title) :
-    m_Width(width), m_Height(height), m_Title(std::move(title)) {}
+Application::Application(int width, int height, std::string title, bool visible) :
+    m_Width(width), m_Height(height), m_Title(std::move(title)), m_Visible(visible) {}
 
 void Application::Run() {
+    // Stream the trace to disk while running, unless the game already set up its own stream
+    const bool ownsTraceStream = Profiling::startStreaming({.basePath = "temp_file"});
+    Profiling::setThreadName("Main");
+
+    // Servers never touch GLFW or GL, so they start quickly and run without a display
+    if (!m_ServerMode) InitWindowAndRenderer();
+    {
+        MEMORY_TAG_SCOPE(Game);
+        OnStart();
+    }
+    GameLoop();
+    if (ownsTraceStream) Profiling::stopStreaming();
+}
+
+void Application::InitWindowAndRenderer() {
+    PROFILE_FUNCTION();
     Window::Init();
     if (m_Width < 0 || m_Height < 0) SHIPLOG_ERROR("Creating a window with negative dimensions");
-    m_MainWindow = std::make_unique<Window>(m_Width, m_Height, m_Title, !m_ServerMode);
-    if (!m_ServerMode) {
-        m_MainWindow->setWindowResizeCallback([this](int width, int height) {
-            m_Renderer.resize(width, height);
-            m_Height = height;
-            m_Width = width;
+    m_MainWindow = std::make_unique<Window>(m_Width, m_Height, m_Title, m_Visible);
+    m_MainWindow->setWindowResizeCallback([this](int width, int height) {
+        m_Renderer.resize(width, height);
+        m_Height = height;
+        m_Width = width;
+    });
+    m_MainWindow->setKeyPressCallback(
+        [this](const Window& window, Input::Key key, int scancode, Input::KeyAction action, Input::KeyMods mods) {
+            OnKeyPress(window, key, scancode, action, mods);
         });
-        m_MainWindow->setKeyPressCallback(
-            [this](const Window& window, Input::Key key, int scancode, Input::KeyAction action, Input::KeyMods mods) {
-                OnKeyPress(window, key, scancode, action, mods);
-            });
-    }
 
     m_Renderer.init();
     m_Renderer.resize(m_Width, m_Height);
-    OnStart();
-    GameLoop();
-    Profiling::dump("temp_file");
+    m_Renderer.setFrameArena(&m_FrameArena);
+}
+
+void Application::SetFixedTimestep(float seconds, int maxStepsPerFrame) {
+    assert(seconds >= 0 && maxStepsPerFrame > 0);
+    m_FixedStepNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                              std::chrono::duration<float>(seconds))
+                                              .count());
+    m_MaxFixedSteps = maxStepsPerFrame;
+}
+
+void Application::SetTargetFrameRate(float framesPerSecond) {
+    assert(framesPerSecond >= 0);
+    m_TargetFrameNs = framesPerSecond > 0 ? static_cast<uint64_t>(1e9 / framesPerSecond) : 0;
+}
+
+JobSystem& Application::GetJobSystem() {
+    if (!m_JobSystem) m_JobSystem = std::make_unique<JobSystem>();
+    return *m_JobSystem;
+}
+
+TaskScheduler& Application::GetTaskScheduler() {
+    if (!m_TaskScheduler) m_TaskScheduler = std::make_unique<TaskScheduler>(&GetJobSystem());
+    return *m_TaskScheduler;
 }
 
 void Application::GameLoop() {
     PROFILE_FUNCTION();
-    auto startTime = std::chrono::system_clock::now();
+    uint64_t frameStart = Profiling::now();
+    uint64_t lastStatsLog = frameStart;
+    uint64_t fixedAccumulator = 0;
+    uint64_t frameIndex = 0;
     while (!m_ShouldClose) {
         PROFILE_SCOPE("frame");
+        m_FrameArena.NewFrame();
+        Profiling::markMemoryFrame();
+        const uint64_t pollStart = Profiling::now();
         if (m_MainWindow) m_MainWindow->pollEvents();
-        auto frameTime = std::chrono::system_clock::now() - startTime;
-        startTime = std::chrono::system_clock::now();
-        auto elapsed = std::chrono::duration<float>(frameTime).count();
+        const uint64_t pollEnd = Profiling::now();
+        m_FrameStats.poll.record(pollEnd - pollStart);
+
+        const uint64_t frameTime = pollStart - frameStart;
+        frameStart = pollStart;
+        m_FrameStats.frame.record(frameTime);
+        auto elapsed = std::chrono::duration<float>(std::chrono::nanoseconds(frameTime)).count();
         elapsed = std::min(elapsed, 0.1f); // Clamp to avoid large jumps
 
+        float alpha = 1.0f;
+        if (m_FixedStepNs > 0) {
+            PROFILE_SCOPE("Fixed update");
+            MEMORY_TAG_SCOPE(Game);
+            // Integer nanoseconds, so the step sequence doesn't depend on float rounding of the frame times
+            fixedAccumulator += frameTime;
+            const float fixedDt = std::chrono::duration<float>(std::chrono::nanoseconds(m_FixedStepNs)).count();
+            int steps = 0;
+            while (fixedAccumulator >= m_FixedStepNs && steps < m_MaxFixedSteps) {
+                OnFixedUpdate(fixedDt);
+                fixedAccumulator -= m_FixedStepNs;
+                ++steps;
+            }
+            // Too far behind to catch up, so slow the simulation down rather than spiralling
+            if (fixedAccumulator >= m_FixedStepNs) fixedAccumulator %= m_FixedStepNs;
+            alpha = static_cast<float>(fixedAccumulator) / static_cast<float>(m_FixedStepNs);
+        }
+
+        if (m_TaskScheduler) m_TaskScheduler->Update(elapsed, m_TaskBudget);
         {
             PROFILE_SCOPE("User game loop");
+            MEMORY_TAG_SCOPE(Game);
             OnGameLoop(elapsed);
         }
+        if (!m_FrameGraph.Empty()) m_FrameGraph.Execute(&GetJobSystem(), {.index = frameIndex++, .dt = elapsed});
+        {
+            PROFILE_SCOPE("User render");
+            MEMORY_TAG_SCOPE(Game);
+            OnRender(alpha);
+        }
+        const uint64_t updateEnd = Profiling::now();
+        m_FrameStats.update.record(updateEnd - pollEnd);
 
-        // Show the rendered buffer
+        // Submit the queued draws, then show the rendered buffer
+        uint64_t flushEnd = updateEnd;
         if (m_MainWindow) {
+            m_Renderer.endFrame();
+            flushEnd = Profiling::now();
+            m_FrameStats.flush.record(flushEnd - updateEnd);
             m_MainWindow->swapBuffers();
             m_ShouldClose |= m_MainWindow->shouldClose();
         }
+        const uint64_t swapEnd = Profiling::now();
+        m_FrameStats.swap.record(swapEnd - flushEnd);
+
+        if (m_TargetFrameNs > 0) WaitForNextFrame(frameStart);
+
+        if (m_FrameStatsLogInterval.count() > 0 &&
+            std::chrono::nanoseconds(swapEnd - lastStatsLog) >= m_FrameStatsLogInterval) {
+            LogFrameStats();
+            m_FrameStats.reset();
+            m_FrameArena.ResetPeak();
+            lastStatsLog = swapEnd;
+        }
+    }
+    if (!m_FrameGraph.Empty()) m_FrameGraph.Flush(&GetJobSystem());
+}
+
+void Application::WaitForNextFrame(uint64_t frameStart) const {
+    PROFILE_FUNCTION();
+    // OS sleeps can overshoot by up to a scheduler tick, so sleep until shortly before the deadline and spin the rest
+    constexpr uint64_t SPIN_NS = 1'000'000;
+    const uint64_t deadline = frameStart + m_TargetFrameNs;
+    uint64_t current = Profiling::now();
+    if (current + SPIN_NS < deadline) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(deadline - current - SPIN_NS));
+        current = Profiling::now();
+    }
+    while (current < deadline) {
+        std::this_thread::yield();
+        current = Profiling::now();
     }
 }
 
+void Application::LogFrameStats() const {
+    constexpr double NS_PER_MS = 1e6;
+    const auto ms = [](const DurationHistogram& histogram, double fraction) {
+        return double(histogram.percentile(fraction)) / NS_PER_MS;
+    };
+    const DurationHistogram& frame = m_FrameStats.frame;
+    const Profiling::MemoryStats memory = Profiling::memoryStats();
+    SHIPLOG_INFO("{} frames, frame ms p50 {:.2f} p99 {:.2f} p99.9 {:.2f} max {:.2f} | update p99 {:.2f} | poll p99 "
+                 "{:.2f} | flush p99 {:.2f} | swap p99 {:.2f} | frame arena peak {} KiB | GPU buffers {} KiB",
+                 frame.count(), ms(frame, 0.5), ms(frame, 0.99), ms(frame, 0.999), double(frame.max()) / NS_PER_MS,
+                 ms(m_FrameStats.update, 0.99), ms(m_FrameStats.poll, 0.99), ms(m_FrameStats.flush, 0.99),
+                 ms(m_FrameStats.swap, 0.99), m_FrameArena.PeakFrameBytes() / 1024, memory.gpu.liveBytes / 1024);
+    if (m_MainWindow) {
+        const RenderStats& render = m_Renderer.frameStats();
+        SHIPLOG_INFO("last frame: {} draws, {} program binds, {} vertex array binds, {} uniform uploads", render.draws,
+                     render.programBinds, render.vertexArrayBinds, render.uniformUploads);
+    }
+
+    // Without the hooks, the heap numbers only cover TaggedResource and trackAllocation
+    if (!Profiling::memoryHooksEnabled()) return;
+    const auto kib = [&memory](Profiling::MemoryTag tag) {
+        return memory.tags[static_cast<size_t>(tag)].liveBytes / 1024;
+    };
+    SHIPLOG_INFO("heap KiB: renderer {} events {} logging {} game {} untagged {} | {} allocations last frame",
+                 kib(Profiling::MemoryTag::Renderer), kib(Profiling::MemoryTag::Events),
+                 kib(Profiling::MemoryTag::Logging), kib(Profiling::MemoryTag::Game),
+                 kib(Profiling::MemoryTag::Untagged), memory.frameAllocations);
+}
+
 Application::~Application() {
-    if (!m_ServerMode) {
+    if (m_MainWindow) {
         m_MainWindow.reset();
         Window::Terminate();
     }
@@ -1,43 +1,273 @@
 #include "core/event.h"
 
 #include <algorithm>
-#include <memory>
-#include <mutex>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "core/instrumentation.h"
+#include "core/logging.h"
+
 namespace Airship {
 
+EventTypeId Detail::NextEventTypeId() {
+    static std::atomic<EventTypeId> nextId = 0;
+    return nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
 EventPublisher::~EventPublisher() {
-    for (auto& [subscriber, callbacks] : m_SubscriberCallbacks)
-        subscriber->CancelSubscription(*this);
+    for (const auto& slot : m_Slots) {
+        if (slot.subscriber) slot.subscriber->CancelSubscription(*this);
+    }
+    for (auto& page : m_PolicyPages)
+        delete page.load(std::memory_order_relaxed);
+}
+
+SubscriptionHandle EventPublisher::AddCallback(EventSubscriber& subscriber, EventTypeId type, bool batch,
+                                               EventCallbackFn callback, ThreadAffinity affinity) {
+    uint32_t index;
+    if (!m_FreeSlots.empty()) {
+        index = m_FreeSlots.back();
+        m_FreeSlots.pop_back();
+    } else {
+        index = static_cast<uint32_t>(m_Slots.size());
+        m_Slots.emplace_back();
+    }
+    SubscriptionSlot& slot = m_Slots[index];
+    slot.subscriber = &subscriber;
+    slot.type = type;
+    slot.batch = batch;
+    ++m_LiveCount;
+
+    auto& handles = subscriber.m_Subscriptions[this];
+    slot.subscriberPosition = static_cast<uint32_t>(handles.size());
+    handles.push_back({.m_Index = index, .m_Generation = slot.generation});
+
+    EventCallback entry{.m_Callback = std::move(callback), .m_Slot = index, .m_Affinity = affinity};
+    if (m_DispatchDepth > 0) {
+        slot.position = PENDING_POSITION;
+        m_PendingCallbacks.push_back({.type = type, .generation = slot.generation, .entry = std::move(entry)});
+    } else {
+        if (type >= m_Channels.size()) m_Channels.resize(type + 1);
+        auto& entries = ListFor(slot).entries;
+        slot.position = static_cast<uint32_t>(entries.size());
+        entries.push_back(std::move(entry));
+    }
+    return {.m_Index = index, .m_Generation = slot.generation};
+}
+
+bool EventPublisher::Unsubscribe(SubscriptionHandle handle) {
+    if (!IsLive(handle)) return false;
+    SubscriptionSlot& slot = m_Slots[handle.m_Index];
+
+    // Leave a tombstone rather than erasing: the callback may be running right now, and erasing would shift every
+    // later callback in the channel. Pending subscriptions are dropped by FinishDispatch once the generation changes.
+    if (slot.position != PENDING_POSITION) {
+        CallbackList& list = ListFor(slot);
+        list.entries[slot.position].m_Slot = EventCallback::TOMBSTONE;
+        ++list.tombstones;
+        if (list.tombstones * 2 > list.entries.size()) {
+            if (m_DispatchDepth == 0)
+                Compact(slot.type);
+            else
+                m_CompactAfterDispatch = true;
+        }
+    }
+
+    // Swap-remove from the subscriber's handles, moving its last one into the gap
+    auto subscription = slot.subscriber->m_Subscriptions.find(this);
+    auto& handles = subscription->second;
+    const SubscriptionHandle moved = handles.back();
+    handles[slot.subscriberPosition] = moved;
+    m_Slots[moved.m_Index].subscriberPosition = slot.subscriberPosition;
+    handles.pop_back();
+    if (handles.empty()) slot.subscriber->m_Subscriptions.erase(subscription);
+
+    slot.subscriber = nullptr;
+    ++slot.generation;
+    m_FreeSlots.push_back(handle.m_Index);
+    --m_LiveCount;
+    return true;
 }
 
 void EventPublisher::RemoveSubscriber(EventSubscriber& subscriber) {
-    auto subscriberCallbacksRange = m_SubscriberCallbacks.equal_range(&subscriber);
-    for (auto it = subscriberCallbacksRange.first; it != subscriberCallbacksRange.second; ++it) {
-        std::erase_if(m_EventCallbacks, [&it](const auto& item) { return item.second.m_Handle == it->second; });
+    subscriber.UnsubscribeAll(*this);
+}
+
+void EventPublisher::Dispatch(EventTypeId type, const void* event, bool includeBatch) {
+    if (type >= m_Channels.size()) return;
+
+    const DispatchScope scope(*this);
+    // Nothing is added to or removed from callbacks while dispatching, so iterating is safe
+    const Channel& channel = m_Channels[type];
+    for (const auto& callback : channel.single.entries) {
+        if (callback.m_Slot != EventCallback::TOMBSTONE) callback.m_Callback(event, 1);
+    }
+    if (includeBatch) {
+        for (const auto& callback : channel.batch.entries) {
+            if (callback.m_Slot != EventCallback::TOMBSTONE) callback.m_Callback(event, 1);
+        }
+    }
+}
+
+EventPublisher::DispatchScope::~DispatchScope() {
+    if (--m_Publisher.m_DispatchDepth > 0) return;
+    if (!m_Publisher.m_PendingCallbacks.empty() || m_Publisher.m_CompactAfterDispatch) m_Publisher.FinishDispatch();
+}
+
+EventPublisher::StagingScope::~StagingScope() {
+    for (const EventTypeId type : m_Publisher.m_StagedTypes)
+        m_Publisher.m_Channels[type].staging->Clear();
+    m_Publisher.m_StagedTypes.clear();
+}
+
+void EventPublisher::DispatchStaged() {
+    const DispatchScope scope(*this);
+    if (m_JobSystem != nullptr) DispatchParallel();
+    for (const EventTypeId type : m_StagedTypes) {
+        const Channel& channel = m_Channels[type];
+        for (const auto& callback : channel.batch.entries) {
+            if (callback.m_Slot != EventCallback::TOMBSTONE)
+                callback.m_Callback(channel.staging->Data(), channel.staging->Count());
+        }
+    }
+}
+
+void EventPublisher::DispatchParallel() {
+    // Workers only ever touch the callback functions, which stay put until the outermost dispatch returns. Tombstones
+    // and pending subscriptions are main-thread state.
+    JobCounter counter;
+    for (const EventTypeId type : m_StagedTypes) {
+        const Channel& channel = m_Channels[type];
+        const std::byte* events = channel.staging->Data();
+        const size_t count = channel.staging->Count();
+        const size_t stride = channel.staging->stride;
+        for (const auto& callback : channel.single.entries) {
+            if (callback.m_Slot == EventCallback::TOMBSTONE || callback.m_Affinity != ThreadAffinity::AnyThread)
+                continue;
+            for (size_t first = 0; first < count; first += EVENTS_PER_JOB) {
+                const size_t last = std::min(first + EVENTS_PER_JOB, count);
+                m_JobSystem->Run(
+                    [fn = &callback.m_Callback, events, first, last, stride] {
+                        for (size_t i = first; i < last; ++i)
+                            (*fn)(events + i * stride, 1);
+                    },
+                    &counter);
+            }
+        }
+    }
+
+    // Jobs reference this frame's staged events, so they must finish even if a main-thread callback throws
+    std::exception_ptr error;
+    try {
+        for (const EventTypeId type : m_StagedTypes) {
+            const Channel& channel = m_Channels[type];
+            for (size_t i = 0; i < channel.staging->Count(); ++i) {
+                const std::byte* event = channel.staging->Data() + i * channel.staging->stride;
+                for (const auto& callback : channel.single.entries) {
+                    if (callback.m_Slot != EventCallback::TOMBSTONE &&
+                        callback.m_Affinity == ThreadAffinity::MainThread)
+                        callback.m_Callback(event, 1);
+                }
+            }
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+    m_JobSystem->Wait(counter);
+    if (error) std::rethrow_exception(error);
+}
+
+void EventPublisher::FinishDispatch() {
+    for (auto& [type, generation, entry] : m_PendingCallbacks) {
+        // Unsubscribed before it was ever added
+        SubscriptionSlot& slot = m_Slots[entry.m_Slot];
+        if (slot.generation != generation) continue;
+        if (type >= m_Channels.size()) m_Channels.resize(type + 1);
+        auto& entries = ListFor(slot).entries;
+        slot.position = static_cast<uint32_t>(entries.size());
+        entries.push_back(std::move(entry));
     }
+    m_PendingCallbacks.clear();
 
-    m_SubscriberCallbacks.erase(&subscriber);
+    if (!m_CompactAfterDispatch) return;
+    m_CompactAfterDispatch = false;
+    for (EventTypeId type = 0; type < m_Channels.size(); ++type)
+        Compact(type);
+}
+
+void EventPublisher::Compact(EventTypeId type) {
+    assert(m_DispatchDepth == 0);
+    for (CallbackList* list : {&m_Channels[type].single, &m_Channels[type].batch}) {
+        if (list->tombstones * 2 <= list->entries.size()) continue;
+        std::erase_if(list->entries, [](const auto& entry) { return entry.m_Slot == EventCallback::TOMBSTONE; });
+        for (uint32_t i = 0; i < list->entries.size(); ++i)
+            m_Slots[list->entries[i].m_Slot].position = i;
+        list->tombstones = 0;
+    }
+}
+
+EventPublisher::TypePolicy* EventPublisher::PolicyFor(EventTypeId id) {
+    if (id >= MAX_POLICY_TYPES) {
+        SHIPLOG_ERROR("Event type {} is past the {} that can have queue policies, leaving it on the defaults", id,
+                      MAX_POLICY_TYPES);
+        return nullptr;
+    }
+    std::atomic<PolicyPage*>& page = m_PolicyPages[id / POLICY_PAGE_SIZE];
+    if (page.load(std::memory_order_relaxed) == nullptr) page.store(new PolicyPage(), std::memory_order_release);
+    PoolPtr<TypePolicy>& policy = (*page.load(std::memory_order_relaxed))[id % POLICY_PAGE_SIZE];
+    if (!policy) policy = MakePooled<TypePolicy>();
+    return policy.get();
 }
 
 void EventPublisher::Process() {
-    std::unique_lock<std::mutex> lock(m_QueueMutex);
-    std::vector<std::unique_ptr<EventWrapperInterface>> events;
-    std::swap(events, m_QueuedEvents);
-    lock.unlock();
+    MEMORY_TAG_SCOPE(Events);
+    const StagingScope staging(*this);
+    for (EventQueue& lane : m_Lanes)
+        lane.Drain(this);
+    DispatchStaged();
+}
+
+void EventPublisher::Process(std::chrono::nanoseconds budget) {
+    MEMORY_TAG_SCOPE(Events);
+    const auto now = EventQueue::Clock::now();
+    const auto deadline =
+        budget >= EventQueue::Clock::time_point::max() - now ? EventQueue::Clock::time_point::max() : now + budget;
+    const StagingScope staging(*this);
+    m_Lanes[static_cast<size_t>(EventPriority::Critical)].Drain(this);
+    m_Lanes[static_cast<size_t>(EventPriority::Normal)].Drain(this);
+    m_Lanes[static_cast<size_t>(EventPriority::Low)].Drain(this, deadline);
+    DispatchStaged();
+}
+
+bool EventSubscriber::Unsubscribe(EventPublisher& publisher, SubscriptionHandle handle) {
+    // The publisher takes the handle out of m_Subscriptions
+    if (!m_Subscriptions.contains(&publisher)) return false;
+    return publisher.Unsubscribe(handle);
+}
 
-    for (const auto& eventWrapper : events)
-        eventWrapper->PublishSync(this);
+void EventSubscriber::UnsubscribeAll(EventPublisher& publisher) {
+    auto it = m_Subscriptions.find(&publisher);
+    if (it == m_Subscriptions.end()) return;
+    // A copy, since each unsubscribe edits the list
+    const std::vector<SubscriptionHandle> handles = it->second;
+    for (const auto handle : handles)
+        publisher.Unsubscribe(handle);
+    m_Subscriptions.erase(&publisher);
 }
 
 void EventSubscriber::CancelSubscription(EventPublisher& publisher) {
-    m_Subscribed.erase(&publisher);
+    m_Subscriptions.erase(&publisher);
 }
 
 EventSubscriber::~EventSubscriber() {
-    for (auto* publisher : m_Subscribed)
-        publisher->RemoveSubscriber(*this);
+    while (!m_Subscriptions.empty())
+        UnsubscribeAll(*m_Subscriptions.begin()->first);
 }
 } // namespace Airship
@@ -0,0 +1,144 @@
+#include "core/event_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <thread>
+
+namespace Airship {
+
+EventQueue::Chunk::Chunk(size_t bytes) :
+    data(static_cast<std::byte*>(::operator new(bytes, std::align_val_t(RECORD_ALIGNMENT)))), capacity(bytes) {}
+
+EventQueue::Chunk::~Chunk() {
+    ::operator delete(data, std::align_val_t(RECORD_ALIGNMENT));
+}
+
+EventQueue::EventQueue() {
+    m_Current.store(m_Arenas.data(), std::memory_order_release);
+}
+
+EventQueue::~EventQueue() {
+    for (Arena& arena : m_Arenas) {
+        Chunk* head = arena.head.load(std::memory_order_relaxed);
+        Cursor cursor = &arena == m_Draining ? m_Resume : Cursor{.chunk = head, .offset = 0};
+        Consume(cursor, nullptr, false, Clock::time_point::max());
+        for (Chunk* chunk = head; chunk != nullptr;) {
+            Chunk* next = chunk->next.load(std::memory_order_relaxed);
+            delete chunk;
+            chunk = next;
+        }
+    }
+}
+
+EventQueue::Arena& EventQueue::EnterArena() {
+    // Pairs with the swap in Drain: either we see the new arena and retry, or the drain sees us and waits.
+    // Both sides need sequential consistency for that to hold.
+    while (true) {
+        Arena* arena = m_Current.load(std::memory_order_seq_cst);
+        arena->writers.fetch_add(1, std::memory_order_seq_cst);
+        if (m_Current.load(std::memory_order_seq_cst) == arena) return *arena;
+        LeaveArena(*arena);
+    }
+}
+
+void* EventQueue::Reserve(Arena& arena, size_t bytes) {
+    Chunk* chunk = arena.tail.load(std::memory_order_acquire);
+    if (chunk == nullptr) chunk = FirstChunk(arena, bytes);
+    while (true) {
+        const size_t offset = chunk->used.fetch_add(bytes, std::memory_order_relaxed);
+        if (offset + bytes <= chunk->capacity) return chunk->data + offset;
+
+        // Only the first producer to overflow starts below capacity; it marks where the chunk's records end
+        if (offset < chunk->capacity && chunk->capacity - offset >= sizeof(RecordHeader))
+            new (chunk->data + offset) RecordHeader{.dispatch = nullptr, .destroy = nullptr, .bytes = 0};
+
+        // Move to the next chunk, reusing last frame's if it's there
+        Chunk* next = chunk->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            auto* fresh = new Chunk(std::max(CHUNK_BYTES, bytes));
+            if (chunk->next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel))
+                next = fresh;
+            else
+                delete fresh; // Another producer got there first
+        }
+        arena.tail.compare_exchange_strong(chunk, next, std::memory_order_acq_rel);
+        chunk = next;
+    }
+}
+
+EventQueue::Chunk* EventQueue::FirstChunk(Arena& arena, size_t bytes) {
+    Chunk* head = nullptr;
+    auto* fresh = new Chunk(std::max(CHUNK_BYTES, bytes));
+    if (arena.head.compare_exchange_strong(head, fresh, std::memory_order_acq_rel))
+        head = fresh;
+    else
+        delete fresh; // Another producer got there first
+    Chunk* tail = nullptr;
+    arena.tail.compare_exchange_strong(tail, head, std::memory_order_acq_rel);
+    return head;
+}
+
+bool EventQueue::Consume(Cursor& cursor, void* context, bool dispatch, Clock::time_point deadline) {
+    const bool timed = deadline != Clock::time_point::max();
+    uint32_t consumed = 0;
+    for (; cursor.chunk != nullptr; cursor.chunk = cursor.chunk->next.load(std::memory_order_acquire)) {
+        Chunk* chunk = cursor.chunk;
+        const size_t end = std::min(chunk->used.load(std::memory_order_relaxed), chunk->capacity);
+        while (end - cursor.offset >= sizeof(RecordHeader)) {
+            auto* header = reinterpret_cast<RecordHeader*>(chunk->data + cursor.offset);
+            if (header->bytes == 0) break;
+            try {
+                if (dispatch && header->dispatch) header->dispatch(context, Payload(header));
+            } catch (...) {
+                // Step past the record before letting the exception out, so the next drain resumes after it instead of
+                // dispatching it again
+                Retire(cursor, header);
+                throw;
+            }
+            Retire(cursor, header);
+            if (timed && ++consumed % DEADLINE_CHECK_INTERVAL == 0 && Clock::now() >= deadline) return false;
+        }
+        cursor.offset = 0;
+    }
+    return true;
+}
+
+void EventQueue::Retire(Cursor& cursor, RecordHeader* header) {
+    if (header->destroy) header->destroy(Payload(header));
+    cursor.offset += header->bytes;
+}
+
+void EventQueue::Reset(Arena& arena) {
+    Chunk* head = arena.head.load(std::memory_order_relaxed);
+    for (Chunk* chunk = head; chunk != nullptr; chunk = chunk->next.load(std::memory_order_relaxed))
+        chunk->used.store(0, std::memory_order_relaxed);
+    arena.tail.store(head, std::memory_order_relaxed);
+}
+
+bool EventQueue::Drain(void* context, Clock::time_point deadline) {
+    // Finish the arena a previous drain ran out of time on before taking any newer events
+    if (m_Draining != nullptr) {
+        if (!Consume(m_Resume, context, true, deadline)) return false;
+        Reset(*m_Draining);
+        m_Draining = nullptr;
+    }
+
+    Arena* draining = m_Current.load(std::memory_order_relaxed);
+    Arena* next = draining == &m_Arenas[0] ? &m_Arenas[1] : &m_Arenas[0];
+    m_Current.store(next, std::memory_order_seq_cst);
+
+    // Producers that entered before the swap finish their copies; new ones go to the other arena
+    while (draining->writers.load(std::memory_order_seq_cst) != 0)
+        std::this_thread::yield();
+
+    m_Draining = draining;
+    m_Resume = {.chunk = draining->head.load(std::memory_order_acquire), .offset = 0};
+    if (!Consume(m_Resume, context, true, deadline)) return false;
+    Reset(*draining);
+    m_Draining = nullptr;
+    return true;
+}
+
+} // namespace Airship
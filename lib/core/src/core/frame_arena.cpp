@@ -0,0 +1,53 @@
+#include "core/frame_arena.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+#include "core/instrumentation.h"
+
+namespace Airship {
+
+FrameArena::FrameArena(size_t initialFrameBytes) {
+    assert(initialFrameBytes > 0);
+    for (Frame& frame : m_Frames)
+        frame.blocks.push_back({.data = std::make_unique_for_overwrite<std::byte[]>(initialFrameBytes),
+                                .size = initialFrameBytes});
+}
+
+void FrameArena::NewFrame() {
+    m_PeakFrameBytes = std::max(m_PeakFrameBytes, FrameBytes());
+    m_Current = (m_Current + 1) % FRAME_COUNT;
+
+    Frame& frame = m_Frames[m_Current];
+    if (frame.blocks.size() > 1) {
+        // Outgrew its block last time round; replace them all with one that would have fit
+        PROFILE_SCOPE("Grow frame arena");
+        size_t total = 0;
+        for (const Block& block : frame.blocks)
+            total += block.size;
+        frame.blocks.clear();
+        AddBlock(frame, std::bit_ceil(total));
+    }
+    frame.offset = 0;
+    frame.used = 0;
+}
+
+void* FrameArena::AllocateSlow(size_t bytes, size_t alignment) {
+    assert(std::has_single_bit(alignment));
+    Frame& frame = m_Frames[m_Current];
+    // The rest of the current block is wasted, but still counts as used so the merged block covers it
+    frame.used += frame.blocks.back().size - frame.offset;
+    AddBlock(frame, std::max(frame.blocks.back().size * 2, std::bit_ceil(bytes + alignment)));
+    frame.offset = 0;
+    return Allocate(bytes, alignment);
+}
+
+void FrameArena::AddBlock(Frame& frame, size_t size) {
+    frame.blocks.push_back({.data = std::make_unique_for_overwrite<std::byte[]>(size), .size = size});
+    ++m_BlockAllocations;
+}
+
+} // namespace Airship
@@ -0,0 +1,233 @@
+#include "core/frame_graph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/instrumentation.h"
+#include "core/job_system.h"
+
+namespace Airship {
+
+FrameGraph::NodeId FrameGraph::AddNode(FrameNodeDesc desc, NodeFn fn) {
+    assert(m_Schedule == nullptr);
+    Node node{.desc = std::move(desc), .fn = std::move(fn), .reads = {}, .writes = {}};
+    for (const auto& name : node.desc.reads)
+        node.reads.push_back(ResourceId(name));
+    for (const auto& name : node.desc.writes)
+        node.writes.push_back(ResourceId(name));
+    m_Nodes.push_back(std::move(node));
+    m_Dirty = true;
+    return static_cast<NodeId>(m_Nodes.size() - 1);
+}
+
+void FrameGraph::SetPipelined(bool pipelined) {
+    m_Pipelined = pipelined;
+}
+
+uint32_t FrameGraph::ResourceId(const std::string& name) {
+    return m_ResourceIds.try_emplace(name, static_cast<uint32_t>(m_ResourceIds.size())).first->second;
+}
+
+std::vector<FrameGraph::Task> FrameGraph::BuildSchedule(bool simulate, bool render,
+                                                        bool renderFromPreviousFrame) const {
+    std::vector<Task> schedule;
+    const auto add = [&](FramePhase phase, bool previousFrame) {
+        for (NodeId id = 0; id < m_Nodes.size(); ++id) {
+            if (m_Nodes[id].desc.phase == phase) schedule.push_back(Task{.node = id, .previousFrame = previousFrame});
+        }
+    };
+    if (renderFromPreviousFrame) {
+        if (render) add(FramePhase::Render, true);
+        if (simulate) add(FramePhase::Simulate, false);
+    } else {
+        for (NodeId id = 0; id < m_Nodes.size(); ++id) {
+            const bool wanted = m_Nodes[id].desc.phase == FramePhase::Simulate ? simulate : render;
+            if (wanted) schedule.push_back(Task{.node = id});
+        }
+    }
+
+    // Walk the tasks in order, tracking each resource's last writer and the readers since
+    struct Access {
+        uint32_t writer = UINT32_MAX;
+        std::vector<uint32_t> readers;
+    };
+    std::vector<Access> access(m_ResourceIds.size());
+    const auto addEdge = [&schedule](uint32_t from, uint32_t to) {
+        if (from == UINT32_MAX || from == to) return;
+        auto& predecessors = schedule[to].predecessors;
+        if (std::find(predecessors.begin(), predecessors.end(), from) != predecessors.end()) return;
+        predecessors.push_back(from);
+        schedule[from].successors.push_back(to);
+        ++schedule[to].dependencyCount;
+    };
+    for (uint32_t task = 0; task < schedule.size(); ++task) {
+        const Node& node = m_Nodes[schedule[task].node];
+        for (const uint32_t resource : node.reads) {
+            addEdge(access[resource].writer, task);
+            access[resource].readers.push_back(task);
+        }
+        for (const uint32_t resource : node.writes) {
+            addEdge(access[resource].writer, task);
+            for (const uint32_t reader : access[resource].readers)
+                addEdge(reader, task);
+            access[resource] = {.writer = task, .readers = {}};
+        }
+    }
+    return schedule;
+}
+
+void FrameGraph::Execute(JobSystem* jobs, const FrameInfo& frame) {
+    PROFILE_FUNCTION();
+    if (m_Dirty) {
+        m_FullSchedule = BuildSchedule(true, true, false);
+        m_PipelinedSchedule = BuildSchedule(true, true, true);
+        m_SimulateSchedule = BuildSchedule(true, false, false);
+        m_RenderSchedule = BuildSchedule(false, true, true);
+        m_Dirty = false;
+    }
+
+    if (!m_Pipelined) {
+        Flush(jobs);
+        Run(jobs, m_FullSchedule, frame, frame);
+        return;
+    }
+
+    if (m_RenderPending)
+        Run(jobs, m_PipelinedSchedule, frame, m_PendingRenderFrame);
+    else
+        Run(jobs, m_SimulateSchedule, frame, frame);
+    m_RenderPending = !m_RenderSchedule.empty();
+    m_PendingRenderFrame = frame;
+}
+
+void FrameGraph::Flush(JobSystem* jobs) {
+    if (!m_RenderPending) return;
+    m_RenderPending = false;
+    Run(jobs, m_RenderSchedule, m_PendingRenderFrame, m_PendingRenderFrame);
+}
+
+void FrameGraph::Run(JobSystem* jobs, const std::vector<Task>& schedule, const FrameInfo& frame,
+                     const FrameInfo& previousFrame) {
+    if (schedule.empty()) return;
+    if (m_StateCount < schedule.size()) {
+        m_States = std::make_unique<TaskState[]>(schedule.size());
+        m_StateCount = schedule.size();
+    }
+    for (uint32_t task = 0; task < schedule.size(); ++task)
+        m_States[task].pending.store(schedule[task].dependencyCount, std::memory_order_relaxed);
+    m_Schedule = &schedule;
+    m_Frame = frame;
+    m_PreviousFrame = previousFrame;
+    m_Remaining.store(static_cast<uint32_t>(schedule.size()), std::memory_order_relaxed);
+
+    if (jobs == nullptr) {
+        // Dependencies only point backwards, so schedule order is a valid order
+        for (uint32_t task = 0; task < schedule.size(); ++task)
+            RunTask(nullptr, task);
+    } else {
+        for (uint32_t task = 0; task < schedule.size(); ++task) {
+            if (schedule[task].dependencyCount == 0) Launch(jobs, task);
+        }
+        // Run main-thread nodes as they become ready, and help with the rest in between
+        while (m_Remaining.load(std::memory_order_acquire) != 0) {
+            uint32_t ready = UINT32_MAX;
+            {
+                std::scoped_lock lock(m_Mutex);
+                if (!m_MainThreadReady.empty()) {
+                    ready = m_MainThreadReady.back();
+                    m_MainThreadReady.pop_back();
+                }
+            }
+            if (ready != UINT32_MAX)
+                RunTask(jobs, ready);
+            else if (!jobs->RunPending())
+                std::this_thread::yield();
+        }
+        // Jobs signal completion just before returning; let the last ones get clear of the schedule
+        jobs->Wait(m_Jobs);
+    }
+
+    RecordCriticalPath();
+    m_Schedule = nullptr;
+    std::exception_ptr error;
+    {
+        std::scoped_lock lock(m_Mutex);
+        error = std::exchange(m_Error, nullptr);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void FrameGraph::Launch(JobSystem* jobs, uint32_t task) {
+    if (m_Nodes[(*m_Schedule)[task].node].desc.affinity == ThreadAffinity::MainThread) {
+        std::scoped_lock lock(m_Mutex);
+        m_MainThreadReady.push_back(task);
+    } else {
+        jobs->Run([this, jobs, task] { RunTask(jobs, task); }, &m_Jobs);
+    }
+}
+
+void FrameGraph::RunTask(JobSystem* jobs, uint32_t task) {
+    const Task& scheduled = (*m_Schedule)[task];
+    const Node& node = m_Nodes[scheduled.node];
+    TaskState& state = m_States[task];
+
+    state.start = Profiling::now();
+    {
+        PROFILE_SCOPE(node.desc.name);
+        try {
+            node.fn(scheduled.previousFrame ? m_PreviousFrame : m_Frame);
+        } catch (...) {
+            // Keep going, so the frame still finishes and Execute can report it
+            std::scoped_lock lock(m_Mutex);
+            if (!m_Error) m_Error = std::current_exception();
+        }
+    }
+    state.end = Profiling::now();
+
+    if (jobs != nullptr) {
+        for (const uint32_t successor : scheduled.successors) {
+            if (m_States[successor].pending.fetch_sub(1, std::memory_order_acq_rel) == 1) Launch(jobs, successor);
+        }
+    }
+    m_Remaining.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void FrameGraph::RecordCriticalPath() {
+    const std::vector<Task>& schedule = *m_Schedule;
+    m_CriticalPath.clear();
+
+    // Start from whichever task finished last, and walk back through the predecessor each one waited on longest
+    uint32_t task = 0;
+    for (uint32_t i = 1; i < schedule.size(); ++i) {
+        if (m_States[i].end > m_States[task].end) task = i;
+    }
+    const uint64_t end = m_States[task].end;
+    while (true) {
+        m_CriticalPath.push_back(task);
+        const auto& predecessors = schedule[task].predecessors;
+        if (predecessors.empty()) break;
+        task = *std::max_element(predecessors.begin(), predecessors.end(),
+                                 [this](uint32_t a, uint32_t b) { return m_States[a].end < m_States[b].end; });
+    }
+    std::reverse(m_CriticalPath.begin(), m_CriticalPath.end());
+    m_CriticalPathNs = end - m_States[m_CriticalPath.front()].start;
+
+    if (m_CriticalPathTrack == UINT32_MAX) m_CriticalPathTrack = Profiling::createTrack("Critical path");
+    for (uint32_t& entry : m_CriticalPath) {
+        Profiling::recordSpan(m_CriticalPathTrack, m_Nodes[schedule[entry].node].desc.name, m_States[entry].start,
+                              m_States[entry].end);
+        entry = schedule[entry].node; // Callers want node ids
+    }
+}
+
+} // namespace Airship
@@ -0,0 +1,60 @@
+#include "core/frame_stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace Airship {
+
+size_t DurationHistogram::bucketIndex(uint64_t ns) noexcept {
+    // Values below SUB_BUCKET_COUNT get a bucket each, after that every power of two gets SUB_BUCKET_COUNT buckets
+    if (ns < SUB_BUCKET_COUNT) return ns;
+    const uint32_t exponent = std::bit_width(ns) - 1;
+    const uint32_t shift = exponent - SUB_BUCKET_BITS;
+    const auto subBucket = static_cast<size_t>(ns >> shift) - SUB_BUCKET_COUNT;
+    return SUB_BUCKET_COUNT + static_cast<size_t>(shift) * SUB_BUCKET_COUNT + subBucket;
+}
+
+uint64_t DurationHistogram::bucketMidpoint(size_t index) noexcept {
+    if (index < SUB_BUCKET_COUNT) return index;
+    const size_t shift = (index - SUB_BUCKET_COUNT) / SUB_BUCKET_COUNT;
+    const size_t subBucket = (index - SUB_BUCKET_COUNT) % SUB_BUCKET_COUNT;
+    const uint64_t lower = static_cast<uint64_t>(SUB_BUCKET_COUNT + subBucket) << shift;
+    return lower + ((uint64_t(1) << shift) >> 1);
+}
+
+void DurationHistogram::record(uint64_t ns) noexcept {
+    ++m_Buckets[bucketIndex(ns)];
+    ++m_Count;
+    m_Total += ns;
+    m_Min = std::min(m_Min, ns);
+    m_Max = std::max(m_Max, ns);
+}
+
+void DurationHistogram::reset() noexcept {
+    m_Buckets.fill(0);
+    m_Count = 0;
+    m_Total = 0;
+    m_Min = std::numeric_limits<uint64_t>::max();
+    m_Max = 0;
+}
+
+uint64_t DurationHistogram::percentile(double fraction) const noexcept {
+    if (m_Count == 0) return 0;
+
+    fraction = std::clamp(fraction, 0.0, 1.0);
+    const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * double(m_Count))));
+    if (target >= m_Count) return m_Max;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += m_Buckets[i];
+        // The exact extremes are known, so don't report past them
+        if (seen >= target) return std::clamp(bucketMidpoint(i), m_Min, m_Max);
+    }
+    return m_Max;
+}
+
+} // namespace Airship
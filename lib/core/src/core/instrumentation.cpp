@@ -1,89 +1,322 @@
 #include "core/instrumentation.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define AIRSHIP_HAS_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+#ifdef __linux__
+#include <time.h> // NOLINT(modernize-deprecated-headers) // clock_gettime is POSIX, not part of <ctime>
+#endif
+
+#ifndef AIRSHIP_PROFILING_CLOCK
+#define AIRSHIP_PROFILING_CLOCK SteadyClock
+#endif
+
+// Clock sources are available with or without AIRSHIP_INSTRUMENTATION, so timing code can share a timebase with traces
+namespace Airship::Profiling {
+
+namespace {
+uint64_t SteadyNs() noexcept {
+    auto sinceEpoch = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch).count();
+}
+
+#ifdef __linux__
+uint64_t MonotonicRawNs() noexcept {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000) + static_cast<uint64_t>(ts.tv_nsec);
+}
+#endif
+
+// Every source reports nanoseconds since these were captured, so they roughly line up when switching sources
+const uint64_t g_steadyStart = SteadyNs();
+#ifdef __linux__
+const uint64_t g_monotonicRawStart = MonotonicRawNs();
+#endif
+
+#ifdef AIRSHIP_HAS_TSC
+// now = tscStartNs + (rdtsc - tscStart) * nsPerTsc. Written once, before the Tsc source can be selected, and
+// published to other threads by the release store of g_clockSource.
+struct TscCalibration {
+    uint64_t tscStart = 0;
+    uint64_t tscStartNs = 0;
+    double nsPerTsc = 0.0;
+};
+TscCalibration g_tsc;
+
+void CalibrateTsc() {
+    static const bool calibrated = []() {
+        // Measure the tick rate against steady_clock over a short busy-wait
+        constexpr uint64_t calibrationNs = 2'000'000;
+        const uint64_t steady0 = SteadyNs();
+        const uint64_t tsc0 = __rdtsc();
+        uint64_t steady1 = steady0;
+        while (steady1 - steady0 < calibrationNs)
+            steady1 = SteadyNs();
+        const uint64_t tsc1 = __rdtsc();
+
+        g_tsc.nsPerTsc = static_cast<double>(steady1 - steady0) / static_cast<double>(tsc1 - tsc0);
+        g_tsc.tscStart = tsc1;
+        g_tsc.tscStartNs = steady1 - g_steadyStart;
+        return true;
+    }();
+    (void) calibrated;
+}
+#endif
+
+bool IsAvailable(ClockSource source) {
+    switch (source) {
+    case ClockSource::SteadyClock:
+        return true;
+    case ClockSource::MonotonicRaw:
+#ifdef __linux__
+        return true;
+#else
+        return false;
+#endif
+    case ClockSource::Tsc:
+#ifdef AIRSHIP_HAS_TSC
+        CalibrateTsc();
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+std::atomic<ClockSource> g_clockSource = []() {
+    constexpr ClockSource buildDefault = ClockSource::AIRSHIP_PROFILING_CLOCK;
+    return IsAvailable(buildDefault) ? buildDefault : ClockSource::SteadyClock;
+}();
+} // namespace
+
+bool setClockSource(ClockSource source) {
+    if (!IsAvailable(source)) return false;
+    // Release, so a thread that loads Tsc also sees the calibration
+    g_clockSource.store(source, std::memory_order_release);
+    return true;
+}
+
+ClockSource clockSource() {
+    return g_clockSource.load(std::memory_order_acquire);
+}
+
+uint64_t now() noexcept {
+    switch (g_clockSource.load(std::memory_order_acquire)) {
+#ifdef AIRSHIP_HAS_TSC
+    case ClockSource::Tsc: {
+        const auto ticks = static_cast<double>(__rdtsc() - g_tsc.tscStart);
+        return g_tsc.tscStartNs + static_cast<uint64_t>(ticks * g_tsc.nsPerTsc);
+    }
+#endif
+#ifdef __linux__
+    case ClockSource::MonotonicRaw:
+        return MonotonicRawNs() - g_monotonicRawStart;
+#endif
+    default:
+        return SteadyNs() - g_steadyStart;
+    }
+}
+
+} // namespace Airship::Profiling
+
 #ifndef AIRSHIP_INSTRUMENTATION
 namespace Airship::Profiling {
 ScopeTimer::ScopeTimer(const char* name_) noexcept : name(name_) {}
 ScopeTimer::~ScopeTimer() noexcept = default;
-void dump([[maybe_unused]] const std::string& filename) {}
+void setBufferCapacity([[maybe_unused]] size_t eventCount) {}
+void setOverflowPolicy([[maybe_unused]] OverflowPolicy policy) {}
+void setThreadName([[maybe_unused]] std::string_view name) {}
+uint32_t createTrack([[maybe_unused]] std::string_view name) {
+    return 0;
+}
+void recordSpan([[maybe_unused]] uint32_t track, [[maybe_unused]] const char* name, [[maybe_unused]] uint64_t startNs,
+                [[maybe_unused]] uint64_t endNs) noexcept {}
+void recordCounter([[maybe_unused]] const char* name, [[maybe_unused]] int64_t value) noexcept {}
+uint64_t droppedEventCount() {
+    return 0;
+}
+bool instrumentationEnabled() {
+    return false;
+}
+void dump([[maybe_unused]] const std::string& filename, [[maybe_unused]] TraceFormat format) {}
+bool startStreaming([[maybe_unused]] const StreamOptions& options) {
+    return true;
+}
+void stopStreaming() {}
 } // namespace Airship::Profiling
 #else
+#include <algorithm>
 #include <atomic>
+#include <bit>
+#include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <filesystem>
 #include <fstream>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
-namespace Airship::Profiling {
+#include "core/trace_format.h"
 
-enum class TraceEventType : uint8_t {
-    start,
-    end
-};
+namespace Airship::Profiling {
 
 struct TraceEvent {
+    static constexpr uint32_t OWN_THREAD = UINT32_MAX;
+
     const char* name;
-    uint64_t timestamp;
+    uint64_t timestamp; // Nanoseconds, see now()
     TraceEventType type;
+    // Track id from createTrack, or OWN_THREAD for the recording thread's timeline
+    uint32_t track;
+    int64_t value; // Counter events only
 };
 
+// Fixed-capacity, single-producer ring buffer. The owning thread is the only writer, and never allocates or blocks;
+// a single reader at a time drains events from the tail. Indices grow monotonically and are masked into the
+// (power of two sized) storage.
 struct EventBuffer {
-    EventBuffer(uint32_t tid) : threadIndex(tid) {}
+    EventBuffer(uint32_t tid, size_t capacity, OverflowPolicy policy_) :
+        events(std::make_unique<TraceEvent[]>(capacity)), mask(capacity - 1), threadIndex(tid), policy(policy_) {
+        assert(std::has_single_bit(capacity));
+    }
     EventBuffer(const EventBuffer&) = delete;
     EventBuffer(const EventBuffer&&) = delete;
     EventBuffer& operator=(const EventBuffer&) = delete;
     EventBuffer& operator=(const EventBuffer&&) = delete;
 
     uint32_t threadIdx() const { return threadIndex; }
-    void emplace_back(const char* name, uint64_t timestamp, TraceEventType type) {
-        events.emplace_back(name, timestamp, type);
+    uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+    // Called by the owning thread as it exits. Nothing is pushed after that, so once drained the buffer can be freed.
+    void retire() noexcept { retired.store(true, std::memory_order_release); }
+    bool isRetired() const { return retired.load(std::memory_order_acquire); }
+
+    void push(const char* name, uint64_t timestamp, TraceEventType type, uint32_t track = TraceEvent::OWN_THREAD,
+              int64_t value = 0) noexcept {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        if (policy == OverflowPolicy::DropNewest && h - tail.load(std::memory_order_acquire) > mask) {
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        events[h & mask] = {.name = name, .timestamp = timestamp, .type = type, .track = track, .value = value};
+        // Publishing is a single release store, so it's fine to do for every event
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // Hand every published event to fn (oldest first) and release their slots
+    template <typename Fn>
+    void drain(Fn&& fn) {
+        const uint64_t capacity = mask + 1;
+        const uint64_t h = head.load(std::memory_order_acquire);
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (h - t > capacity) {
+            // The writer lapped us (OverwriteOldest) - skip ahead to the oldest surviving event
+            droppedCount.fetch_add(h - capacity - t, std::memory_order_relaxed);
+            t = h - capacity;
+        }
+
+        for (; t != h; ++t) {
+            const TraceEvent e = events[t & mask];
+            // The writer may have wrapped around onto this slot while we copied it. Discard torn reads. The fence keeps
+            // the copy from being reordered past the head it's checked against.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (policy == OverflowPolicy::OverwriteOldest && head.load(std::memory_order_relaxed) - t >= capacity) {
+                droppedCount.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            fn(e);
+        }
+        tail.store(h, std::memory_order_release);
     }
-    TraceEvent get(size_t i) const { return events[i]; }
-    size_t count() const { return publishedCount.load(std::memory_order_acquire); }
-    void updateCount() { publishedCount = events.size(); }
 
 private:
-    // TODO: vectors can reallocate at random - we should refactor to something
-    // we have more control over to avoid hiccups
-    std::vector<TraceEvent> events;
+    std::unique_ptr<TraceEvent[]> events;
+    uint64_t mask;
     uint32_t threadIndex;
-    std::atomic<size_t> publishedCount = 0;
+    OverflowPolicy policy;
+    std::atomic<uint64_t> head = 0; // Next index to write, owned by the producer
+    std::atomic<uint64_t> tail = 0; // Next index to read, owned by the consumer
+    std::atomic<uint64_t> droppedCount = 0;
+    std::atomic<bool> retired = false;
 };
 
 namespace {
-const thread_local uint32_t g_threadIndex = []() noexcept {
-    static std::atomic<uint32_t> threadIndex = 0;
-    return threadIndex.fetch_add(1, std::memory_order_relaxed);
-}();
+constexpr size_t DEFAULT_BUFFER_CAPACITY = size_t(1) << 16;
+
+std::atomic<size_t> g_bufferCapacity = DEFAULT_BUFFER_CAPACITY;
+std::atomic<OverflowPolicy> g_overflowPolicy = OverflowPolicy::OverwriteOldest;
+
+// Threads and tracks share one id space
+std::atomic<uint32_t> g_nextThreadIndex = 0;
+const thread_local uint32_t g_threadIndex = g_nextThreadIndex.fetch_add(1, std::memory_order_relaxed);
 
 // Combine thread-local buffers into a globally-accessible variable
 std::mutex g_threadBufferMutex;
 std::vector<std::unique_ptr<EventBuffer>> g_allEventBuffers;
+// Drops counted by buffers that have since been freed
+uint64_t g_retiredDropped = 0;
+
+// Buffers only support one reader at a time - serializes dump() against the streaming thread
+std::mutex g_drainMutex;
+
+// Every name ever set, in order. A deque, so the names stay put for the binary writer to intern by pointer.
+struct ThreadName {
+    uint32_t tid;
+    std::string name;
+};
+std::mutex g_threadNameMutex;
+std::deque<ThreadName> g_threadNames;
+
+// Retires the thread's buffer when the thread exits
+struct ThreadBufferOwner {
+    EventBuffer*& buffer;
+    ~ThreadBufferOwner() {
+        buffer->retire();
+        buffer = nullptr; // Anything recorded later in the thread's teardown gets a fresh buffer
+    }
+};
 
 EventBuffer& GetThreadBuffer() {
     thread_local EventBuffer* buffer = nullptr;
     if (buffer != nullptr) return *buffer;
 
-    // Now we're in normal function context - exceptions are legal
-    auto buf = std::make_unique<EventBuffer>(g_threadIndex);
+    // Now we're in normal function context - exceptions are legal. This is the only allocation a thread makes.
+    auto buf = std::make_unique<EventBuffer>(g_threadIndex, g_bufferCapacity.load(std::memory_order_relaxed),
+                                             g_overflowPolicy.load(std::memory_order_relaxed));
 
     {
         std::lock_guard<std::mutex> lock(g_threadBufferMutex);
         buffer = g_allEventBuffers.emplace_back(std::move(buf)).get();
     }
+    // Kept off the fast path above - it's only constructed once a buffer exists to retire
+    thread_local const ThreadBufferOwner owner{buffer};
 
     return *buffer;
 }
 
-// Lock g_allEventBuffers long enough to copy out the pointers (safe in case we ever spawn+instrument new threads)
-// Within each buffer: avoid race conditions by:
-// 1. Only pushing into the vectors, never popping
-// 2. Periodically publish the size of the vector (to use instead of .size()), indicating which elements are fully
-// initialized
+// Lock g_allEventBuffers long enough to copy out the pointers (safe in case we ever spawn+instrument new threads).
+// Buffers are only freed by DrainEventBuffers, so the pointers stay valid while g_drainMutex is held. Each buffer
+// synchronizes its own reader/writer.
 std::vector<EventBuffer*> SnapshotEventBuffers() {
     std::lock_guard lock(g_threadBufferMutex);
 
@@ -96,22 +329,167 @@ std::vector<EventBuffer*> SnapshotEventBuffers() {
     return out;
 }
 
+// Hand every buffered event to fn(event, tid), then free the buffers of threads that have exited. Callers hold
+// g_drainMutex.
+template <typename Fn>
+void DrainEventBuffers(Fn&& fn) {
+    std::vector<EventBuffer*> finished;
+    for (auto* buf : SnapshotEventBuffers()) {
+        // Checked before draining - a retired buffer gets no more events, so the drain leaves it empty for good
+        const bool retired = buf->isRetired();
+        buf->drain([&fn, tid = buf->threadIdx()](const TraceEvent& e) { fn(e, tid); });
+        if (retired) finished.push_back(buf);
+    }
+    if (finished.empty()) return;
+
+    std::lock_guard lock(g_threadBufferMutex);
+    std::erase_if(g_allEventBuffers, [&finished](const std::unique_ptr<EventBuffer>& buf) {
+        if (std::ranges::find(finished, buf.get()) == finished.end()) return false;
+        g_retiredDropped += buf->dropped();
+        return true;
+    });
+}
+
 void PushEvent(const char* name, TraceEventType type) noexcept {
     // TODO: Add VS profiler integration
-    // TODO: Check overhead of std::chrono calls, and potentially use OS implementations
     try {
-        auto now = std::chrono::steady_clock::now();
-        auto us = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
-        EventBuffer& threadBuffer = GetThreadBuffer();
-        threadBuffer.emplace_back(name, us, type);
-
-        // Occasionally bump up the published count (every event for now)
-        threadBuffer.updateCount();
+        GetThreadBuffer().push(name, now(), type);
     } catch (...) {
         // Swallow the error. Worst case scenario, some trace event is never started/stopped. Big whoop.
         (void) 0; // Satisfies bugprone-empty-catch clang-tidy warning
     }
 }
+
+// A single trace file in either format. JSON files use the array format, so they stay loadable if we never get to
+// write the closing bracket.
+class TraceFile {
+public:
+    TraceFile(const std::string& filename, TraceFormat format) : out(filename, std::ios::binary) {
+        if (format == TraceFormat::Binary)
+            binary = std::make_unique<BinaryTraceWriter>(out, 1);
+        else
+            out << "[\n";
+    }
+    TraceFile(const TraceFile&) = delete;
+    TraceFile(TraceFile&&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+    TraceFile& operator=(TraceFile&&) = delete;
+
+    ~TraceFile() {
+        if (binary)
+            binary.reset();
+        else
+            out << "{}]\n";
+    }
+
+    // Names set since the last call. Each file gets all of them, so every file in a stream is readable on its own.
+    void writeThreadNames() {
+        std::lock_guard lock(g_threadNameMutex);
+        for (; namesWritten < g_threadNames.size(); ++namesWritten) {
+            const ThreadName& thread = g_threadNames[namesWritten];
+            if (binary)
+                binary->write(thread.name.c_str(), TraceEventType::threadName, 0, thread.tid);
+            else
+                writeJsonEvent(out, thread.name, TraceEventType::threadName, 0, thread.tid);
+        }
+    }
+
+    void write(const TraceEvent& e, uint32_t threadTid) {
+        const uint32_t tid = e.track == TraceEvent::OWN_THREAD ? threadTid : e.track;
+        if (binary)
+            binary->write(e.name, e.type, e.timestamp, tid, e.value);
+        else
+            writeJsonEvent(out, e.name, e.type, e.timestamp, tid, e.value);
+    }
+
+    void flush() {
+        if (binary) binary->flush();
+        out.flush();
+    }
+
+    [[nodiscard]] size_t bytesWritten() {
+        return binary ? binary->bytesWritten() : static_cast<size_t>(out.tellp());
+    }
+
+private:
+    std::ofstream out;
+    std::unique_ptr<BinaryTraceWriter> binary;
+    size_t namesWritten = 0;
+};
+
+// Drains every thread's buffer to a series of rotating files on a background thread
+class TraceStreamer {
+public:
+    TraceStreamer(StreamOptions options) : opts(std::move(options)), thread([this]() { Run(); }) {}
+    TraceStreamer(const TraceStreamer&) = delete;
+    TraceStreamer(TraceStreamer&&) = delete;
+    TraceStreamer& operator=(const TraceStreamer&) = delete;
+    TraceStreamer& operator=(TraceStreamer&&) = delete;
+
+    ~TraceStreamer() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+private:
+    void Run() {
+        OpenNextFile();
+        std::unique_lock lock(mutex);
+        while (!stopping) {
+            wake.wait_for(lock, opts.flushInterval, [this]() { return stopping; });
+            lock.unlock();
+            Flush();
+            lock.lock();
+        }
+        // Stopping may have been asked for before the first wait, with events still buffered
+        lock.unlock();
+        Flush();
+        file.reset();
+    }
+
+    void Flush() {
+        {
+            std::lock_guard drainLock(g_drainMutex);
+            file->writeThreadNames();
+            DrainEventBuffers([this](const TraceEvent& e, uint32_t tid) {
+                file->write(e, tid);
+                if (file->bytesWritten() >= opts.maxFileBytes) OpenNextFile();
+            });
+        }
+        file->flush();
+    }
+
+    void OpenNextFile() {
+        file.reset();
+        if (opts.maxFiles > 0 && fileIndex >= opts.maxFiles) {
+            std::error_code ec; // Best effort - the file may have been moved away
+            std::filesystem::remove(FileName(fileIndex - opts.maxFiles), ec);
+        }
+        file = std::make_unique<TraceFile>(FileName(fileIndex++), opts.format);
+        // Every file names all the threads, so each one can be opened on its own
+        file->writeThreadNames();
+    }
+
+    [[nodiscard]] std::string FileName(uint32_t index) const {
+        const char* extension = opts.format == TraceFormat::Binary ? ".astrace" : ".json";
+        return opts.basePath + "." + std::to_string(index) + extension;
+    }
+
+    StreamOptions opts;
+    std::unique_ptr<TraceFile> file;
+    uint32_t fileIndex = 0;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread thread; // Last, so everything above is constructed before it starts
+};
+
+std::mutex g_streamerMutex;
+std::unique_ptr<TraceStreamer> g_streamer;
 } // namespace
 
 ScopeTimer::ScopeTimer(const char* name_) noexcept : name(name_) {
@@ -122,31 +500,75 @@ ScopeTimer::~ScopeTimer() noexcept {
     PushEvent(name, TraceEventType::end);
 }
 
-// Dump all existing events to a json file, formatted for chrome-tracing/perfetto.ui
-void dump(const std::string& filename) {
-    auto buffers = SnapshotEventBuffers();
+void setBufferCapacity(size_t eventCount) {
+    g_bufferCapacity = std::bit_ceil(std::max<size_t>(eventCount, 2));
+}
 
-    std::ofstream out(filename);
-    out << "{\"traceEvents\":[\n";
+void setOverflowPolicy(OverflowPolicy policy) {
+    g_overflowPolicy = policy;
+}
 
-    for (auto* buf : buffers) {
-        uint32_t end = buf->count();
+void setThreadName(std::string_view name) {
+    std::lock_guard lock(g_threadNameMutex);
+    g_threadNames.push_back({.tid = g_threadIndex, .name = std::string(name)});
+}
 
-        for (uint32_t i = 0; i < end; ++i) {
-            const TraceEvent& e = buf->get(i);
+uint32_t createTrack(std::string_view name) {
+    const uint32_t track = g_nextThreadIndex.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard lock(g_threadNameMutex);
+    g_threadNames.push_back({.tid = track, .name = std::string(name)});
+    return track;
+}
 
-            out << "{";
-            out << R"("name":")" << e.name << "\",";
-            out << R"("ph":")" << (e.type == TraceEventType::start ? "B" : "E") << "\",";
-            out << "\"ts\":" << e.timestamp << ",";
-            out << "\"pid\":0,";
-            out << "\"tid\":" << buf->threadIdx();
-            out << "},\n";
-        }
+void recordSpan(uint32_t track, const char* name, uint64_t startNs, uint64_t endNs) noexcept {
+    try {
+        EventBuffer& buffer = GetThreadBuffer();
+        buffer.push(name, startNs, TraceEventType::start, track);
+        buffer.push(name, endNs, TraceEventType::end, track);
+    } catch (...) {
+        (void) 0; // As in PushEvent, a lost span isn't worth failing over
     }
+}
 
-    out << "{}]}";
+void recordCounter(const char* name, int64_t value) noexcept {
+    try {
+        GetThreadBuffer().push(name, now(), TraceEventType::counter, TraceEvent::OWN_THREAD, value);
+    } catch (...) {
+        (void) 0; // As in PushEvent
+    }
+}
+
+uint64_t droppedEventCount() {
+    std::lock_guard lock(g_threadBufferMutex);
+    uint64_t total = g_retiredDropped;
+    for (const auto& buf : g_allEventBuffers)
+        total += buf->dropped();
+    return total;
+}
+
+bool instrumentationEnabled() {
+    return true;
+}
+
+// Dump all existing events to a file, formatted for chrome-tracing/perfetto.ui or airship-trace
+void dump(const std::string& filename, TraceFormat format) {
+    TraceFile file(filename, format);
+    std::lock_guard drainLock(g_drainMutex);
+    file.writeThreadNames();
+    DrainEventBuffers([&file](const TraceEvent& e, uint32_t tid) { file.write(e, tid); });
+}
+
+bool startStreaming(const StreamOptions& options) {
+    std::lock_guard lock(g_streamerMutex);
+    if (g_streamer) return false;
+    g_streamer = std::make_unique<TraceStreamer>(options);
+    return true;
+}
+
+void stopStreaming() {
+    std::lock_guard lock(g_streamerMutex);
+    g_streamer.reset();
 }
-#endif
 
 } // namespace Airship::Profiling
+#endif
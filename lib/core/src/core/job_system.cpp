@@ -0,0 +1,298 @@
+#include "core/job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/instrumentation.h"
+#include "core/pool_allocator.h"
+
+namespace Airship {
+
+namespace Detail {
+struct Job {
+    std::function<void()> fn;
+    JobCounter* counter;
+};
+
+// Chase-Lev deque (Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models"). The owner pushes and pops
+// at the bottom, thieves take from the top, and only a race for the last job needs a CAS. Fences are replaced with
+// sequentially consistent accesses, which is what they compile to on x86 anyway and keeps TSan happy.
+class WorkStealingDeque {
+public:
+    WorkStealingDeque() : m_Ring(new Ring(INITIAL_CAPACITY)) { m_Retired.emplace_back(m_Ring.load()); }
+
+    // Owner only
+    void Push(Job* job) {
+        const int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+        const int64_t top = m_Top.load(std::memory_order_acquire);
+        Ring* ring = m_Ring.load(std::memory_order_relaxed);
+        if (bottom - top >= ring->capacity) ring = Grow(ring, top, bottom);
+        ring->Put(bottom, job);
+        m_Bottom.store(bottom + 1, std::memory_order_release);
+    }
+
+    // Owner only
+    Job* Pop() {
+        const int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+        Ring* ring = m_Ring.load(std::memory_order_relaxed);
+        m_Bottom.store(bottom, std::memory_order_seq_cst);
+        int64_t top = m_Top.load(std::memory_order_seq_cst);
+        if (top > bottom) {
+            m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Job* job = ring->Get(bottom);
+        if (top == bottom) {
+            // Last job: race any thieves for it
+            if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                job = nullptr;
+            m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    // Any thread
+    Job* Steal() {
+        int64_t top = m_Top.load(std::memory_order_seq_cst);
+        const int64_t bottom = m_Bottom.load(std::memory_order_seq_cst);
+        if (top >= bottom) return nullptr;
+
+        Job* job = m_Ring.load(std::memory_order_acquire)->Get(top);
+        if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr; // Lost to the owner or another thief
+        return job;
+    }
+
+private:
+    static constexpr int64_t INITIAL_CAPACITY = 256;
+
+    struct Ring {
+        explicit Ring(int64_t capacity_) : capacity(capacity_), slots(new std::atomic<Job*>[capacity_]) {}
+        void Put(int64_t index, Job* job) { slots[index & (capacity - 1)].store(job, std::memory_order_relaxed); }
+        [[nodiscard]] Job* Get(int64_t index) const {
+            return slots[index & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+
+        int64_t capacity;
+        std::unique_ptr<std::atomic<Job*>[]> slots;
+    };
+
+    Ring* Grow(Ring* ring, int64_t top, int64_t bottom) {
+        // Thieves may still be reading the old ring, so it's kept until the deque goes away
+        auto* bigger = m_Retired.emplace_back(std::make_unique<Ring>(ring->capacity * 2)).get();
+        for (int64_t i = top; i < bottom; ++i)
+            bigger->Put(i, ring->Get(i));
+        m_Ring.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    std::atomic<int64_t> m_Top = 0;
+    std::atomic<int64_t> m_Bottom = 0;
+    std::atomic<Ring*> m_Ring;
+    std::vector<std::unique_ptr<Ring>> m_Retired;
+};
+} // namespace Detail
+
+namespace {
+// The system and deque owned by the current thread, if any
+struct WorkerIdentity {
+    const JobSystem* system = nullptr;
+    size_t index = SIZE_MAX;
+};
+thread_local WorkerIdentity t_Worker;
+
+// Failed searches before an idle worker goes to sleep
+constexpr int IDLE_SPINS = 64;
+} // namespace
+
+size_t JobSystem::DefaultWorkerCount() {
+    const unsigned int cores = std::thread::hardware_concurrency();
+    return std::max(cores, 2u) - 1;
+}
+
+JobSystem::JobSystem(size_t workerCount) {
+    for (size_t i = 0; i <= workerCount; ++i)
+        m_Deques.push_back(std::make_unique<Detail::WorkStealingDeque>());
+    t_Worker = {.system = this, .index = 0};
+
+    m_Threads.reserve(workerCount);
+    for (size_t i = 1; i <= workerCount; ++i)
+        m_Threads.emplace_back([this, i] { WorkerLoop(i); });
+}
+
+JobSystem::~JobSystem() {
+    // Jobs may schedule more jobs, so keep helping until every queue is empty
+    while (Detail::Job* job = FindJob(t_Worker.system == this ? t_Worker.index : SIZE_MAX))
+        Execute(job);
+
+    m_Stopping.store(true, std::memory_order_seq_cst);
+    m_WorkEpoch.fetch_add(1, std::memory_order_seq_cst);
+    m_WorkEpoch.notify_all();
+    for (auto& thread : m_Threads)
+        thread.join();
+    if (t_Worker.system == this) t_Worker = {};
+}
+
+size_t JobSystem::AutoGrain(size_t count) const {
+    const size_t chunks = (WorkerCount() + 1) * CHUNKS_PER_THREAD;
+    return std::max<size_t>(1, (count + chunks - 1) / chunks);
+}
+
+void JobSystem::Run(std::function<void()> fn, JobCounter* counter, JobCounter* dependency) {
+    // Pooled: jobs are small and short-lived, and usually freed on another thread
+    auto* job = PoolAllocator::Get().New<Detail::Job>(Detail::Job{.fn = std::move(fn), .counter = counter});
+    if (counter != nullptr) counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+
+    if (dependency != nullptr) {
+        std::scoped_lock lock(dependency->m_Mutex);
+        // Checked under the lock, so it can't reach zero and release its waiting jobs between the check and the push
+        if (dependency->m_Pending.load(std::memory_order_acquire) != 0) {
+            dependency->m_Waiting.push_back(job);
+            return;
+        }
+    }
+    Schedule(job);
+}
+
+void JobSystem::Schedule(Detail::Job* job) {
+    if (t_Worker.system == this) {
+        m_Deques[t_Worker.index]->Push(job);
+    } else {
+        std::scoped_lock lock(m_InjectionMutex);
+        m_Injected.push_back(job);
+        m_InjectedCount.fetch_add(1, std::memory_order_release);
+    }
+
+    // Pairs with the sleep in WorkerLoop: either the worker sees the new epoch, or we see it sleeping
+    m_WorkEpoch.fetch_add(1, std::memory_order_seq_cst);
+    if (m_Sleeping.load(std::memory_order_seq_cst) != 0) m_WorkEpoch.notify_one();
+}
+
+Detail::Job* JobSystem::FindJob(size_t worker) {
+    if (worker != SIZE_MAX) {
+        if (Detail::Job* job = m_Deques[worker]->Pop()) return job;
+    }
+
+    if (m_InjectedCount.load(std::memory_order_acquire) != 0) {
+        std::scoped_lock lock(m_InjectionMutex);
+        if (!m_Injected.empty()) {
+            Detail::Job* job = m_Injected.front();
+            m_Injected.pop_front();
+            m_InjectedCount.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    // Start with the next deque along, so thieves spread out
+    const size_t count = m_Deques.size();
+    const size_t start = worker == SIZE_MAX ? 0 : worker + 1;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t victim = (start + i) % count;
+        if (victim == worker) continue;
+        if (Detail::Job* job = m_Deques[victim]->Steal()) return job;
+    }
+    return nullptr;
+}
+
+void JobSystem::Execute(Detail::Job* job) {
+    {
+        PROFILE_SCOPE("Job");
+        if (job->counter == nullptr) {
+            job->fn();
+        } else {
+            try {
+                job->fn();
+            } catch (...) {
+                std::scoped_lock lock(job->counter->m_Mutex);
+                if (!job->counter->m_Error) job->counter->m_Error = std::current_exception();
+            }
+        }
+    }
+
+    JobCounter* counter = job->counter;
+    PoolAllocator::Get().Delete(job);
+    if (counter != nullptr) Finish(*counter);
+}
+
+void JobSystem::Finish(JobCounter& counter) {
+    uint32_t pending = counter.m_Pending.load(std::memory_order_relaxed);
+    while (pending > 1) {
+        if (counter.m_Pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel)) return;
+    }
+
+    // This may be the last job. Whoever owns the counter can destroy it as soon as it looks done, so the waiting jobs
+    // are detached in the same critical section as the last decrement, and m_Finishing holds IsDone() off until this
+    // is the last touch.
+    counter.m_Finishing.fetch_add(1, std::memory_order_relaxed);
+    std::vector<Detail::Job*> released;
+    {
+        std::scoped_lock lock(counter.m_Mutex);
+        if (counter.m_Pending.fetch_sub(1, std::memory_order_acq_rel) == 1) released.swap(counter.m_Waiting);
+    }
+    counter.m_Finishing.fetch_sub(1, std::memory_order_release);
+
+    for (Detail::Job* waiting : released)
+        Schedule(waiting);
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+    const size_t worker = t_Worker.system == this ? t_Worker.index : SIZE_MAX;
+    while (!counter.IsDone()) {
+        if (Detail::Job* job = FindJob(worker))
+            Execute(job);
+        else
+            std::this_thread::yield();
+    }
+
+    std::exception_ptr error;
+    {
+        std::scoped_lock lock(counter.m_Mutex);
+        error = std::exchange(counter.m_Error, nullptr);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+bool JobSystem::RunPending() {
+    Detail::Job* job = FindJob(t_Worker.system == this ? t_Worker.index : SIZE_MAX);
+    if (job == nullptr) return false;
+    Execute(job);
+    return true;
+}
+
+void JobSystem::WorkerLoop(size_t worker) {
+    t_Worker = {.system = this, .index = worker};
+    Profiling::setThreadName("Worker " + std::to_string(worker));
+
+    int idle = 0;
+    while (true) {
+        const uint32_t epoch = m_WorkEpoch.load(std::memory_order_seq_cst);
+        if (Detail::Job* job = FindJob(worker)) {
+            Execute(job);
+            idle = 0;
+            continue;
+        }
+        if (m_Stopping.load(std::memory_order_seq_cst)) return;
+        if (++idle < IDLE_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        m_Sleeping.fetch_add(1, std::memory_order_seq_cst);
+        m_WorkEpoch.wait(epoch, std::memory_order_seq_cst);
+        m_Sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        idle = 0;
+    }
+}
+
+} // namespace Airship
@@ -0,0 +1,229 @@
+#include "core/instrumentation.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory_resource>
+#include <new>
+#include <string_view>
+
+namespace Airship::Profiling {
+
+namespace {
+// Everything here can be touched from operator new before main, or after other statics are destroyed, so it's all
+// constant-initialized and trivially destructible
+struct alignas(64) AtomicCounters {
+    std::atomic<uint64_t> liveBytes = 0;
+    std::atomic<uint64_t> liveAllocations = 0;
+    std::atomic<uint64_t> totalBytes = 0;
+    std::atomic<uint64_t> totalAllocations = 0;
+
+    void add(size_t bytes) noexcept {
+        liveBytes.fetch_add(bytes, std::memory_order_relaxed);
+        liveAllocations.fetch_add(1, std::memory_order_relaxed);
+        totalBytes.fetch_add(bytes, std::memory_order_relaxed);
+        totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void remove(size_t bytes) noexcept {
+        liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+        liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+    }
+    [[nodiscard]] MemoryCounters load() const noexcept {
+        return {.liveBytes = liveBytes.load(std::memory_order_relaxed),
+                .liveAllocations = liveAllocations.load(std::memory_order_relaxed),
+                .totalBytes = totalBytes.load(std::memory_order_relaxed),
+                .totalAllocations = totalAllocations.load(std::memory_order_relaxed)};
+    }
+};
+
+constinit std::array<AtomicCounters, MEMORY_TAG_COUNT> g_tagCounters{};
+constinit AtomicCounters g_gpuCounters{};
+constinit thread_local MemoryTag g_memoryTag = MemoryTag::Untagged;
+
+// Only touched by markMemoryFrame
+uint64_t g_lastTotalAllocations = 0;
+uint64_t g_lastTotalBytes = 0;
+std::atomic<uint64_t> g_frameAllocations = 0;
+std::atomic<uint64_t> g_frameBytes = 0;
+
+constexpr std::array<std::string_view, MEMORY_TAG_COUNT> MEMORY_TAG_NAMES = {"untagged", "renderer", "events",
+                                                                               "logging", "game"};
+// Trace counter names, which have to outlive the trace
+constexpr std::array<const char*, MEMORY_TAG_COUNT> HEAP_COUNTER_NAMES = {
+    "heap bytes: untagged", "heap bytes: renderer", "heap bytes: events", "heap bytes: logging", "heap bytes: game"};
+} // namespace
+
+std::string_view memoryTagName(MemoryTag tag) {
+    return MEMORY_TAG_NAMES[static_cast<size_t>(tag)];
+}
+
+MemoryTagScope::MemoryTagScope(MemoryTag tag) noexcept : previous(g_memoryTag) {
+    g_memoryTag = tag;
+}
+
+MemoryTagScope::~MemoryTagScope() noexcept {
+    g_memoryTag = previous;
+}
+
+MemoryTag currentMemoryTag() noexcept {
+    return g_memoryTag;
+}
+
+void trackAllocation(MemoryTag tag, size_t bytes) noexcept {
+    g_tagCounters[static_cast<size_t>(tag)].add(bytes);
+}
+
+void trackDeallocation(MemoryTag tag, size_t bytes) noexcept {
+    g_tagCounters[static_cast<size_t>(tag)].remove(bytes);
+}
+
+void trackGpuAllocation(size_t bytes) noexcept {
+    g_gpuCounters.add(bytes);
+}
+
+void trackGpuDeallocation(size_t bytes) noexcept {
+    g_gpuCounters.remove(bytes);
+}
+
+MemoryStats memoryStats() {
+    MemoryStats stats{};
+    for (size_t tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+        stats.tags[tag] = g_tagCounters[tag].load();
+    stats.gpu = g_gpuCounters.load();
+    stats.frameAllocations = g_frameAllocations.load(std::memory_order_relaxed);
+    stats.frameBytes = g_frameBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool memoryHooksEnabled() {
+#ifdef AIRSHIP_MEMORY_HOOKS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void markMemoryFrame() {
+    const MemoryStats stats = memoryStats();
+    uint64_t totalAllocations = 0;
+    uint64_t totalBytes = 0;
+    for (size_t tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+        totalAllocations += stats.tags[tag].totalAllocations;
+        totalBytes += stats.tags[tag].totalBytes;
+        recordCounter(HEAP_COUNTER_NAMES[tag], static_cast<int64_t>(stats.tags[tag].liveBytes));
+    }
+    const uint64_t frameAllocations = totalAllocations - g_lastTotalAllocations;
+    g_frameAllocations.store(frameAllocations, std::memory_order_relaxed);
+    g_frameBytes.store(totalBytes - g_lastTotalBytes, std::memory_order_relaxed);
+    g_lastTotalAllocations = totalAllocations;
+    g_lastTotalBytes = totalBytes;
+
+    recordCounter("gpu buffer bytes", static_cast<int64_t>(stats.gpu.liveBytes));
+    recordCounter("heap allocations per frame", static_cast<int64_t>(frameAllocations));
+}
+
+void* TaggedResource::do_allocate(size_t bytes, size_t alignment) {
+    // With the hooks on, the upstream's own heap allocation is what gets counted
+    const MemoryTagScope scope(m_Tag);
+    void* ptr = m_Upstream->allocate(bytes, alignment);
+    if (!memoryHooksEnabled()) trackAllocation(m_Tag, bytes);
+    return ptr;
+}
+
+void TaggedResource::do_deallocate(void* ptr, size_t bytes, size_t alignment) {
+    m_Upstream->deallocate(ptr, bytes, alignment);
+    if (!memoryHooksEnabled()) trackDeallocation(m_Tag, bytes);
+}
+
+} // namespace Airship::Profiling
+
+#ifdef AIRSHIP_MEMORY_HOOKS
+// Replacements for the global allocation functions. The library's nothrow versions forward to these.
+namespace {
+using Airship::Profiling::MemoryTag;
+
+// Sits just before every allocation, so frees know what to uncount and where the block really starts
+struct AllocationHeader {
+    uint64_t size;
+    uint32_t offset; // From the start of the malloc'd block
+    MemoryTag tag;
+};
+// So the header's size keeps malloc's alignment
+static_assert(sizeof(AllocationHeader) % alignof(std::max_align_t) == 0);
+
+void* HookedAllocate(size_t size, size_t alignment) noexcept {
+    alignment = std::max(alignment, alignof(AllocationHeader));
+    const size_t padding = sizeof(AllocationHeader) + alignment - std::min(alignment, alignof(std::max_align_t));
+    if (size > SIZE_MAX - padding) return nullptr;
+    auto* block = static_cast<std::byte*>(std::malloc(size + padding)); // NOLINT(cppcoreguidelines-no-malloc)
+    if (block == nullptr) return nullptr;
+
+    const auto start = reinterpret_cast<uintptr_t>(block) + sizeof(AllocationHeader);
+    auto* ptr = block + (((start + alignment - 1) & ~(alignment - 1)) - reinterpret_cast<uintptr_t>(block));
+    const MemoryTag tag = Airship::Profiling::currentMemoryTag();
+    new (ptr - sizeof(AllocationHeader))
+        AllocationHeader{.size = size, .offset = static_cast<uint32_t>(ptr - block), .tag = tag};
+    Airship::Profiling::trackAllocation(tag, size);
+    return ptr;
+}
+
+void* HookedNew(size_t size, size_t alignment) {
+    while (true) {
+        if (void* ptr = HookedAllocate(size, alignment)) return ptr;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void HookedDelete(void* ptr) noexcept {
+    if (ptr == nullptr) return;
+    auto* bytes = static_cast<std::byte*>(ptr);
+    const auto* header = reinterpret_cast<const AllocationHeader*>(bytes - sizeof(AllocationHeader));
+    Airship::Profiling::trackDeallocation(header->tag, header->size);
+    std::free(bytes - header->offset); // NOLINT(cppcoreguidelines-no-malloc)
+}
+} // namespace
+
+// NOLINTBEGIN(misc-new-delete-overloads)
+void* operator new(size_t size) {
+    return HookedNew(size, alignof(std::max_align_t));
+}
+void* operator new[](size_t size) {
+    return HookedNew(size, alignof(std::max_align_t));
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+    return HookedNew(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return HookedNew(size, static_cast<size_t>(alignment));
+}
+void operator delete(void* ptr) noexcept {
+    HookedDelete(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+    HookedDelete(ptr);
+}
+void operator delete(void* ptr, size_t /*size*/) noexcept {
+    HookedDelete(ptr);
+}
+void operator delete[](void* ptr, size_t /*size*/) noexcept {
+    HookedDelete(ptr);
+}
+void operator delete(void* ptr, std::align_val_t /*alignment*/) noexcept {
+    HookedDelete(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t /*alignment*/) noexcept {
+    HookedDelete(ptr);
+}
+void operator delete(void* ptr, size_t /*size*/, std::align_val_t /*alignment*/) noexcept {
+    HookedDelete(ptr);
+}
+void operator delete[](void* ptr, size_t /*size*/, std::align_val_t /*alignment*/) noexcept {
+    HookedDelete(ptr);
+}
+// NOLINTEND(misc-new-delete-overloads)
+#endif
@@ -0,0 +1,194 @@
+#include "core/pool_allocator.h"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace Airship {
+
+namespace {
+// Size class for every multiple of 16 up to MAX_POOLED_SIZE, indexed by (bytes + 15) / 16
+constexpr auto SIZE_CLASS_LOOKUP = [] {
+    std::array<uint8_t, (PoolAllocator::MAX_POOLED_SIZE / 16) + 1> lookup{};
+    size_t sizeClass = 0;
+    for (size_t i = 0; i < lookup.size(); ++i) {
+        while (PoolAllocator::SIZE_CLASSES[sizeClass] < i * 16)
+            ++sizeClass;
+        lookup[i] = static_cast<uint8_t>(sizeClass);
+    }
+    return lookup;
+}();
+static_assert(PoolAllocator::SIZE_CLASSES.back() == PoolAllocator::MAX_POOLED_SIZE);
+
+size_t SizeClassIndex(size_t bytes) {
+    return SIZE_CLASS_LOOKUP[(bytes + 15) / 16];
+}
+} // namespace
+
+namespace Detail {
+// Trivially destructible, so frees that come after the thread's flush (from other thread_local or static destructors)
+// still find it intact and go straight to the shared lists
+struct PoolThreadCache {
+    struct List {
+        PoolAllocator::FreeObject* head = nullptr;
+        uint32_t count = 0;
+    };
+
+    // Hands everything back, when the thread exits
+    void Flush() noexcept {
+        PoolAllocator& pool = PoolAllocator::Get();
+        for (size_t sizeClass = 0; sizeClass < lists.size(); ++sizeClass) {
+            List& list = lists[sizeClass];
+            if (list.head == nullptr) continue;
+            PoolAllocator::FreeObject* tail = list.head;
+            while (tail->next != nullptr)
+                tail = tail->next;
+            pool.ReturnBatch(sizeClass, list.head, tail, list.count);
+            list = {};
+        }
+        flushed = true;
+    }
+
+    std::array<List, PoolAllocator::SIZE_CLASSES.size()> lists;
+    bool flushed = false;
+};
+} // namespace Detail
+
+namespace {
+thread_local Detail::PoolThreadCache t_Cache;
+
+struct ThreadCacheFlusher {
+    ThreadCacheFlusher() = default;
+    ThreadCacheFlusher(const ThreadCacheFlusher&) = delete;
+    ThreadCacheFlusher& operator=(const ThreadCacheFlusher&) = delete;
+    ~ThreadCacheFlusher() { t_Cache.Flush(); }
+    // Touching it is what registers the destructor for this thread
+    void Arm() noexcept {}
+};
+thread_local ThreadCacheFlusher t_Flusher;
+} // namespace
+
+PoolAllocator& PoolAllocator::Get() {
+    // Never destroyed, so thread caches can still flush into it while the process exits
+    static auto* pool = new PoolAllocator();
+    return *pool;
+}
+
+void* PoolAllocator::Allocate(size_t bytes) {
+    if (bytes > MAX_POOLED_SIZE) {
+        m_LargeAllocations.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(bytes);
+    }
+    const size_t sizeClass = SizeClassIndex(bytes);
+    Detail::PoolThreadCache::List& list = t_Cache.lists[sizeClass];
+    if (list.head == nullptr) {
+        t_Flusher.Arm();
+        list.count = t_Cache.flushed ? 1 : BATCH_SIZE;
+        list.head = TakeBatch(sizeClass, list.count);
+    }
+    FreeObject* object = list.head;
+    list.head = object->next;
+    --list.count;
+    return object;
+}
+
+void PoolAllocator::Deallocate(void* ptr, size_t bytes) noexcept {
+    if (ptr == nullptr) return;
+    if (bytes > MAX_POOLED_SIZE) {
+        m_LargeAllocations.fetch_sub(1, std::memory_order_relaxed);
+        ::operator delete(ptr, bytes);
+        return;
+    }
+    const size_t sizeClass = SizeClassIndex(bytes);
+    Detail::PoolThreadCache::List& list = t_Cache.lists[sizeClass];
+    auto* object = static_cast<FreeObject*>(ptr);
+    if (t_Cache.flushed) {
+        ReturnBatch(sizeClass, object, object, 1);
+        return;
+    }
+    if (list.head == nullptr) t_Flusher.Arm();
+    object->next = list.head;
+    list.head = object;
+    ++list.count;
+
+    // A thread that frees more than it allocates (a consumer) sends the excess back for the others
+    if (list.count >= BATCH_SIZE * 2) {
+        FreeObject* tail = object;
+        for (uint32_t i = 1; i < BATCH_SIZE; ++i)
+            tail = tail->next;
+        list.head = tail->next;
+        list.count -= BATCH_SIZE;
+        tail->next = nullptr;
+        ReturnBatch(sizeClass, object, tail, BATCH_SIZE);
+    }
+}
+
+PoolAllocator::FreeObject* PoolAllocator::TakeBatch(size_t sizeClass, uint32_t& count) {
+    SizeClass& shared = m_SizeClasses[sizeClass];
+    std::scoped_lock lock(shared.mutex);
+    if (shared.free == nullptr) {
+        const size_t objectSize = SIZE_CLASSES[sizeClass];
+        const size_t objects = SLAB_BYTES / objectSize;
+        std::byte* slab = shared.slabs.emplace_back(std::make_unique_for_overwrite<std::byte[]>(SLAB_BYTES)).get();
+        // Linked back to front, so the batch we take first is at the start of the slab
+        for (size_t i = objects; i-- > 0;)
+            shared.free = new (slab + (i * objectSize)) FreeObject{shared.free};
+        shared.freeCount += objects;
+    }
+
+    FreeObject* head = shared.free;
+    FreeObject* tail = head;
+    uint32_t taken = 1;
+    while (taken < count && tail->next != nullptr) {
+        tail = tail->next;
+        ++taken;
+    }
+    shared.free = tail->next;
+    shared.freeCount -= taken;
+    tail->next = nullptr;
+    count = taken;
+    return head;
+}
+
+void PoolAllocator::ReturnBatch(size_t sizeClass, FreeObject* head, FreeObject* tail, uint32_t count) noexcept {
+    SizeClass& shared = m_SizeClasses[sizeClass];
+    std::scoped_lock lock(shared.mutex);
+    tail->next = shared.free;
+    shared.free = head;
+    shared.freeCount += count;
+}
+
+PoolAllocator::Stats PoolAllocator::GetStats() {
+    Stats stats{};
+    for (size_t sizeClass = 0; sizeClass < SIZE_CLASSES.size(); ++sizeClass) {
+        SizeClass& shared = m_SizeClasses[sizeClass];
+        std::scoped_lock lock(shared.mutex);
+        const size_t objectSize = SIZE_CLASSES[sizeClass];
+        stats.sizeClasses[sizeClass] = {.objectSize = objectSize,
+                                        .slabs = shared.slabs.size(),
+                                        .capacity = shared.slabs.size() * (SLAB_BYTES / objectSize),
+                                        .sharedFree = shared.freeCount};
+        stats.reservedBytes += shared.slabs.size() * SLAB_BYTES;
+    }
+    stats.largeAllocations = m_LargeAllocations.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void* PoolAllocator::MemoryResource::do_allocate(size_t bytes, size_t alignment) {
+    if (alignment > alignof(std::max_align_t)) return ::operator new(bytes, std::align_val_t(alignment));
+    return m_Pool.Allocate(bytes);
+}
+
+void PoolAllocator::MemoryResource::do_deallocate(void* ptr, size_t bytes, size_t alignment) {
+    if (alignment > alignof(std::max_align_t))
+        ::operator delete(ptr, bytes, std::align_val_t(alignment));
+    else
+        m_Pool.Deallocate(ptr, bytes);
+}
+
+} // namespace Airship
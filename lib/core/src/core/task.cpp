@@ -0,0 +1,116 @@
+#include "core/task.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/instrumentation.h"
+#include "core/job_system.h"
+#include "core/logging.h"
+
+namespace Airship {
+
+namespace {
+bool TimerLater(const auto& a, const auto& b) {
+    return a.dueNs != b.dueNs ? a.dueNs > b.dueNs : a.sequence > b.sequence;
+}
+} // namespace
+
+TaskScheduler::TaskScheduler(JobSystem* jobs) : m_JobSystem(jobs) {}
+
+TaskScheduler::~TaskScheduler() {
+    // Their awaiters live in the coroutine frames destroyed below
+    if (m_JobSystem != nullptr) m_JobSystem->Wait(m_Jobs);
+}
+
+void TaskScheduler::Spawn(Task<> task) {
+    assert(task.Valid());
+    m_Ready.push_back(task.m_Handle);
+    m_Tasks.push_back(std::move(task));
+}
+
+TaskScheduler::DelayAwaiter TaskScheduler::Delay(float seconds) {
+    const auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<float>(seconds));
+    return {*this, m_TimeNs + static_cast<uint64_t>(std::max<int64_t>(delay.count(), 0))};
+}
+
+void TaskScheduler::AddTimer(uint64_t dueNs, std::coroutine_handle<> handle) {
+    m_Timers.push_back({.dueNs = dueNs, .sequence = m_TimerSequence++, .handle = handle});
+    std::push_heap(m_Timers.begin(), m_Timers.end(), TimerLater<Timer, Timer>);
+}
+
+void TaskScheduler::Post(std::coroutine_handle<> handle) {
+    std::scoped_lock lock(m_PostedMutex);
+    m_Posted.push_back(handle);
+}
+
+void TaskScheduler::Update(float dt, std::chrono::nanoseconds budget) {
+    PROFILE_FUNCTION();
+    const auto start = std::chrono::steady_clock::now();
+    m_LastDt = dt;
+    m_TimeNs += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<float>(dt)).count());
+
+    // Gather everything that became ready since the last Update
+    m_Ready.insert(m_Ready.end(), m_NextFrame.begin(), m_NextFrame.end());
+    m_NextFrame.clear();
+    while (!m_Timers.empty() && m_Timers.front().dueNs <= m_TimeNs) {
+        std::pop_heap(m_Timers.begin(), m_Timers.end(), TimerLater<Timer, Timer>);
+        m_Ready.push_back(m_Timers.back().handle);
+        m_Timers.pop_back();
+    }
+    std::erase_if(m_Polled, [this](const auto& polled) {
+        if (!polled.first->IsDone()) return false;
+        m_Ready.push_back(polled.second);
+        return true;
+    });
+    {
+        std::scoped_lock lock(m_PostedMutex);
+        m_Ready.insert(m_Ready.end(), m_Posted.begin(), m_Posted.end());
+        m_Posted.clear();
+    }
+
+    // Only what's ready now: tasks that await NextFrame in here wait for the next Update
+    for (size_t remaining = m_Ready.size(); remaining > 0; --remaining) {
+        const std::coroutine_handle<> handle = m_Ready.front();
+        m_Ready.pop_front();
+        handle.resume();
+        if (std::chrono::steady_clock::now() - start >= budget) break;
+    }
+
+    std::exception_ptr error;
+    std::erase_if(m_Tasks, [&error](const Task<>& task) {
+        if (!task.Done()) return false;
+        if (!error) error = task.m_Handle.promise().error;
+        return true;
+    });
+    if (error) std::rethrow_exception(error);
+}
+
+std::optional<std::string> TaskScheduler::ReadWholeFile(const std::filesystem::path& path) {
+    PROFILE_FUNCTION();
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        SHIPLOG_ALERT("Cannot open file: {}", path.string());
+        return std::nullopt;
+    }
+    std::string contents{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    if (file.bad()) {
+        SHIPLOG_ALERT("Error reading file: {}", path.string());
+        return std::nullopt;
+    }
+    return contents;
+}
+
+} // namespace Airship
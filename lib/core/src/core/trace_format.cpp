@@ -0,0 +1,165 @@
+#include "core/trace_format.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace Airship::Profiling {
+
+namespace {
+constexpr size_t WRITE_CHUNK_BYTES = size_t(64) << 10;
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Names come from anywhere (thread names, scope names), so escape them before they go between quotes
+void writeJsonString(std::ostream& out, std::string_view str) {
+    constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+    size_t run = 0; // Start of the characters that can be written as they are
+    for (size_t i = 0; i < str.size(); ++i) {
+        const auto c = static_cast<unsigned char>(str[i]);
+        if (c != '"' && c != '\\' && c >= 0x20) continue;
+        out.write(str.data() + run, static_cast<std::streamsize>(i - run));
+        if (c == '"' || c == '\\')
+            out << '\\' << str[i];
+        else
+            out << "\\u00" << HEX_DIGITS[c >> 4] << HEX_DIGITS[c & 0xf];
+        run = i + 1;
+    }
+    out.write(str.data() + run, static_cast<std::streamsize>(str.size() - run));
+}
+} // namespace
+
+void writeJsonEvent(std::ostream& out, std::string_view name, TraceEventType type, uint64_t timestampNs, uint32_t tid,
+                    int64_t value) {
+    if (type == TraceEventType::threadName) {
+        out << R"({"name":"thread_name","ph":"M","pid":0,"tid":)" << tid;
+        out << R"(,"args":{"name":")";
+        writeJsonString(out, name);
+        out << "\"}},\n";
+        return;
+    }
+
+    // Trace viewers take microseconds, but accept fractions
+    const uint64_t fraction = timestampNs % 1000;
+    out << "{";
+    out << R"("name":")";
+    writeJsonString(out, name);
+    out << "\",";
+    out << R"("ph":")" << (type == TraceEventType::start ? "B" : type == TraceEventType::end ? "E" : "C") << "\",";
+    out << "\"ts\":" << timestampNs / 1000 << "." << fraction / 100 << (fraction / 10) % 10 << fraction % 10 << ",";
+    out << "\"pid\":0,";
+    out << "\"tid\":" << tid;
+    if (type == TraceEventType::counter) out << R"(,"args":{"value":)" << value << "}";
+    out << "},\n";
+}
+
+BinaryTraceWriter::BinaryTraceWriter(std::ostream& out, uint64_t nsPerTick) : m_Out(out) {
+    m_Buffer.reserve(WRITE_CHUNK_BYTES);
+    m_Buffer.append(BINARY_TRACE_MAGIC);
+    m_Buffer.push_back(static_cast<char>(BINARY_TRACE_VERSION));
+    putVarint(nsPerTick);
+}
+
+BinaryTraceWriter::~BinaryTraceWriter() {
+    flush();
+}
+
+void BinaryTraceWriter::write(const char* name, TraceEventType type, uint64_t timestamp, uint32_t tid, int64_t value) {
+    auto [it, inserted] = m_StringIds.try_emplace(name, static_cast<uint32_t>(m_StringIds.size()));
+    if (inserted) {
+        const std::string_view str(name);
+        m_Buffer.push_back(static_cast<char>(STRING_RECORD_TAG));
+        putVarint(it->second);
+        putVarint(str.size());
+        m_Buffer.append(str);
+    }
+
+    uint64_t& last = m_LastTimestamp[tid];
+    m_Buffer.push_back(static_cast<char>(EVENT_RECORD_TAG | static_cast<uint8_t>(type)));
+    putVarint(tid);
+    putVarint(it->second);
+    putVarint(zigzag(static_cast<int64_t>(timestamp - last)));
+    if (type == TraceEventType::counter) putVarint(zigzag(value));
+    last = timestamp;
+
+    if (m_Buffer.size() >= WRITE_CHUNK_BYTES) flush();
+}
+
+void BinaryTraceWriter::flush() {
+    m_Out.write(m_Buffer.data(), static_cast<std::streamsize>(m_Buffer.size()));
+    m_BytesWritten += m_Buffer.size();
+    m_Buffer.clear();
+}
+
+void BinaryTraceWriter::putVarint(uint64_t value) {
+    while (value >= 0x80) {
+        m_Buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    m_Buffer.push_back(static_cast<char>(value));
+}
+
+BinaryTraceReader::BinaryTraceReader(std::istream& in) : m_In(in) {
+    std::string magic(BINARY_TRACE_MAGIC.size(), '\0');
+    m_In.read(magic.data(), static_cast<std::streamsize>(magic.size()));
+    const int version = m_In.get();
+    // Older versions only lack threadName (added in 2) and counter (3) events
+    if (!m_In || magic != BINARY_TRACE_MAGIC || version < 1 || version > BINARY_TRACE_VERSION ||
+        !getVarint(m_NsPerTick))
+        m_Failed = true;
+}
+
+bool BinaryTraceReader::next(Event& event) {
+    while (!m_Failed) {
+        const int tag = m_In.get();
+        if (tag == std::istream::traits_type::eof()) return false;
+
+        if (tag == STRING_RECORD_TAG) {
+            uint64_t id, length;
+            if (!getVarint(id) || !getVarint(length) || id != m_Strings.size()) break;
+            std::string& str = m_Strings.emplace_back(length, '\0');
+            m_In.read(str.data(), static_cast<std::streamsize>(length));
+            if (!m_In) break;
+            continue;
+        }
+
+        const int type = tag & ~EVENT_RECORD_TAG;
+        if ((tag & EVENT_RECORD_TAG) == 0 || type > static_cast<int>(TraceEventType::counter)) break;
+        uint64_t tid, nameId, delta, value = 0;
+        if (!getVarint(tid) || !getVarint(nameId) || !getVarint(delta) || nameId >= m_Strings.size()) break;
+        if (type == static_cast<int>(TraceEventType::counter) && !getVarint(value)) break;
+
+        uint64_t& last = m_LastTimestamp[static_cast<uint32_t>(tid)];
+        last += static_cast<uint64_t>(unzigzag(delta));
+        event = {.name = m_Strings[nameId],
+                 .type = static_cast<TraceEventType>(type),
+                 .timestamp = last,
+                 .tid = static_cast<uint32_t>(tid),
+                 .value = unzigzag(value)};
+        return true;
+    }
+    m_Failed = true;
+    return false;
+}
+
+bool BinaryTraceReader::getVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const int byte = m_In.get();
+        if (byte == std::istream::traits_type::eof()) return false;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+} // namespace Airship::Profiling
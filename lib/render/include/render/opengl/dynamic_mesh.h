@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/pool_allocator.h"
+#include "render/opengl/renderer.h"
+
+namespace Airship {
+
+// Half-open [begin, end) element ranges, kept sorted with overlapping and touching ranges merged into one
+class DirtyRanges {
+public:
+    struct Range {
+        size_t begin;
+        size_t end;
+        bool operator==(const Range&) const = default;
+    };
+
+    void add(size_t begin, size_t end);
+    // Everything, however big the data gets before it's uploaded
+    void addAll() { add(0, SIZE_MAX); }
+    void clear() { m_Ranges.clear(); }
+    [[nodiscard]] bool empty() const { return m_Ranges.empty(); }
+    [[nodiscard]] std::span<const Range> ranges() const { return m_Ranges; }
+
+private:
+    std::vector<Range> m_Ranges;
+};
+
+// Each mesh owns a vector of streams. Each stream is associated with:
+// - One vertex attribute
+// - One buffer (potentially used in multiple streams)
+// - One vector of CPU-side data
+// This class: owns the CPU data with invalidation logic, and buffer (and defines
+// the stream that gets copied into the mesh).
+// (i.e. restricts each buffer to hold one vertex attribute)
+// The stream is then retrievable from this struct.
+class IOwningStream {
+public:
+    // Past this many separate ranges, one upload spanning all of them is cheaper than a call for each
+    static constexpr size_t MAX_RANGE_UPLOADS = 8;
+
+    virtual ~IOwningStream() = default;
+    virtual void sync() = 0;
+    [[nodiscard]] virtual VertexAttributeStream getStream() const = 0;
+
+    // Everything gets uploaded on the next sync
+    void invalidate() { m_Dirty.addAll(); }
+    // Only these elements get uploaded, along with any others invalidated before the next sync
+    void invalidate(size_t first, size_t count = 1) { m_Dirty.add(first, first + count); }
+    [[nodiscard]] const DirtyRanges& dirtyRanges() const { return m_Dirty; }
+
+protected:
+    DirtyRanges m_Dirty;
+};
+
+template <typename T>
+class OwningStream : public IOwningStream {
+public:
+    explicit OwningStream(ShaderDataType format, uint32_t divisor = 0, BufferUsage usage = BufferUsage::Static) :
+        m_Buffer(usage), m_Format(format), m_Divisor(divisor) {}
+    // Changes made through this have to be invalidated by hand
+    std::vector<T>& data() { return m_Data; }
+    [[nodiscard]] const std::vector<T>& data() const { return m_Data; }
+    [[nodiscard]] const Buffer& buffer() const { return m_Buffer; }
+
+    // These invalidate just what they touch
+    void set(size_t index, const T& value) {
+        assert(index < m_Data.size());
+        m_Data[index] = value;
+        invalidate(index);
+    }
+    void push_back(const T& value) {
+        invalidate(m_Data.size());
+        m_Data.push_back(value);
+    }
+    void resize(size_t count, const T& value = {}) {
+        if (count > m_Data.size()) invalidate(m_Data.size(), count - m_Data.size());
+        m_Data.resize(count, value);
+    }
+    // Room for count elements on both sides, so appending up to there never reallocates
+    void reserve(size_t count) {
+        m_Data.reserve(count);
+        if (count * sizeof(T) > m_Buffer.size()) {
+            // Growing the buffer loses what's in it
+            m_Buffer.reserve(count * sizeof(T));
+            invalidate();
+        }
+    }
+
+    void sync() override {
+        if (m_Dirty.empty()) return;
+        const size_t bytes = m_Data.size() * sizeof(T);
+        if (bytes > m_Buffer.size()) {
+            // Doubling keeps appends from reallocating the buffer every time. The new storage needs everything.
+            m_Buffer.reserve(std::max(bytes, m_Buffer.size() * 2));
+            m_Buffer.update(bytes, m_Data.data());
+        } else if (m_Buffer.usage() == BufferUsage::Stream) {
+            // A ranged update copies the rest of the buffer forward anyway, so there's nothing to save
+            m_Buffer.update(bytes, m_Data.data());
+        } else if (m_Dirty.ranges().size() > MAX_RANGE_UPLOADS) {
+            upload(m_Dirty.ranges().front().begin, m_Dirty.ranges().back().end);
+        } else {
+            for (const auto& range : m_Dirty.ranges())
+                upload(range.begin, range.end);
+        }
+        m_Dirty.clear();
+    }
+    [[nodiscard]] VertexAttributeStream getStream() const override {
+        return {.buffer = &m_Buffer, .stride = sizeof(T), .offset = 0, .format = m_Format, .divisor = m_Divisor};
+    }
+
+private:
+    // Elements past the end were invalidated before a shrink, and have nothing left to upload
+    void upload(size_t begin, size_t end) {
+        end = std::min(end, m_Data.size());
+        if (begin >= end) return;
+        m_Buffer.updateRange(begin * sizeof(T), (end - begin) * sizeof(T), m_Data.data() + begin);
+    }
+
+    std::vector<T> m_Data;
+    Buffer m_Buffer;
+    ShaderDataType m_Format;
+    uint32_t m_Divisor;
+};
+
+// The dynamic mesh owns a mapping of names to OwningStreams.
+// The APIs are templated to keep strong typing when interacting with
+// this object, but internally (and in the streams) the data is type-erased.
+// By owning the streams, we can keep all of the data used for a mesh owned by one
+// object, and force synchronization when drawing (assuming stream::invalidate() is
+// used appropriately).
+class DynamicMesh : public Mesh {
+public:
+    DynamicMesh() = default;
+    DynamicMesh(const DynamicMesh&) = delete;
+    DynamicMesh operator=(const DynamicMesh&) = delete;
+    DynamicMesh(DynamicMesh&&) = default;
+    DynamicMesh& operator=(DynamicMesh&&) = default;
+    // A divisor makes it a per-instance stream, see VertexAttributeStream. Streams rewritten every frame should use
+    // BufferUsage::Stream.
+    template <typename T>
+    OwningStream<T>& addStream(const std::string& name, ShaderDataType format, uint32_t divisor = 0,
+                               BufferUsage usage = BufferUsage::Static) {
+        auto stream = MakePooled<OwningStream<T>>(format, divisor, usage);
+        setAttributeStream(name, stream->getStream());
+        m_Streams[name] = std::move(stream);
+        return getStream<T>(name);
+    }
+
+    // Owned like the streams
+    void setIndices(std::span<const uint32_t> indices);
+
+    template <typename T>
+    std::vector<T>& getData(const std::string& name) const {
+        return getStream<T>(name).data();
+    }
+
+    template <typename T>
+    OwningStream<T>& getStream(const std::string& name) const {
+        assert(m_Streams.contains(name));
+        auto ptr = dynamic_cast<OwningStream<T>*>(m_Streams.at(name).get());
+        assert(ptr != nullptr);
+        return *ptr;
+    }
+
+    // Uploads whatever changed in the streams
+    void sync();
+    // Queued, so the renderer can batch it with the other meshes in the frame
+    void draw(const Renderer& renderer, const Material& mat, uint8_t layer = 0);
+
+private:
+    std::unordered_map<std::string, PoolPtr<IOwningStream>> m_Streams;
+    std::unique_ptr<Buffer> m_IndexBuffer;
+};
+
+} // namespace Airship
@@ -4,6 +4,9 @@
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
@@ -16,20 +19,110 @@
 
 namespace Airship {
 
+class FrameArena;
+
+enum class IndexType : uint8_t {
+    UInt16,
+    UInt32
+};
+
+enum class BufferUsage : uint8_t {
+    Static, // Written once, or rarely
+    Dynamic, // Rewritten often. Whole updates orphan the old storage rather than wait for draws still reading it.
+    // Rewritten every frame. Writes go straight into a persistently mapped ring of STREAM_REGIONS copies, each fenced
+    // so it's only reused once the GPU is done with it, flushing the renderer's queue first if draws from it are still
+    // waiting there. Draws use whichever copy was current when they were submitted, so update it before drawing from
+    // it, not between submit() and flush().
+    Stream
+};
+
 // RAII buffer wrapper
 struct Buffer {
     using buffer_id = unsigned int;
-    Buffer();
+    static constexpr size_t STREAM_REGIONS = 3;
+
+    explicit Buffer(BufferUsage usage = BufferUsage::Static);
     Buffer(const Buffer& other) = delete;
     Buffer(Buffer&& other) noexcept;
     ~Buffer();
+    // Can change when a stream buffer grows
     [[nodiscard]] buffer_id get() const { return m_BufferID; }
+    [[nodiscard]] BufferUsage usage() const { return m_Usage; }
+    // Bytes of storage, per region for stream buffers
+    [[nodiscard]] size_t size() const { return m_Size; }
+    // Where the current contents start, which moves around the ring for stream buffers
+    [[nodiscard]] size_t drawOffset() const { return m_Region * m_Size; }
     void bind() const;
+    // Replace the contents, growing the storage if it's too small
     void update(size_t bytes, const void* data);
+    // Overwrite part of the contents. The range has to fit in size(). Stream buffers still move to the next region,
+    // with the rest of the contents copied over on the GPU.
+    void updateRange(size_t offset, size_t bytes, const void* data);
+    // Grow the storage to at least bytes without uploading anything. Growing discards the contents.
+    void reserve(size_t bytes);
+    // Stores the indices as 16-bit when they all fit, and returns which size it used
+    [[nodiscard]] IndexType updateIndices(std::span<const uint32_t> indices);
 
 private:
+    friend class Renderer;
+
+    // Replaces the buffer object, since mapped storage can't be resized
+    void allocateStream(size_t bytes);
+    // Fence the current region and move to the next one, waiting for the GPU to finish with it if need be
+    void advanceStream();
+    void releaseStream();
+    // Fence the regions left while draws from them were queued, once Renderer::flush() has issued those draws
+    static void fenceQueuedRegions();
+    [[nodiscard]] size_t allocatedBytes() const {
+        return m_Usage == BufferUsage::Stream ? m_Size * STREAM_REGIONS : m_Size;
+    }
+
     buffer_id m_BufferID;
+    BufferUsage m_Usage;
     size_t m_Size = 0;
+    // Stream buffers only
+    std::byte* m_Mapped = nullptr;
+    std::array<void*, STREAM_REGIONS> m_Fences{};
+    size_t m_Region = 0;
+};
+
+// RAII framebuffer with an RGBA8 color attachment, for rendering that never reaches a window (benchmarks, golden-image
+// tests). Readback is asynchronous: requestReadback() queues a copy into one of two pixel buffers, and
+// collectReadback() picks it up a frame or more later, so the transfer overlaps rendering instead of stalling it.
+class RenderTarget {
+public:
+    using framebuffer_id = unsigned int;
+    static constexpr size_t MAX_PENDING_READBACKS = 2;
+
+    RenderTarget(int width, int height);
+    RenderTarget(const RenderTarget&) = delete;
+    RenderTarget& operator=(const RenderTarget&) = delete;
+    ~RenderTarget();
+
+    [[nodiscard]] framebuffer_id get() const { return m_FramebufferID; }
+    [[nodiscard]] int width() const { return m_Width; }
+    [[nodiscard]] int height() const { return m_Height; }
+
+    // Queue a copy of the current contents, flushing any renderer with draws still queued first. Returns false if
+    // MAX_PENDING_READBACKS are already waiting to be collected.
+    bool requestReadback();
+    // Copy out the oldest queued readback as tightly packed RGBA8, bottom row first. Returns false if there is none, or
+    // if it hasn't finished and wait is false.
+    bool collectReadback(std::vector<uint8_t>& pixels, bool wait = false);
+    [[nodiscard]] size_t pendingReadbacks() const { return m_PendingCount; }
+
+private:
+    [[nodiscard]] size_t imageBytes() const { return static_cast<size_t>(m_Width) * static_cast<size_t>(m_Height) * 4; }
+
+    framebuffer_id m_FramebufferID = 0;
+    unsigned int m_ColorTexture = 0;
+    int m_Width, m_Height;
+
+    // Ring of pixel pack buffers, each with the fence that signals its copy has landed
+    std::array<Buffer::buffer_id, MAX_PENDING_READBACKS> m_PixelBuffers{};
+    std::array<void*, MAX_PENDING_READBACKS> m_Fences{};
+    size_t m_NextPending = 0;
+    size_t m_PendingCount = 0;
 };
 
 enum class ShaderDataType : uint8_t {
@@ -44,11 +137,23 @@ struct VertexAttributeStream {
     uint32_t stride;
     uint32_t offset;
     ShaderDataType format;
+    // 0 advances per vertex; N advances once every N instances
+    uint32_t divisor = 0;
+};
+
+struct IndexStream {
+    const Buffer* buffer;
+    IndexType type;
+    uint32_t first = 0; // Index to start drawing from
 };
 
 struct Mesh {
     using vao_id = unsigned int;
-    void draw() const;
+    void draw() const { draw(indexOffset()); }
+    // Draw with the index buffer's contents starting indexBufferOffset bytes in, as indexOffset() was at submit
+    void draw(size_t indexBufferOffset) const;
+    // Where the index buffer's current contents start, which moves around for stream buffers
+    [[nodiscard]] size_t indexOffset() const { return m_IndexStream ? m_IndexStream->buffer->drawOffset() : 0; }
     [[nodiscard]] const VertexAttributeStream* getStream(const std::string& name) const {
         if (!m_VertexAttributeStreams.contains(name)) {
             SHIPLOG_ALERT("Vertex stream '{}' not found", name);
@@ -61,9 +166,32 @@ struct Mesh {
     }
     void setVertexCount(int count) { m_VertexCount = count; }
     [[nodiscard]] int vertexCount() const { return m_VertexCount; }
+    // Draws the vertices this many times in one call, with streams that have a divisor stepping per instance
+    void setInstanceCount(int count) { m_InstanceCount = count; }
+    [[nodiscard]] int instanceCount() const { return m_InstanceCount; }
+
+    // Indexed meshes draw indexCount indices from the stream, and the vertex count goes unused
+    void setIndexStream(const IndexStream& stream, int indexCount) {
+        m_IndexStream = stream;
+        m_IndexCount = indexCount;
+    }
+    void clearIndexStream() { m_IndexStream.reset(); }
+    [[nodiscard]] const IndexStream* getIndexStream() const { return m_IndexStream ? &*m_IndexStream : nullptr; }
+    [[nodiscard]] int indexCount() const { return m_IndexCount; }
+    // Added to every index, or where non-indexed drawing starts, so meshes can share the same vertex buffers
+    void setBaseVertex(int baseVertex) { m_BaseVertex = baseVertex; }
+    [[nodiscard]] int baseVertex() const { return m_BaseVertex; }
+    // Nothing to draw
+    [[nodiscard]] bool empty() const {
+        return m_InstanceCount == 0 || (m_IndexStream ? m_IndexCount : m_VertexCount) == 0;
+    }
 
 private:
     int m_VertexCount = 0;
+    int m_InstanceCount = 1;
+    std::optional<IndexStream> m_IndexStream;
+    int m_IndexCount = 0;
+    int m_BaseVertex = 0;
     std::unordered_map<std::string, VertexAttributeStream> m_VertexAttributeStreams;
 };
 
@@ -146,9 +274,9 @@ inline ShaderDataType DeduceShaderType() {
 }
 
 struct UniformValue {
-    ShaderDataType type;
+    ShaderDataType type = ShaderDataType::Float;
     UniformVariant value;
-    bool dirty;
+    int location = -1; // Looked up once, when the uniform is first set
 };
 
 template <typename T>
@@ -168,33 +296,88 @@ public:
 
         UType converted = Traits::Convert(value);
 
-        auto& u = m_Uniforms[name];
+        auto [it, inserted] = m_Uniforms.try_emplace(name);
+        UniformValue& u = it->second;
+        if (inserted) u.location = m_Pipeline->GetUniformLocation(name);
         u.type = DeduceShaderType<UType>();
         u.value = converted;
-        u.dirty = true;
+        m_UniformStamp = NextUniformStamp();
     }
 
+    // Uploads the uniforms only if the program last had some other material's (or an older version of these)
     void Bind() const;
     [[nodiscard]] const Pipeline& pipeline() const { return *m_Pipeline; }
+    // Unique to the current uniform values, and 0 while there are none. Copies share it until either is changed.
+    [[nodiscard]] uint64_t uniformStamp() const { return m_UniformStamp; }
 
 private:
+    static uint64_t NextUniformStamp();
+
     const Pipeline* m_Pipeline;
     std::unordered_map<std::string, UniformValue> m_Uniforms;
+    uint64_t m_UniformStamp = 0;
+};
+
+// GL calls actually made, after redundant binds and uploads are skipped
+struct RenderStats {
+    uint32_t draws = 0;
+    uint32_t programBinds = 0;
+    uint32_t vertexArrayBinds = 0;
+    uint32_t uniformUploads = 0;
 };
 
 class Renderer {
 public:
     Renderer() = default;
     void init();
-    void resize(int width, int height) const;
+    void resize(int width, int height);
+    // Draw into target, or back into the window with nullptr. Flushes first.
+    void setRenderTarget(const RenderTarget* target) const;
 
+    // Flushes first, so submitted draws land before the clear
     void clear() const;
+    // Immediate draws, in call order
     void draw(const std::vector<Mesh>& meshes, const Material& mat, bool doClear = true) const;
     void draw(const Mesh& mesh, const Material& mat, bool doClear = true) const;
+
+    // Queue a draw for the next flush(), which sorts the queue to share as many program, uniform and vertex array binds
+    // as it can. Layers are drawn in increasing order, which is what to use where blending makes the order matter;
+    // within a layer the order is up to the sort, with depth (clamped to [0, 1]) only breaking ties front to back. The
+    // mesh and material are read again at flush, so they have to outlive it and shouldn't change in between.
+    void submit(const Mesh& mesh, const Material& mat, uint8_t layer = 0, float depth = 0.0f) const;
+    // Draw everything submitted so far. setRenderTarget() and clear() call it first, so the queue never crosses either.
+    void flush() const;
+    // Flush, and close off the frame's stats. The application calls this before presenting each frame.
+    void endFrame() const;
+    // What the last frame cost, immediate draws included
+    [[nodiscard]] const RenderStats& frameStats() const { return m_FrameStats; }
+
     void setClearColor(const RGBColor& color);
+    // Per-draw scratch memory comes from here when set, instead of the heap
+    void setFrameArena(FrameArena* arena) { m_FrameArena = arena; }
 
 private:
+    struct QueuedDraw {
+        const Mesh* mesh;
+        const Material* material;
+        unsigned int vertexArray;
+        size_t indexOffset; // Taken at submit, like the vertex offsets in the vertex array
+    };
+    struct SortEntry {
+        uint64_t key = 0;
+        uint32_t index = 0;
+    };
+
+    [[nodiscard]] std::pmr::memory_resource* scratchResource() const;
+
+    // The queue is drawing state, like the GL state the const draw calls change
+    mutable std::vector<QueuedDraw> m_Queue;
+    mutable std::vector<SortEntry> m_SortEntries;
+    mutable std::vector<SortEntry> m_SortScratch;
+    mutable RenderStats m_FrameStats;
+    FrameArena* m_FrameArena = nullptr;
     Color m_ClearColor = Colors::Magenta;
+    int m_Width = 0, m_Height = 0;
 };
 
 } // namespace Airship
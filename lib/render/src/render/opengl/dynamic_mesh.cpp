@@ -0,0 +1,48 @@
+#include "render/opengl/dynamic_mesh.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "core/instrumentation.h"
+
+namespace Airship {
+
+void DirtyRanges::add(size_t begin, size_t end) {
+    if (begin >= end) return;
+    // The ends are sorted too, so this is the first range that could overlap or touch the new one
+    auto first = std::ranges::lower_bound(m_Ranges, begin, {}, &Range::end);
+    auto last = first;
+    for (; last != m_Ranges.end() && last->begin <= end; ++last) {
+        begin = std::min(begin, last->begin);
+        end = std::max(end, last->end);
+    }
+    if (first == last) {
+        m_Ranges.insert(first, {.begin = begin, .end = end});
+        return;
+    }
+    *first = {.begin = begin, .end = end};
+    m_Ranges.erase(first + 1, last);
+}
+
+void DynamicMesh::setIndices(std::span<const uint32_t> indices) {
+    if (!m_IndexBuffer) m_IndexBuffer = std::make_unique<Buffer>();
+    const IndexType type = m_IndexBuffer->updateIndices(indices);
+    setIndexStream({.buffer = m_IndexBuffer.get(), .type = type}, static_cast<int>(indices.size()));
+}
+
+void DynamicMesh::sync() {
+    PROFILE_FUNCTION();
+    for (auto& it : m_Streams) {
+        it.second->sync();
+    }
+}
+
+void DynamicMesh::draw(const Renderer& renderer, const Material& mat, uint8_t layer) {
+    sync();
+    renderer.submit(*this, mat, layer);
+}
+
+} // namespace Airship
@@ -4,12 +4,16 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <functional>
+#include <memory_resource>
+#include <span>
 #include <sstream>
 #include <string>
 #include <type_traits>
@@ -20,8 +24,10 @@
 
 #include "GL/gl3w.h"
 #include "GL/glcorearb.h"
+#include "core/frame_arena.h"
 #include "core/instrumentation.h"
 #include "core/logging.h"
+#include "core/radix_sort.h"
 #include "core/utils.hpp"
 #include "render/color.h"
 
@@ -69,6 +75,39 @@ struct VertexFormatInfo {
 
 namespace {
 
+// What's bound on the context, so binds and uploads that wouldn't change anything can be skipped. Only holds while all
+// of them go through Pipeline, Material and VertexArray.
+struct BoundState {
+    Pipeline::program_id program = 0;
+    VertexArray::vao_id vertexArray = 0;
+    // Stamp of the material whose uniforms each program has now
+    std::unordered_map<Pipeline::program_id, uint64_t> uniformStamps;
+    RenderStats stats;
+    // Whose queue has draws in it, if anyone's. They only reach the context when it's flushed.
+    const Renderer* queued = nullptr;
+};
+
+BoundState& Bound() {
+    static BoundState g_Bound;
+    return g_Bound;
+}
+
+// Queued draws only reach the GPU at flush, so a stream region left while draws from it are still queued can't be
+// fenced until then. Those regions wait here for Renderer::flush().
+std::vector<std::pair<Buffer*, size_t>>& QueuedRegions() {
+    static std::vector<std::pair<Buffer*, size_t>> g_QueuedRegions;
+    return g_QueuedRegions;
+}
+
+void bindVertexArray(VertexArray::vao_id id) {
+    BoundState& bound = Bound();
+    if (bound.vertexArray == id) return;
+    glBindVertexArray(id);
+    CHECK_GL_ERROR();
+    bound.vertexArray = id;
+    ++bound.stats.vertexArrayBinds;
+}
+
 VertexFormatInfo getVertexFormatInfo(ShaderDataType format) {
     switch (format) {
     case ShaderDataType::Float:
@@ -91,6 +130,7 @@ struct VertexArrayBinding {
     uint32_t stride;
     uint32_t offset;
     ShaderDataType format;
+    uint32_t divisor;
     bool operator==(const VertexArrayBinding&) const = default;
 };
 
@@ -103,20 +143,30 @@ struct VertexArrayBindingHasher {
         seed = hash_combine(seed, std::hash<uint32_t>()(binding.stride));
         seed = hash_combine(seed, std::hash<uint32_t>()(binding.offset));
         seed = hash_combine(seed, std::hash<uint8_t>()(static_cast<uint8_t>(binding.format)));
+        seed = hash_combine(seed, std::hash<uint32_t>()(binding.divisor));
         return seed;
     }
 };
 
+// Lookups build one of these in scratch memory, so only a cache miss allocates
+struct VAOKeyView {
+    Pipeline::program_id program;
+    std::span<const VertexArrayBinding> bindings;
+    Buffer::buffer_id indexBuffer; // 0 without one
+};
+
 struct VAOKey {
-    VAOKey(const Pipeline& pipeline) : program(pipeline.get()) {}
     Pipeline::program_id program;
     std::vector<VertexArrayBinding> bindings;
-    bool operator==(const VAOKey&) const = default;
+    Buffer::buffer_id indexBuffer;
+    operator VAOKeyView() const { return {.program = program, .bindings = bindings, .indexBuffer = indexBuffer}; }
 };
 
 struct VAOKeyHasher {
-    size_t operator()(const VAOKey& key) const {
+    using is_transparent = void;
+    size_t operator()(VAOKeyView key) const {
         size_t seed = std::hash<Pipeline::program_id>()(key.program);
+        seed = Airship::Utils::hash_combine(seed, std::hash<Buffer::buffer_id>()(key.indexBuffer));
         auto bindingHasher = VertexArrayBindingHasher();
         for (const auto& binding : key.bindings) {
             seed = Airship::Utils::hash_combine(seed, bindingHasher(binding));
@@ -125,20 +175,40 @@ struct VAOKeyHasher {
     }
 };
 
-std::unordered_map<VAOKey, VertexArray, VAOKeyHasher>& VAOCache() {
-    static std::unordered_map<VAOKey, VertexArray, VAOKeyHasher> g_VAOCache;
+struct VAOKeyEqual {
+    using is_transparent = void;
+    bool operator()(VAOKeyView a, VAOKeyView b) const {
+        return a.program == b.program && a.indexBuffer == b.indexBuffer && std::ranges::equal(a.bindings, b.bindings);
+    }
+};
+
+std::unordered_map<VAOKey, VertexArray, VAOKeyHasher, VAOKeyEqual>& VAOCache() {
+    static std::unordered_map<VAOKey, VertexArray, VAOKeyHasher, VAOKeyEqual> g_VAOCache;
     return g_VAOCache;
 }
 
-VertexArray& setupVertexArrayBinding(const Mesh& mesh, const Pipeline& pipeline) {
+// Drop the VAOs that use a buffer, before it's deleted or replaced
+void forgetVertexArrays(Buffer::buffer_id buffer) {
+    std::erase_if(VAOCache(), [buffer](const auto& item) {
+        const VAOKey& key = item.first;
+        [[maybe_unused]] const VertexArray& vao = item.second;
+        bool ret = key.indexBuffer == buffer ||
+                   std::ranges::any_of(key.bindings, [&](const auto& binding) { return binding.buffer == buffer; });
+        // NOLINTNEXTLINE(bugprone-lambda-function-name)
+        if (ret) SHIPLOG_DEBUG("Invalidating VAO {} due to buffer deletion", vao.id());
+        return ret;
+    });
+}
+
+VertexArray& setupVertexArrayBinding(const Mesh& mesh, const Pipeline& pipeline, std::pmr::memory_resource* scratch) {
     PROFILE_FUNCTION();
     SHIPLOG_DEBUG("Setting up vertex input bindings - {} pipeline attributes", pipeline.getVertexAttributes().size());
 
-    VAOKey key(pipeline);
-    key.bindings.reserve(pipeline.getVertexAttributes().size());
+    std::pmr::vector<VertexArrayBinding> bindings(scratch);
+    bindings.reserve(pipeline.getVertexAttributes().size());
     for (const auto& attr : pipeline.getVertexAttributes()) {
         PROFILE_SCOPE("Create VAO key");
-        VertexArrayBinding& binding = key.bindings.emplace_back();
+        VertexArrayBinding& binding = bindings.emplace_back();
         const VertexAttributeStream* stream = mesh.getStream(attr.name);
         assert(stream && "Shader requires missing vertex attribute");
         assert(stream->format == attr.format);
@@ -146,11 +216,13 @@ VertexArray& setupVertexArrayBinding(const Mesh& mesh, const Pipeline& pipeline)
         binding.buffer = stream->buffer->get();
         binding.binding = attr.location; // Assumed simple 1-1 mapping
         binding.stride = stream->stride;
-        binding.offset = stream->offset;
+        binding.offset = stream->offset + static_cast<uint32_t>(stream->buffer->drawOffset());
+        binding.divisor = stream->divisor;
         SHIPLOG_DEBUG("Binding attribute '{}':", attr.name);
         SHIPLOG_DEBUG(" - buffer ID: {}", binding.buffer);
         SHIPLOG_DEBUG(" - stride: {}", binding.stride);
         SHIPLOG_DEBUG(" - offset: {}", binding.offset);
+        SHIPLOG_DEBUG(" - divisor: {}", binding.divisor);
 
         binding.location = attr.location;
 
@@ -163,14 +235,24 @@ VertexArray& setupVertexArrayBinding(const Mesh& mesh, const Pipeline& pipeline)
         SHIPLOG_DEBUG(" - location: {}", binding.location);
         SHIPLOG_DEBUG(" - binding: {}", binding.binding);
     }
-    if (VAOCache().contains(key)) {
-        auto& ret = VAOCache().at(key);
-        SHIPLOG_DEBUG("Reusing cached VAO, with ID {}", ret.id());
-        return ret;
+    const IndexStream* indices = mesh.getIndexStream();
+    const VAOKeyView view{
+        .program = pipeline.get(), .bindings = bindings, .indexBuffer = indices ? indices->buffer->get() : 0};
+    if (auto cached = VAOCache().find(view); cached != VAOCache().end()) {
+        SHIPLOG_DEBUG("Reusing cached VAO, with ID {}", cached->second.id());
+        return cached->second;
     }
 
-    VertexArray& vao = VAOCache()[key];
-    for (const auto& binding : key.bindings) {
+    VertexArray& vao = VAOCache()
+                           .try_emplace(VAOKey{.program = view.program,
+                                               .bindings = {bindings.begin(), bindings.end()},
+                                               .indexBuffer = view.indexBuffer})
+                           .first->second;
+    if (view.indexBuffer != 0) {
+        glVertexArrayElementBuffer(vao.id(), view.indexBuffer);
+        CHECK_GL_ERROR();
+    }
+    for (const auto& binding : bindings) {
         PROFILE_SCOPE("Create VAO object");
         glVertexArrayVertexBuffer(vao.id(), binding.binding, binding.buffer, binding.offset,
                                   static_cast<GLsizei>(binding.stride));
@@ -185,10 +267,21 @@ VertexArray& setupVertexArrayBinding(const Mesh& mesh, const Pipeline& pipeline)
 
         glVertexArrayAttribBinding(vao.id(), binding.location, binding.binding);
         CHECK_GL_ERROR();
+
+        glVertexArrayBindingDivisor(vao.id(), binding.binding, binding.divisor);
+        CHECK_GL_ERROR();
     }
     return vao;
 }
 
+constexpr GLenum toGL(IndexType type) {
+    return type == IndexType::UInt16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+constexpr size_t indexSize(IndexType type) {
+    return type == IndexType::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
 constexpr GLenum toGL(ShaderType stype) {
     switch (stype) {
     case ShaderType::Vertex:
@@ -202,40 +295,54 @@ constexpr GLenum toGL(ShaderType stype) {
 }
 } // anonymous namespace
 
-void Mesh::draw() const {
+void Mesh::draw(size_t indexBufferOffset) const {
     PROFILE_FUNCTION();
-    assert(m_VertexCount % 3 == 0);
-    glDrawArrays(GL_TRIANGLES, 0, m_VertexCount);
+    if (m_IndexStream) {
+        assert(m_IndexCount % 3 == 0);
+        const GLenum type = toGL(m_IndexStream->type);
+        // Offsets into the bound index buffer are passed as pointers
+        const auto* first = reinterpret_cast<const void*>( // NOLINT(performance-no-int-to-ptr)
+            indexBufferOffset + (static_cast<uintptr_t>(m_IndexStream->first) * indexSize(m_IndexStream->type)));
+        if (m_InstanceCount == 1)
+            glDrawElementsBaseVertex(GL_TRIANGLES, m_IndexCount, type, first, m_BaseVertex);
+        else
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, m_IndexCount, type, first, m_InstanceCount, m_BaseVertex);
+    } else {
+        assert(m_VertexCount % 3 == 0);
+        if (m_InstanceCount == 1)
+            glDrawArrays(GL_TRIANGLES, m_BaseVertex, m_VertexCount);
+        else
+            glDrawArraysInstanced(GL_TRIANGLES, m_BaseVertex, m_VertexCount, m_InstanceCount);
+    }
     CHECK_GL_ERROR();
+    ++Bound().stats.draws;
 }
 
 // NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
-Buffer::Buffer() {
+Buffer::Buffer(BufferUsage usage) : m_Usage(usage) {
     // TODO: allow batch creation of buffers
     glCreateBuffers(1, &m_BufferID);
     SHIPLOG_TRACE("Created buffer with ID {}", m_BufferID);
     CHECK_GL_ERROR();
 }
 
-Buffer::Buffer(Buffer&& other) noexcept : m_BufferID(other.m_BufferID) {
+Buffer::Buffer(Buffer&& other) noexcept :
+    m_BufferID(other.m_BufferID), m_Usage(other.m_Usage), m_Size(std::exchange(other.m_Size, 0)),
+    m_Mapped(std::exchange(other.m_Mapped, nullptr)), m_Fences(std::exchange(other.m_Fences, {})),
+    m_Region(std::exchange(other.m_Region, 0)) {
     other.m_BufferID = GL_INVALID_VALUE;
+    for (auto& [buffer, region] : QueuedRegions()) {
+        if (buffer == &other) buffer = this;
+    }
 }
 
 Buffer::~Buffer() {
-    // Remove any VAOs based on this buffer
-    std::erase_if(VAOCache(), [this](const auto& item) {
-        const VAOKey& key = item.first;
-        [[maybe_unused]] const VertexArray& vao = item.second;
-        return std::ranges::any_of(key.bindings, [&](const auto& binding) {
-            bool ret = binding.buffer == m_BufferID;
-            // NOLINTNEXTLINE(bugprone-lambda-function-name)
-            if (ret) SHIPLOG_DEBUG("Invalidating VAO {} due to buffer deletion", vao.id());
-            return ret;
-        });
-    });
+    forgetVertexArrays(m_BufferID);
     SHIPLOG_TRACE("Deleting buffer with ID {}", m_BufferID);
+    releaseStream();
     glDeleteBuffers(1, &m_BufferID);
     CHECK_GL_ERROR();
+    if (m_Size > 0) Profiling::trackGpuDeallocation(allocatedBytes());
 }
 
 void Buffer::bind() const {
@@ -245,23 +352,247 @@ void Buffer::bind() const {
 }
 
 void Buffer::update(size_t bytes, const void* data) {
-    // GL_STATIC_DRAW: Set data once, used many times.
-    // TODO: Implement switching to GL_STREAM_DRAW or GL_DYNAMIC_DRAW
+    MEMORY_TAG_SCOPE(Renderer);
     SHIPLOG_TRACE("Updating buffer {} with {} bytes of data", m_BufferID, bytes);
     if (!glIsBuffer(m_BufferID)) {
         SHIPLOG_ERROR("Attempting to update invalid buffer {}", m_BufferID);
     };
-    if (bytes > m_Size) {
-        // Expand the buffer to fit the data
-        glNamedBufferData(m_BufferID, static_cast<GLsizeiptr>(bytes), data, GL_STATIC_DRAW);
-        CHECK_GL_ERROR();
-        m_Size = bytes;
-    } else {
+    switch (m_Usage) {
+    case BufferUsage::Static:
+        if (bytes > m_Size) {
+            // Expand the buffer to fit the data
+            glNamedBufferData(m_BufferID, static_cast<GLsizeiptr>(bytes), data, GL_STATIC_DRAW);
+            CHECK_GL_ERROR();
+            if (m_Size > 0) Profiling::trackGpuDeallocation(m_Size);
+            Profiling::trackGpuAllocation(bytes);
+            m_Size = bytes;
+        } else {
+            glNamedBufferSubData(m_BufferID, 0, static_cast<GLsizeiptr>(bytes), data);
+            CHECK_GL_ERROR();
+        }
+        return;
+    case BufferUsage::Dynamic: {
+        // Fresh storage every time, so draws still reading the old contents don't hold this up
+        const size_t size = std::max(bytes, m_Size);
+        glNamedBufferData(m_BufferID, static_cast<GLsizeiptr>(size), nullptr, GL_DYNAMIC_DRAW);
         glNamedBufferSubData(m_BufferID, 0, static_cast<GLsizeiptr>(bytes), data);
         CHECK_GL_ERROR();
+        if (size > m_Size) {
+            if (m_Size > 0) Profiling::trackGpuDeallocation(m_Size);
+            Profiling::trackGpuAllocation(size);
+            m_Size = size;
+        }
+        return;
+    }
+    case BufferUsage::Stream:
+        if (bytes == 0) return;
+        if (bytes > m_Size)
+            allocateStream(bytes);
+        else
+            advanceStream();
+        std::memcpy(m_Mapped + drawOffset(), data, bytes);
+        return;
     }
 }
 
+void Buffer::updateRange(size_t offset, size_t bytes, const void* data) {
+    MEMORY_TAG_SCOPE(Renderer);
+    SHIPLOG_TRACE("Updating {} bytes of buffer {} at offset {}", bytes, m_BufferID, offset);
+    assert(offset + bytes <= m_Size && "Range updates can't grow the buffer");
+    if (m_Usage != BufferUsage::Stream) {
+        glNamedBufferSubData(m_BufferID, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes), data);
+        CHECK_GL_ERROR();
+        return;
+    }
+
+    // The rest of the contents come along from the previous region, copied on the GPU
+    const size_t previous = drawOffset();
+    advanceStream();
+    const size_t current = drawOffset();
+    const size_t end = offset + bytes;
+    if (offset > 0) {
+        glCopyNamedBufferSubData(m_BufferID, m_BufferID, static_cast<GLintptr>(previous),
+                                 static_cast<GLintptr>(current), static_cast<GLsizeiptr>(offset));
+    }
+    if (end < m_Size) {
+        glCopyNamedBufferSubData(m_BufferID, m_BufferID, static_cast<GLintptr>(previous + end),
+                                 static_cast<GLintptr>(current + end), static_cast<GLsizeiptr>(m_Size - end));
+    }
+    CHECK_GL_ERROR();
+    std::memcpy(m_Mapped + current + offset, data, bytes);
+}
+
+void Buffer::reserve(size_t bytes) {
+    MEMORY_TAG_SCOPE(Renderer);
+    if (bytes <= m_Size) return;
+    SHIPLOG_TRACE("Reserving {} bytes for buffer {}", bytes, m_BufferID);
+    if (m_Usage == BufferUsage::Stream) {
+        allocateStream(bytes);
+        return;
+    }
+    const GLenum usage = m_Usage == BufferUsage::Static ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW;
+    glNamedBufferData(m_BufferID, static_cast<GLsizeiptr>(bytes), nullptr, usage);
+    CHECK_GL_ERROR();
+    if (m_Size > 0) Profiling::trackGpuDeallocation(m_Size);
+    Profiling::trackGpuAllocation(bytes);
+    m_Size = bytes;
+}
+
+void Buffer::allocateStream(size_t bytes) {
+    PROFILE_FUNCTION();
+    // Storage from glNamedBufferStorage is immutable, so growing means a new buffer, and new VAOs to go with it
+    if (m_Size > 0) {
+        // Queued draws hold on to the old VAOs
+        if (const Renderer* renderer = Bound().queued) renderer->flush();
+        forgetVertexArrays(m_BufferID);
+        releaseStream();
+        glDeleteBuffers(1, &m_BufferID);
+        glCreateBuffers(1, &m_BufferID);
+        CHECK_GL_ERROR();
+        Profiling::trackGpuDeallocation(allocatedBytes());
+    }
+    m_Size = bytes;
+    m_Region = 0;
+    constexpr GLbitfield FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glNamedBufferStorage(m_BufferID, static_cast<GLsizeiptr>(allocatedBytes()), nullptr, FLAGS);
+    m_Mapped = static_cast<std::byte*>(
+        glMapNamedBufferRange(m_BufferID, 0, static_cast<GLsizeiptr>(allocatedBytes()), FLAGS));
+    CHECK_GL_ERROR();
+    Profiling::trackGpuAllocation(allocatedBytes());
+    SHIPLOG_TRACE("Allocated {} stream regions of {} bytes for buffer {}", STREAM_REGIONS, bytes, m_BufferID);
+}
+
+void Buffer::advanceStream() {
+    auto& queued = QueuedRegions();
+    if (Bound().queued != nullptr) {
+        // Draws from the current region may still be queued, and it's fenced once they're issued
+        queued.emplace_back(this, m_Region);
+    } else {
+        // Everything drawn from the current region so far is before this fence
+        m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    m_Region = (m_Region + 1) % STREAM_REGIONS;
+    if (std::ranges::find(queued, std::pair{this, m_Region}) != queued.end()) Bound().queued->flush();
+    if (auto fence = static_cast<GLsync>(std::exchange(m_Fences[m_Region], nullptr))) {
+        constexpr GLuint64 WAIT_FOREVER_NS = ~GLuint64(0);
+        // Only waits when this buffer is rewritten more than STREAM_REGIONS times a frame or so
+        if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_FOREVER_NS) == GL_WAIT_FAILED)
+            SHIPLOG_ERROR("Waiting on stream region {} of buffer {} failed", m_Region, m_BufferID);
+        glDeleteSync(fence);
+    }
+    CHECK_GL_ERROR();
+}
+
+void Buffer::releaseStream() {
+    std::erase_if(QueuedRegions(), [this](const auto& queued) { return queued.first == this; });
+    for (void*& fence : m_Fences) {
+        if (fence) glDeleteSync(static_cast<GLsync>(std::exchange(fence, nullptr)));
+    }
+    if (m_Mapped) {
+        glUnmapNamedBuffer(m_BufferID);
+        m_Mapped = nullptr;
+    }
+}
+
+void Buffer::fenceQueuedRegions() {
+    for (const auto& [buffer, region] : QueuedRegions()) {
+        if (auto fence = static_cast<GLsync>(buffer->m_Fences[region])) glDeleteSync(fence);
+        buffer->m_Fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    CHECK_GL_ERROR();
+    QueuedRegions().clear();
+}
+
+IndexType Buffer::updateIndices(std::span<const uint32_t> indices) {
+    MEMORY_TAG_SCOPE(Renderer);
+    if (!indices.empty() && std::ranges::max(indices) > UINT16_MAX) {
+        update(indices.size_bytes(), indices.data());
+        return IndexType::UInt32;
+    }
+    // Kept between calls, so narrowing doesn't allocate once it has grown to the largest update. Like every GL call,
+    // this only happens on the context's thread.
+    static std::vector<uint16_t> g_Narrowed;
+    g_Narrowed.assign(indices.begin(), indices.end());
+    update(g_Narrowed.size() * sizeof(uint16_t), g_Narrowed.data());
+    return IndexType::UInt16;
+}
+
+RenderTarget::RenderTarget(int width, int height) : m_Width(width), m_Height(height) {
+    assert(width > 0 && height > 0);
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_ColorTexture);
+    glTextureStorage2D(m_ColorTexture, 1, GL_RGBA8, width, height);
+    CHECK_GL_ERROR();
+
+    glCreateFramebuffers(1, &m_FramebufferID);
+    glNamedFramebufferTexture(m_FramebufferID, GL_COLOR_ATTACHMENT0, m_ColorTexture, 0);
+    CHECK_GL_ERROR();
+    if (glCheckNamedFramebufferStatus(m_FramebufferID, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        SHIPLOG_ERROR("Render target {} is incomplete", m_FramebufferID);
+
+    glCreateBuffers(static_cast<GLsizei>(m_PixelBuffers.size()), m_PixelBuffers.data());
+    for (auto pbo : m_PixelBuffers)
+        glNamedBufferData(pbo, static_cast<GLsizeiptr>(imageBytes()), nullptr, GL_STREAM_READ);
+    CHECK_GL_ERROR();
+    SHIPLOG_TRACE("Created {}x{} render target with ID {}", width, height, m_FramebufferID);
+}
+
+RenderTarget::~RenderTarget() {
+    SHIPLOG_TRACE("Deleting render target with ID {}", m_FramebufferID);
+    for (void* fence : m_Fences) {
+        if (fence) glDeleteSync(static_cast<GLsync>(fence));
+    }
+    glDeleteBuffers(static_cast<GLsizei>(m_PixelBuffers.size()), m_PixelBuffers.data());
+    glDeleteFramebuffers(1, &m_FramebufferID);
+    glDeleteTextures(1, &m_ColorTexture);
+    CHECK_GL_ERROR();
+}
+
+bool RenderTarget::requestReadback() {
+    PROFILE_FUNCTION();
+    if (m_PendingCount == MAX_PENDING_READBACKS) return false;
+    const size_t slot = (m_NextPending + m_PendingCount) % MAX_PENDING_READBACKS;
+    // Draws are only issued at flush, and any still queued belong in the copy
+    if (const Renderer* renderer = Bound().queued) renderer->flush();
+
+    // With a pack buffer bound, glReadPixels only queues the copy and returns immediately
+    glNamedFramebufferReadBuffer(m_FramebufferID, GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_FramebufferID);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_PixelBuffers[slot]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, m_Width, m_Height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    CHECK_GL_ERROR();
+
+    m_Fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    CHECK_GL_ERROR();
+    ++m_PendingCount;
+    return true;
+}
+
+bool RenderTarget::collectReadback(std::vector<uint8_t>& pixels, bool wait) {
+    PROFILE_FUNCTION();
+    if (m_PendingCount == 0) return false;
+    const size_t slot = m_NextPending;
+
+    auto fence = static_cast<GLsync>(m_Fences[slot]);
+    constexpr GLuint64 WAIT_FOREVER_NS = ~GLuint64(0);
+    const GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? WAIT_FOREVER_NS : 0);
+    CHECK_GL_ERROR();
+    if (status == GL_TIMEOUT_EXPIRED) return false;
+    if (status == GL_WAIT_FAILED) SHIPLOG_ERROR("Waiting on readback for render target {} failed", m_FramebufferID);
+
+    glDeleteSync(fence);
+    m_Fences[slot] = nullptr;
+    m_NextPending = (m_NextPending + 1) % MAX_PENDING_READBACKS;
+    --m_PendingCount;
+
+    pixels.resize(imageBytes());
+    glGetNamedBufferSubData(m_PixelBuffers[slot], 0, static_cast<GLsizeiptr>(pixels.size()), pixels.data());
+    CHECK_GL_ERROR();
+    return true;
+}
+
 VertexArray::VertexArray() {
     // TODO: Allow batch creation of VAOs
     glCreateVertexArrays(1, &m_VertexArrayID);
@@ -273,12 +604,13 @@ VertexArray::~VertexArray() {
     SHIPLOG_TRACE("Deleting vertex array with ID {}", m_VertexArrayID);
     glDeleteVertexArrays(1, &m_VertexArrayID);
     CHECK_GL_ERROR();
+    // Deleting it unbinds it, and the ID can come back for a new one
+    if (Bound().vertexArray == m_VertexArrayID) Bound().vertexArray = 0;
 }
 
 void VertexArray::bind() const {
     PROFILE_FUNCTION();
-    glBindVertexArray(m_VertexArrayID);
-    CHECK_GL_ERROR();
+    bindVertexArray(m_VertexArrayID);
 }
 
 VertexArray::VertexArray(VertexArray&& other) noexcept : m_VertexArrayID(other.m_VertexArrayID) {
@@ -286,8 +618,9 @@ VertexArray::VertexArray(VertexArray&& other) noexcept : m_VertexArrayID(other.m
 }
 
 // Requires an active OpenGL context, so we can't do this in the constructor. Instead, call this from the
-// application after creating the window -- even in headless mode, as we may to do offscreen rendering.
+// application after creating the window. Server mode has no context and never calls this.
 void Renderer::init() {
+    MEMORY_TAG_SCOPE(Renderer);
     if (gl3wInit() != 0) {
         SHIPLOG_MAYDAY("Unable to initialize gl3w");
         std::abort();
@@ -296,15 +629,31 @@ void Renderer::init() {
     CHECK_GL_ERROR();
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     CHECK_GL_ERROR();
+    // A new context has nothing bound
+    Bound() = {};
 }
 
-void Renderer::resize(int width, int height) const {
+void Renderer::resize(int width, int height) {
     SHIPLOG_TRACE("Window resized to {}x{}", width, height);
+    m_Width = width;
+    m_Height = height;
     glViewport(0, 0, width, height);
     CHECK_GL_ERROR();
 }
 
+void Renderer::setRenderTarget(const RenderTarget* target) const {
+    flush();
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target ? target->get() : 0);
+    CHECK_GL_ERROR();
+    if (target)
+        glViewport(0, 0, target->width(), target->height());
+    else
+        glViewport(0, 0, m_Width, m_Height);
+    CHECK_GL_ERROR();
+}
+
 Shader::Shader(ShaderType stype, const std::string& source) : m_ShaderID(glCreateShader(toGL(stype))) {
+    MEMORY_TAG_SCOPE(Renderer);
     const char* src = source.c_str();
     glShaderSource(m_ShaderID, 1, &src, nullptr);
     glCompileShader(m_ShaderID);
@@ -348,6 +697,7 @@ Shader::~Shader() {
 
 Pipeline::Pipeline(const Shader& vShader, const Shader& fShader, const std::vector<VertexAttributeDesc>& attribs) :
     m_ProgramID(glCreateProgram()), m_VertexAttribs(attribs) {
+    MEMORY_TAG_SCOPE(Renderer);
     SHIPLOG_TRACE("Linking pipeline {}", m_ProgramID);
     for (const auto& attr : attribs) {
         (void) attr; // Possibly unused after stripping
@@ -385,11 +735,15 @@ int Pipeline::GetUniformLocation(const std::string& name) const {
 }
 
 void Pipeline::bind() const {
-    SHIPLOG_INFO("Binding program {}", m_ProgramID);
     PROFILE_FUNCTION();
     assert(m_ProgramID != 0);
+    BoundState& bound = Bound();
+    if (bound.program == m_ProgramID) return;
+    SHIPLOG_TRACE("Binding program {}", m_ProgramID);
     glUseProgram(m_ProgramID);
     CHECK_GL_ERROR();
+    bound.program = m_ProgramID;
+    ++bound.stats.programBinds;
 }
 
 Pipeline::~Pipeline() {
@@ -402,17 +756,35 @@ Pipeline::~Pipeline() {
         return doDelete;
     });
     SHIPLOG_TRACE("Deleting pipeline {}", m_ProgramID);
+    // A program in use is only deleted once it's unbound, and until then a new one couldn't take its ID and be bound
+    BoundState& bound = Bound();
+    if (bound.program == m_ProgramID && m_ProgramID != 0) {
+        glUseProgram(0);
+        bound.program = 0;
+    }
+    bound.uniformStamps.erase(m_ProgramID);
     glDeleteProgram(m_ProgramID);
     CHECK_GL_ERROR();
     m_ProgramID = 0;
 }
 
+uint64_t Material::NextUniformStamp() {
+    static std::atomic<uint64_t> g_NextStamp = 1;
+    return g_NextStamp.fetch_add(1, std::memory_order_relaxed);
+}
+
 void Material::Bind() const {
     m_Pipeline->bind();
+    // Uniforms belong to the program, so they're still there from the last time this material was bound, unless
+    // another material using the same program has been bound since
+    uint64_t& programStamp = Bound().uniformStamps[m_Pipeline->get()];
+    if (programStamp == m_UniformStamp) return;
+    programStamp = m_UniformStamp;
+
     for (const auto& [name, uVariant] : m_Uniforms) {
-        if (!uVariant.dirty) continue;
-        int loc = m_Pipeline->GetUniformLocation(name);
+        const int loc = uVariant.location;
         if (loc < 0) continue; // Example: commented out, or optimized out
+        ++Bound().stats.uniformUploads;
 
         std::visit(
             [&](auto&& val) {
@@ -435,6 +807,7 @@ void Material::Bind() const {
 }
 
 void Renderer::clear() const {
+    flush();
     glClearColor(m_ClearColor.r, m_ClearColor.g, m_ClearColor.b, m_ClearColor.a);
     glClear(GL_COLOR_BUFFER_BIT);
     CHECK_GL_ERROR();
@@ -448,14 +821,64 @@ void Renderer::draw(const std::vector<Mesh>& meshes, const Material& mat, bool d
 
 void Renderer::draw(const Mesh& mesh, const Material& mat, bool doClear) const {
     PROFILE_FUNCTION();
-    SHIPLOG_TRACE("Drawing mesh with {} vertices", mesh.vertexCount());
+    MEMORY_TAG_SCOPE(Renderer);
+    SHIPLOG_TRACE("Drawing mesh with {} vertices, {} indices, {} instances", mesh.vertexCount(), mesh.indexCount(),
+                  mesh.instanceCount());
     if (doClear) clear();
     mat.Bind();
-    VertexArray& vao = setupVertexArrayBinding(mesh, mat.pipeline());
+    VertexArray& vao = setupVertexArrayBinding(mesh, mat.pipeline(), scratchResource());
     vao.bind();
     mesh.draw();
 }
 
+void Renderer::submit(const Mesh& mesh, const Material& mat, uint8_t layer, float depth) const {
+    PROFILE_FUNCTION();
+    MEMORY_TAG_SCOPE(Renderer);
+    if (mesh.empty()) return;
+    const VertexArray& vao = setupVertexArrayBinding(mesh, mat.pipeline(), scratchResource());
+
+    // Most significant first: layer | program | uniforms | vertex array | depth. IDs are truncated, which at worst
+    // splits up draws that could have shared binds.
+    constexpr uint64_t ID_MASK = 0xFFFF;
+    const auto depthBits = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * 255.0f);
+    const uint64_t key = (uint64_t(layer) << 56) | ((uint64_t(mat.pipeline().get()) & ID_MASK) << 40) |
+                         ((mat.uniformStamp() & ID_MASK) << 24) | ((uint64_t(vao.id()) & ID_MASK) << 8) | depthBits;
+    m_SortEntries.push_back({.key = key, .index = static_cast<uint32_t>(m_Queue.size())});
+    m_Queue.push_back(
+        {.mesh = &mesh, .material = &mat, .vertexArray = vao.id(), .indexOffset = mesh.indexOffset()});
+    Bound().queued = this;
+}
+
+void Renderer::flush() const {
+    PROFILE_FUNCTION();
+    if (m_Queue.empty()) return;
+    MEMORY_TAG_SCOPE(Renderer);
+    SHIPLOG_TRACE("Flushing {} queued draws", m_Queue.size());
+    Utils::radixSortByKey(m_SortEntries, m_SortScratch);
+    for (const SortEntry& entry : m_SortEntries) {
+        const QueuedDraw& queued = m_Queue[entry.index];
+        queued.material->Bind();
+        bindVertexArray(queued.vertexArray);
+        queued.mesh->draw(queued.indexOffset);
+    }
+    m_Queue.clear();
+    m_SortEntries.clear();
+    Bound().queued = nullptr;
+    Buffer::fenceQueuedRegions();
+}
+
+void Renderer::endFrame() const {
+    flush();
+    m_FrameStats = std::exchange(Bound().stats, {});
+    Profiling::recordCounter("draw calls", m_FrameStats.draws);
+    Profiling::recordCounter("state changes",
+                             m_FrameStats.programBinds + m_FrameStats.vertexArrayBinds + m_FrameStats.uniformUploads);
+}
+
+std::pmr::memory_resource* Renderer::scratchResource() const {
+    return m_FrameArena != nullptr ? m_FrameArena->Resource() : std::pmr::get_default_resource();
+}
+
 void Renderer::setClearColor(const RGBColor& color) {
     m_ClearColor = color;
 }
@@ -33,7 +33,8 @@ extern const ::testing::Environment* airship_environment;
 class GameClass : public Airship::Application {
 public:
     GameClass(bool servermode) : Airship::Application(servermode) {}
-    GameClass(int width, int height) : Airship::Application(width, height, "test app") {}
+    GameClass(int width, int height, bool visible = true) :
+        Airship::Application(width, height, "test app", visible) {}
     GameClass() : GameClass(600, 800) {}
     [[nodiscard]] Airship::Window* GetWindow() const { return m_MainWindow.get(); }
     [[nodiscard]] const Airship::Renderer& GetRenderer() const { return m_Renderer; }
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "gtest/gtest.h"
 #include "test/common.h"
 
@@ -10,10 +12,49 @@ TEST(Window, nonnull) {
 TEST(Window, null) {
     Airship::Test::GameClass app(-1, -1);
     EXPECT_DEATH(app.Run(), "");
+}
+TEST(Application, ServerIsHeadless) {
+    Airship::Test::GameClass app(true);
+    EXPECT_TRUE(app.IsServer());
+    app.Run();
+
+    // Server mode never creates a window or GL context
+    EXPECT_EQ(app.GetWindow(), nullptr);
+}
 
-    Airship::Test::GameClass app2(true);
-    app2.Run();
+class FixedStepGame : public Airship::Test::GameClass {
+public:
+    FixedStepGame() {
+        SetFixedTimestep(0.002f, 3);
+        SetTargetFrameRate(200);
+    }
+
+    int fixedUpdates = 0;
+    int frames = 0;
+    float minAlpha = 1.0f;
+    float maxAlpha = 0.0f;
+
+protected:
+    void OnFixedUpdate(float dt) override {
+        EXPECT_FLOAT_EQ(dt, 0.002f);
+        ++fixedUpdates;
+    }
+    void OnGameLoop(float /*elapsed*/) override { m_ShouldClose = ++frames == 20; }
+    void OnRender(float alpha) override {
+        minAlpha = std::min(minAlpha, alpha);
+        maxAlpha = std::max(maxAlpha, alpha);
+    }
+};
+
+TEST(Application, FixedTimestep) {
+    FixedStepGame app;
+    app.Run();
 
-    // Even in server mode, we should still have a window (for offscreen rendering)
-    EXPECT_NE(app2.GetWindow(), nullptr);
+    // 5ms frames at 2ms per step: two or three steps each, after the first
+    EXPECT_EQ(app.frames, 20);
+    EXPECT_GE(app.fixedUpdates, 19 * 2);
+    EXPECT_LE(app.fixedUpdates, 19 * 3);
+    EXPECT_GE(app.minAlpha, 0.0f);
+    EXPECT_LT(app.maxAlpha, 1.0f);
+    EXPECT_GE(app.GetFrameStats().frame.percentile(0.5), 5'000'000);
 }
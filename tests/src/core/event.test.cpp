@@ -1,6 +1,13 @@
 #include "core/event.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <span>
+#include <stdexcept>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -166,3 +173,526 @@ TEST(Event, DataIntegrity) {
     ep.Process();
     EXPECT_TRUE(eventTriggered);
 }
+
+struct OtherEvent {
+    int value;
+};
+
+// Removing one subscriber must leave everyone else's callbacks alone, on every channel
+TEST(Event, RemoveOneOfMany) {
+    Airship::EventPublisher ep;
+
+    int countA = 0, countB = 0, otherSum = 0;
+    Airship::EventSubscriber esA;
+    esA.SubscribeTo<TestEvent>(ep, [&countA](const TestEvent& /*e*/) { ++countA; });
+    {
+        Airship::EventSubscriber esB;
+        esB.SubscribeTo<TestEvent>(ep, [&countB](const TestEvent& /*e*/) { ++countB; });
+        esB.SubscribeTo<OtherEvent>(ep, [&otherSum](const OtherEvent& e) { otherSum += e.value; });
+        EXPECT_EQ(ep.SubscriberCount(), 3);
+        EXPECT_EQ(ep.EventCount(), 3);
+
+        ep.PublishSync(TestEvent{});
+        ep.PublishSync(OtherEvent{.value = 2});
+        EXPECT_EQ(countA, 1);
+        EXPECT_EQ(countB, 1);
+        EXPECT_EQ(otherSum, 2);
+    }
+    EXPECT_EQ(ep.SubscriberCount(), 1);
+    EXPECT_EQ(ep.EventCount(), 1);
+
+    ep.PublishSync(TestEvent{});
+    ep.PublishSync(OtherEvent{.value = 2});
+    EXPECT_EQ(countA, 2);
+    EXPECT_EQ(countB, 1);
+    EXPECT_EQ(otherSum, 2);
+}
+
+struct SequencedEvent {
+    int producer;
+    int sequence;
+};
+
+// Producers publish concurrently with Process; every event arrives exactly once, in order per producer
+TEST(Event, ConcurrentPublish) {
+    constexpr int PRODUCERS = 4;
+    constexpr int EVENTS_PER_PRODUCER = 20000;
+
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+    std::array<int, PRODUCERS> nextSequence{};
+    bool inOrder = true;
+    es.SubscribeTo<SequencedEvent>(ep, [&](const SequencedEvent& e) {
+        inOrder &= e.sequence == nextSequence[e.producer];
+        nextSequence[e.producer] = e.sequence + 1;
+    });
+
+    std::atomic<int> finished = 0;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&ep, &finished, p] {
+            for (int i = 0; i < EVENTS_PER_PRODUCER; ++i)
+                ep.Publish(SequencedEvent{.producer = p, .sequence = i});
+            ++finished;
+        });
+    }
+    while (finished < PRODUCERS)
+        ep.Process();
+    for (auto& producer : producers)
+        producer.join();
+    ep.Process();
+
+    EXPECT_TRUE(inOrder);
+    for (int count : nextSequence)
+        EXPECT_EQ(count, EVENTS_PER_PRODUCER);
+}
+
+// Events bigger than a queue chunk, and events that own memory, survive the queue intact and are destroyed after
+TEST(Event, QueuedEventLifetime) {
+    struct LargeEvent {
+        std::array<char, 100000> bytes;
+        std::shared_ptr<int> owned;
+    };
+
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+    int received = 0;
+    es.SubscribeTo<LargeEvent>(ep, [&received](const LargeEvent& e) {
+        EXPECT_EQ(e.bytes.front(), 'a');
+        EXPECT_EQ(e.bytes.back(), 'z');
+        received += *e.owned;
+    });
+
+    auto owned = std::make_shared<int>(1);
+    {
+        auto event = std::make_unique<LargeEvent>();
+        event->bytes.front() = 'a';
+        event->bytes.back() = 'z';
+        event->owned = owned;
+        ep.Publish(*event);
+        ep.Publish(*event);
+    }
+    EXPECT_EQ(owned.use_count(), 3);
+
+    ep.Process();
+    EXPECT_EQ(received, 2);
+    EXPECT_EQ(owned.use_count(), 1);
+
+    // Anything still queued is destroyed with the publisher
+    {
+        Airship::EventPublisher other;
+        other.Publish(LargeEvent{.bytes = {}, .owned = owned});
+        EXPECT_EQ(owned.use_count(), 2);
+    }
+    EXPECT_EQ(owned.use_count(), 1);
+}
+
+// Events published while processing wait for the next Process
+TEST(Event, PublishDuringProcess) {
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+    int count = 0;
+    es.SubscribeTo<TestEvent>(ep, [&](const TestEvent& e) {
+        ++count;
+        ep.Publish(e);
+    });
+
+    ep.Publish(TestEvent{});
+    ep.Process();
+    EXPECT_EQ(count, 1);
+    ep.Process();
+    EXPECT_EQ(count, 2);
+}
+
+TEST(Event, SubscriptionHandles) {
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+    int countA = 0, countB = 0;
+    const auto a = es.SubscribeTo<TestEvent>(ep, [&countA](const TestEvent& /*e*/) { ++countA; });
+    const auto b = es.SubscribeTo<TestEvent>(ep, [&countB](const TestEvent& /*e*/) { ++countB; });
+    EXPECT_TRUE(a);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(ep.SubscriberCount(), 2);
+
+    EXPECT_TRUE(es.Unsubscribe(ep, a));
+    EXPECT_FALSE(ep.Unsubscribe(a));
+    EXPECT_EQ(ep.SubscriberCount(), 1);
+    EXPECT_EQ(es.SubscribedCount(), 1);
+
+    ep.PublishSync(TestEvent{});
+    EXPECT_EQ(countA, 0);
+    EXPECT_EQ(countB, 1);
+
+    // The freed slot is reused, but the old handle must not reach the new subscription
+    int countC = 0;
+    const auto c = es.SubscribeTo<TestEvent>(ep, [&countC](const TestEvent& /*e*/) { ++countC; });
+    EXPECT_FALSE(ep.Unsubscribe(a));
+    ep.PublishSync(TestEvent{});
+    EXPECT_EQ(countB, 2);
+    EXPECT_EQ(countC, 1);
+
+    EXPECT_TRUE(es.Unsubscribe(ep, b));
+    EXPECT_TRUE(es.Unsubscribe(ep, c));
+    EXPECT_EQ(ep.SubscriberCount(), 0);
+    EXPECT_EQ(es.SubscribedCount(), 0);
+}
+
+TEST(Event, UnsubscribeInAnyOrder) {
+    constexpr int SUBSCRIPTIONS = 1000;
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+    std::vector<int> counts(SUBSCRIPTIONS);
+    std::vector<Airship::SubscriptionHandle> handles;
+    for (int i = 0; i < SUBSCRIPTIONS; ++i)
+        handles.push_back(es.SubscribeTo<TestEvent>(ep, [&counts, i](const TestEvent& /*e*/) { ++counts[i]; }));
+
+    // Every other one from the front, so the subscriber's list keeps shuffling handles into the gaps
+    for (int i = 0; i < SUBSCRIPTIONS; i += 2)
+        EXPECT_TRUE(es.Unsubscribe(ep, handles[i]));
+    EXPECT_EQ(ep.SubscriberCount(), SUBSCRIPTIONS / 2);
+    ep.PublishSync(TestEvent{});
+    for (int i = 0; i < SUBSCRIPTIONS; ++i)
+        EXPECT_EQ(counts[i], i % 2);
+
+    for (int i = SUBSCRIPTIONS - 1; i > 0; i -= 2)
+        EXPECT_TRUE(es.Unsubscribe(ep, handles[i]));
+    EXPECT_EQ(ep.SubscriberCount(), 0);
+    EXPECT_EQ(es.SubscribedCount(), 0);
+}
+
+// Callbacks can unsubscribe themselves or others, and subscribe new callbacks, mid-dispatch
+TEST(Event, SubscribeDuringDispatch) {
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+
+    int selfCount = 0, laterCount = 0, addedCount = 0;
+    Airship::SubscriptionHandle self, later;
+    self = es.SubscribeTo<TestEvent>(ep, [&](const TestEvent& /*e*/) {
+        ++selfCount;
+        es.Unsubscribe(ep, self);
+        es.Unsubscribe(ep, later);
+        es.SubscribeTo<TestEvent>(ep, [&addedCount](const TestEvent& /*e*/) { ++addedCount; });
+    });
+    later = es.SubscribeTo<TestEvent>(ep, [&laterCount](const TestEvent& /*e*/) { ++laterCount; });
+
+    ep.PublishSync(TestEvent{});
+    EXPECT_EQ(selfCount, 1);
+    EXPECT_EQ(laterCount, 0);
+    EXPECT_EQ(addedCount, 0);
+    EXPECT_EQ(ep.SubscriberCount(), 1);
+
+    ep.PublishSync(TestEvent{});
+    EXPECT_EQ(selfCount, 1);
+    EXPECT_EQ(addedCount, 1);
+}
+
+// A throwing callback leaves the publisher as it would any other dispatch
+TEST(Event, ThrowingCallback) {
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+
+    bool thrown = false;
+    int addedCount = 0;
+    es.SubscribeTo<TestEvent>(ep, [&](const TestEvent& /*e*/) {
+        if (thrown) return;
+        thrown = true;
+        es.SubscribeTo<TestEvent>(ep, [&addedCount](const TestEvent& /*e*/) { ++addedCount; });
+        throw std::runtime_error("callback failed");
+    });
+    EXPECT_THROW(ep.PublishSync(TestEvent{}), std::runtime_error);
+    EXPECT_EQ(addedCount, 0);
+
+    // The subscription made before the throw was still added, and new ones go straight in
+    int laterCount = 0;
+    es.SubscribeTo<TestEvent>(ep, [&laterCount](const TestEvent& /*e*/) { ++laterCount; });
+    ep.PublishSync(TestEvent{});
+    EXPECT_EQ(addedCount, 1);
+    EXPECT_EQ(laterCount, 1);
+}
+
+TEST(Event, ThrowingQueuedCallback) {
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+
+    int earlierCount = 0;
+    std::vector<int> seen;
+    es.SubscribeTo<OtherEvent>(ep, [&earlierCount](const OtherEvent& /*e*/) { ++earlierCount; });
+    es.SubscribeTo<OtherEvent>(ep, [&seen](const OtherEvent& e) {
+        seen.push_back(e.value);
+        if (e.value == 1) throw std::runtime_error("callback failed");
+    });
+    for (int i = 1; i <= 3; ++i)
+        ep.Publish(OtherEvent{.value = i});
+    EXPECT_THROW(ep.Process(), std::runtime_error);
+
+    // The event that threw isn't dispatched again, and doesn't hold up the ones behind it
+    ep.Process();
+    EXPECT_EQ(seen, (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(earlierCount, 3);
+}
+
+TEST(Event, ManySubscribers) {
+    constexpr int SUBSCRIBERS = 10000;
+    Airship::EventPublisher ep;
+    int count = 0;
+    {
+        std::vector<std::unique_ptr<Airship::EventSubscriber>> subscribers;
+        for (int i = 0; i < SUBSCRIBERS; ++i) {
+            auto& subscriber = subscribers.emplace_back(std::make_unique<Airship::EventSubscriber>());
+            subscriber->SubscribeTo<TestEvent>(ep, [&count](const TestEvent& /*e*/) { ++count; });
+        }
+        ep.PublishSync(TestEvent{});
+        EXPECT_EQ(count, SUBSCRIBERS);
+
+        // Despawn every other subscriber
+        for (size_t i = 0; i < subscribers.size(); i += 2)
+            subscribers[i].reset();
+        EXPECT_EQ(ep.SubscriberCount(), SUBSCRIBERS / 2);
+        ep.PublishSync(TestEvent{});
+        EXPECT_EQ(count, SUBSCRIBERS + SUBSCRIBERS / 2);
+    }
+    EXPECT_EQ(ep.SubscriberCount(), 0);
+    ep.PublishSync(TestEvent{});
+    EXPECT_EQ(count, SUBSCRIBERS + SUBSCRIBERS / 2);
+}
+
+TEST(Event, BatchSubscriber) {
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+
+    std::vector<size_t> batchSizes;
+    std::vector<int> batchValues;
+    int perEvent = 0;
+    es.SubscribeBatch<OtherEvent>(ep, [&](std::span<const OtherEvent> events) {
+        // Per-event callbacks have already seen the whole frame
+        EXPECT_EQ(perEvent, static_cast<int>(events.size()));
+        batchSizes.push_back(events.size());
+        for (const auto& e : events)
+            batchValues.push_back(e.value);
+    });
+    es.SubscribeTo<OtherEvent>(ep, [&perEvent](const OtherEvent& /*e*/) { ++perEvent; });
+    EXPECT_EQ(ep.SubscriberCount(), 2);
+
+    for (int i = 0; i < 5; ++i)
+        ep.Publish(OtherEvent{.value = i});
+    ep.Publish(TestEvent{});
+    ep.Process();
+    EXPECT_EQ(batchSizes, std::vector<size_t>{5});
+    EXPECT_EQ(batchValues, (std::vector<int>{0, 1, 2, 3, 4}));
+
+    // Nothing queued, so no batch call
+    perEvent = 0;
+    ep.Process();
+    EXPECT_EQ(batchSizes.size(), 1);
+
+    // PublishSync delivers a batch of one
+    perEvent = 0;
+    ep.PublishSync(OtherEvent{.value = 7});
+    EXPECT_EQ(batchSizes, (std::vector<size_t>{5, 1}));
+    EXPECT_EQ(batchValues.back(), 7);
+}
+
+TEST(Event, ThrowWhileStaging) {
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+
+    std::vector<int> batchValues;
+    es.SubscribeBatch<OtherEvent>(ep, [&batchValues](std::span<const OtherEvent> events) {
+        for (const auto& e : events)
+            batchValues.push_back(e.value);
+    });
+    es.SubscribeTo<OtherEvent>(ep, [](const OtherEvent& e) {
+        if (e.value < 0) throw std::runtime_error("callback failed");
+    });
+
+    // The first event is staged before the second one throws, and goes with the rest of the frame
+    ep.Publish(OtherEvent{.value = 1});
+    ep.Publish(OtherEvent{.value = -1});
+    EXPECT_THROW(ep.Process(), std::runtime_error);
+    ep.Publish(OtherEvent{.value = 2});
+    ep.Process();
+    EXPECT_EQ(batchValues, std::vector<int>{2});
+}
+
+TEST(Event, QueuePolicies) {
+    struct ResizeEvent {
+        int width, height;
+    };
+    struct ScrollEvent {
+        int delta;
+    };
+    struct CursorEvent {
+        int x;
+    };
+
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+    ep.SetCoalesce<ResizeEvent>();
+    ep.SetMerge<ScrollEvent>([](ScrollEvent& waiting, const ScrollEvent& e) { waiting.delta += e.delta; });
+    ep.SetQueueLimit<CursorEvent>(2);
+
+    std::vector<int> widths;
+    std::vector<int> deltas;
+    std::vector<int> cursors;
+    es.SubscribeTo<ResizeEvent>(ep, [&widths](const ResizeEvent& e) { widths.push_back(e.width); });
+    es.SubscribeTo<ScrollEvent>(ep, [&deltas](const ScrollEvent& e) { deltas.push_back(e.delta); });
+    es.SubscribeTo<CursorEvent>(ep, [&cursors](const CursorEvent& e) { cursors.push_back(e.x); });
+
+    for (int i = 1; i <= 3; ++i) {
+        ep.Publish(ResizeEvent{.width = i * 100, .height = i * 100});
+        ep.Publish(ScrollEvent{.delta = i});
+        ep.Publish(CursorEvent{.x = i});
+    }
+    ep.Process();
+    EXPECT_EQ(widths, std::vector<int>{300});
+    EXPECT_EQ(deltas, std::vector<int>{6});
+    EXPECT_EQ(cursors, (std::vector<int>{1, 2}));
+    EXPECT_EQ(ep.DroppedEventCount(), 1);
+
+    // Each frame starts afresh
+    ep.Publish(ResizeEvent{.width = 50, .height = 50});
+    ep.Publish(CursorEvent{.x = 4});
+    ep.Process();
+    EXPECT_EQ(widths, (std::vector<int>{300, 50}));
+    EXPECT_EQ(cursors, (std::vector<int>{1, 2, 4}));
+    EXPECT_EQ(ep.DroppedEventCount(), 1);
+}
+
+// Changing how a type is reduced applies to the event already waiting, rather than losing it
+TEST(Event, ChangeReducerWhileQueued) {
+    struct ScrollEvent {
+        int delta;
+    };
+
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+    std::vector<int> deltas;
+    es.SubscribeTo<ScrollEvent>(ep, [&deltas](const ScrollEvent& e) { deltas.push_back(e.delta); });
+
+    ep.SetCoalesce<ScrollEvent>();
+    ep.Publish(ScrollEvent{.delta = 1});
+    ep.SetMerge<ScrollEvent>([](ScrollEvent& waiting, const ScrollEvent& e) { waiting.delta += e.delta; });
+    ep.Publish(ScrollEvent{.delta = 2});
+    ep.Process();
+    EXPECT_EQ(deltas, std::vector<int>{3});
+
+    ep.SetCoalesce<ScrollEvent>();
+    ep.Publish(ScrollEvent{.delta = 4});
+    ep.Publish(ScrollEvent{.delta = 5});
+    ep.Process();
+    EXPECT_EQ(deltas, (std::vector<int>{3, 5}));
+}
+
+TEST(Event, PriorityLanes) {
+    struct UrgentEvent {};
+    struct BackgroundEvent {
+        int index;
+    };
+
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+    ep.SetPriority<UrgentEvent>(Airship::EventPriority::Critical);
+    ep.SetPriority<BackgroundEvent>(Airship::EventPriority::Low);
+
+    std::vector<std::string_view> order;
+    std::vector<int> background;
+    es.SubscribeTo<UrgentEvent>(ep, [&order](const UrgentEvent& /*e*/) { order.emplace_back("critical"); });
+    es.SubscribeTo<TestEvent>(ep, [&order](const TestEvent& /*e*/) { order.emplace_back("normal"); });
+    es.SubscribeTo<BackgroundEvent>(ep, [&](const BackgroundEvent& e) {
+        if (order.empty() || order.back() != "low") order.emplace_back("low");
+        background.push_back(e.index);
+    });
+
+    // Lanes run in priority order, whatever order events were published in
+    ep.Publish(BackgroundEvent{.index = 0});
+    ep.Publish(TestEvent{});
+    ep.Publish(UrgentEvent{});
+    ep.Process();
+    EXPECT_EQ(order, (std::vector<std::string_view>{"critical", "normal", "low"}));
+
+    // With no budget left, low priority events trickle through a few per call, in order, ahead of newer ones
+    constexpr int STORM = 100;
+    background.clear();
+    for (int i = 0; i < STORM; ++i)
+        ep.Publish(BackgroundEvent{.index = i});
+    order.clear();
+    ep.Publish(UrgentEvent{});
+    ep.Process(std::chrono::nanoseconds(0));
+    EXPECT_EQ(order.front(), "critical");
+    EXPECT_EQ(background.size(), Airship::EventQueue::DEADLINE_CHECK_INTERVAL);
+
+    ep.Publish(BackgroundEvent{.index = STORM});
+    while (background.size() <= STORM)
+        ep.Process(std::chrono::nanoseconds(0));
+    for (int i = 0; i <= STORM; ++i)
+        EXPECT_EQ(background[i], i);
+
+    // An unbounded Process catches up on everything
+    for (int i = 0; i < STORM; ++i)
+        ep.Publish(BackgroundEvent{.index = i});
+    ep.Process(std::chrono::nanoseconds(0));
+    ep.Process();
+    EXPECT_EQ(background.size(), 2 * STORM + 1);
+}
+
+TEST(Event, ParallelDispatch) {
+    constexpr int EVENTS = 1000;
+
+    Airship::JobSystem jobs(3);
+    Airship::EventPublisher ep;
+    Airship::EventSubscriber es;
+    ep.SetJobSystem(&jobs);
+
+    const auto mainThread = std::this_thread::get_id();
+    std::atomic<int> workerSum = 0;
+    std::vector<int> mainOrder;
+    bool mainOnMainThread = true;
+    es.SubscribeTo<SequencedEvent>(
+        ep, [&workerSum](const SequencedEvent& e) { workerSum += e.sequence; }, Airship::ThreadAffinity::AnyThread);
+    es.SubscribeTo<SequencedEvent>(ep, [&](const SequencedEvent& e) {
+        mainOnMainThread &= std::this_thread::get_id() == mainThread;
+        mainOrder.push_back(e.sequence);
+    });
+    size_t batchSize = 0;
+    int batchWorkerSum = 0;
+    es.SubscribeBatch<SequencedEvent>(ep, [&](std::span<const SequencedEvent> events) {
+        // Every per-event callback has finished by now
+        batchWorkerSum = workerSum;
+        batchSize = events.size();
+    });
+
+    for (int i = 0; i < EVENTS; ++i)
+        ep.Publish(SequencedEvent{.producer = 0, .sequence = i});
+    ep.Process();
+
+    EXPECT_EQ(workerSum, EVENTS * (EVENTS - 1) / 2);
+    EXPECT_EQ(batchWorkerSum, EVENTS * (EVENTS - 1) / 2);
+    EXPECT_EQ(batchSize, EVENTS);
+    EXPECT_TRUE(mainOnMainThread);
+    ASSERT_EQ(mainOrder.size(), EVENTS);
+    for (int i = 0; i < EVENTS; ++i)
+        EXPECT_EQ(mainOrder[i], i);
+
+    // Exceptions from workers reach the caller once the frame's callbacks are done
+    struct FailingEvent {};
+    const auto failing = es.SubscribeTo<FailingEvent>(
+        ep, [](const FailingEvent& /*e*/) { throw std::runtime_error("failed"); }, Airship::ThreadAffinity::AnyThread);
+    ep.Publish(FailingEvent{});
+    ep.Publish(SequencedEvent{.producer = 0, .sequence = EVENTS});
+    EXPECT_THROW(ep.Process(), std::runtime_error);
+
+    // The failed frame's events are gone, and the publisher carries on as normal
+    es.Unsubscribe(ep, failing);
+    int lateCount = 0;
+    es.SubscribeTo<SequencedEvent>(ep, [&lateCount](const SequencedEvent& /*e*/) { ++lateCount; });
+    workerSum = 0;
+    mainOrder.clear();
+    ep.Publish(SequencedEvent{.producer = 0, .sequence = 1});
+    ep.Publish(SequencedEvent{.producer = 0, .sequence = 2});
+    ep.Process();
+    EXPECT_EQ(workerSum, 3);
+    EXPECT_EQ(batchWorkerSum, 3);
+    EXPECT_EQ(mainOrder, (std::vector<int>{1, 2}));
+    EXPECT_EQ(batchSize, 2);
+    EXPECT_EQ(lateCount, 2);
+}
@@ -0,0 +1,79 @@
+#include "core/frame_arena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(FrameArena, Alignment) {
+    Airship::FrameArena arena(1024);
+    [[maybe_unused]] void* unaligned = arena.Allocate(1, 1);
+    for (const size_t alignment : {1, 2, 8, 16, 64, 256}) {
+        void* p = arena.Allocate(3, alignment);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % alignment, 0) << alignment;
+    }
+    auto* doubles = arena.Allocate<double>(4);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(doubles) % alignof(double), 0);
+}
+
+TEST(FrameArena, Lifetime) {
+    Airship::FrameArena arena(256);
+    auto* first = static_cast<char*>(arena.Allocate(16));
+    std::strcpy(first, "frame 0");
+
+    // Survives FRAME_COUNT - 1 frames, even when they outgrow their blocks
+    for (size_t frame = 1; frame < Airship::FrameArena::FRAME_COUNT; ++frame) {
+        arena.NewFrame();
+        auto* other = static_cast<char*>(arena.Allocate(1000));
+        std::memset(other, 'x', 1000);
+        EXPECT_STREQ(first, "frame 0");
+    }
+
+    // Then the memory comes round again
+    arena.NewFrame();
+    EXPECT_EQ(arena.FrameBytes(), 0);
+    EXPECT_EQ(arena.Allocate(16), first);
+}
+
+TEST(FrameArena, Growth) {
+    Airship::FrameArena arena(256);
+    const auto runFrame = [&arena] {
+        arena.NewFrame();
+        for (int i = 0; i < 100; ++i)
+            std::memset(arena.Allocate(64), i, 64);
+    };
+
+    for (size_t frame = 0; frame < Airship::FrameArena::FRAME_COUNT * 2; ++frame)
+        runFrame();
+    const uint64_t allocations = arena.BlockAllocations();
+    EXPECT_GT(allocations, 0);
+    EXPECT_GE(arena.FrameBytes(), 6400);
+
+    // Every frame's block now fits the workload
+    for (int frame = 0; frame < 100; ++frame)
+        runFrame();
+    EXPECT_EQ(arena.BlockAllocations(), allocations);
+}
+
+TEST(FrameArena, PeakAndResource) {
+    Airship::FrameArena arena;
+    {
+        std::pmr::vector<std::pmr::string> names(arena.Resource());
+        for (int i = 0; i < 50; ++i)
+            names.emplace_back("a name that's too long for the small string buffer " + std::to_string(i));
+        EXPECT_EQ(names[42], "a name that's too long for the small string buffer 42");
+    }
+    const size_t used = arena.FrameBytes();
+    EXPECT_GT(used, 50 * 50);
+
+    arena.NewFrame();
+    [[maybe_unused]] void* small = arena.Allocate(8);
+    EXPECT_EQ(arena.PeakFrameBytes(), used);
+    arena.ResetPeak();
+    arena.NewFrame();
+    EXPECT_EQ(arena.PeakFrameBytes(), 8);
+}
@@ -0,0 +1,158 @@
+#include "core/frame_graph.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/job_system.h"
+#include "gtest/gtest.h"
+
+namespace {
+// Records the order nodes ran in, from any thread
+class RunLog {
+public:
+    void add(const std::string& name) {
+        std::scoped_lock lock(mutex);
+        order.push_back(name);
+    }
+    [[nodiscard]] size_t position(const std::string& name) const {
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (order[i] == name) return i;
+        }
+        return SIZE_MAX;
+    }
+
+    std::mutex mutex;
+    std::vector<std::string> order;
+};
+} // namespace
+
+TEST(FrameGraph, Dependencies) {
+    Airship::JobSystem jobs(3);
+    Airship::FrameGraph graph;
+    RunLog log;
+
+    // Registered out of order on purpose: dependencies come from resources, and registration order only breaks ties
+    graph.AddNode({.name = "physics", .reads = {"input"}, .writes = {"transforms"}}, [&](const auto&) {
+        log.add("physics");
+    });
+    graph.AddNode({.name = "ai", .reads = {"transforms"}, .writes = {"intents"}}, [&](const auto&) { log.add("ai"); });
+    graph.AddNode({.name = "audio", .reads = {"transforms"}}, [&](const auto&) { log.add("audio"); });
+    // Must wait for both readers of the old transforms before overwriting them
+    graph.AddNode({.name = "animation", .writes = {"transforms"}}, [&](const auto&) { log.add("animation"); });
+
+    for (Airship::JobSystem* system : {&jobs, static_cast<Airship::JobSystem*>(nullptr)}) {
+        log.order.clear();
+        graph.Execute(system, {.index = 0, .dt = 0.016f});
+        ASSERT_EQ(log.order.size(), 4);
+        EXPECT_LT(log.position("physics"), log.position("ai"));
+        EXPECT_LT(log.position("physics"), log.position("audio"));
+        EXPECT_LT(log.position("ai"), log.position("animation"));
+        EXPECT_LT(log.position("audio"), log.position("animation"));
+    }
+}
+
+TEST(FrameGraph, ParallelAndMainThread) {
+    Airship::JobSystem jobs(3);
+    Airship::FrameGraph graph;
+
+    const auto mainThread = std::this_thread::get_id();
+    std::atomic<int> running = 0;
+    std::atomic<int> maxRunning = 0;
+    for (const char* name : {"a", "b", "c"}) {
+        graph.AddNode({.name = name, .writes = {name}}, [&](const auto&) {
+            const int now = ++running;
+            int seen = maxRunning;
+            while (now > seen && !maxRunning.compare_exchange_weak(seen, now)) {}
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            --running;
+        });
+    }
+    bool onMainThread = false;
+    graph.AddNode({.name = "submit", .reads = {"a", "b", "c"}, .affinity = Airship::ThreadAffinity::MainThread},
+                  [&](const auto&) { onMainThread = std::this_thread::get_id() == mainThread; });
+
+    graph.Execute(&jobs, {});
+    EXPECT_GT(maxRunning, 1);
+    EXPECT_TRUE(onMainThread);
+}
+
+TEST(FrameGraph, CriticalPath) {
+    Airship::JobSystem jobs(3);
+    Airship::FrameGraph graph;
+
+    const auto sleepNode = [](int ms) {
+        return [ms](const Airship::FrameInfo&) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); };
+    };
+    const auto load = graph.AddNode({.name = "load", .writes = {"level"}}, sleepNode(10));
+    graph.AddNode({.name = "sky", .writes = {"sky"}}, sleepNode(1));
+    const auto navmesh = graph.AddNode({.name = "navmesh", .reads = {"level"}, .writes = {"nav"}}, sleepNode(10));
+    graph.AddNode({.name = "hud", .reads = {"level"}}, sleepNode(1));
+    const auto draw = graph.AddNode({.name = "draw", .reads = {"nav", "sky"}}, sleepNode(1));
+
+    graph.Execute(&jobs, {});
+    EXPECT_EQ(graph.CriticalPath(), (std::vector<Airship::FrameGraph::NodeId>{load, navmesh, draw}));
+    EXPECT_GE(graph.CriticalPathNs(), 21'000'000);
+}
+
+// Render nodes see each frame one Execute late, alongside the next frame's simulation
+TEST(FrameGraph, Pipelined) {
+    Airship::JobSystem jobs(2);
+    Airship::FrameGraph graph;
+    graph.SetPipelined(true);
+
+    std::vector<uint64_t> simulated;
+    std::atomic<uint64_t> simulatedCount = 0;
+    std::vector<uint64_t> rendered;
+    std::atomic<bool> extracting = false;
+    std::atomic<bool> overlapped = false;
+    graph.AddNode({.name = "simulate", .writes = {"world"}}, [&](const Airship::FrameInfo& frame) {
+        simulated.push_back(frame.index);
+        ++simulatedCount;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    });
+    graph.AddNode({.name = "extract", .reads = {"world"}, .writes = {"drawList"}}, [&](const auto&) {
+        extracting = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        extracting = false;
+    });
+    graph.AddNode({.name = "render",
+                   .reads = {"drawList"},
+                   .phase = Airship::FramePhase::Render,
+                   .affinity = Airship::ThreadAffinity::MainThread},
+                  [&](const Airship::FrameInfo& frame) {
+                      rendered.push_back(frame.index);
+                      // The next extract overwrites drawList, so it can't run while we read it
+                      EXPECT_FALSE(extracting);
+                      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                      overlapped = overlapped || simulatedCount == frame.index + 2;
+                  });
+
+    for (uint64_t frame = 0; frame < 3; ++frame) {
+        graph.Execute(&jobs, {.index = frame, .dt = 0.016f});
+        EXPECT_EQ(simulated.back(), frame);
+    }
+    EXPECT_EQ(rendered, (std::vector<uint64_t>{0, 1}));
+    graph.Flush(&jobs);
+    EXPECT_EQ(rendered, (std::vector<uint64_t>{0, 1, 2}));
+    EXPECT_TRUE(overlapped);
+}
+
+TEST(FrameGraph, Exceptions) {
+    Airship::JobSystem jobs(2);
+    Airship::FrameGraph graph;
+
+    bool downstreamRan = false;
+    graph.AddNode({.name = "fails", .writes = {"x"}}, [](const auto&) { throw std::runtime_error("node failed"); });
+    graph.AddNode({.name = "downstream", .reads = {"x"}}, [&](const auto&) { downstreamRan = true; });
+
+    // The frame still completes, then the error surfaces
+    EXPECT_THROW(graph.Execute(&jobs, {}), std::runtime_error);
+    EXPECT_TRUE(downstreamRan);
+    EXPECT_THROW(graph.Execute(nullptr, {}), std::runtime_error);
+}
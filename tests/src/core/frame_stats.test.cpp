@@ -0,0 +1,58 @@
+#include "core/frame_stats.h"
+
+#include <cstdint>
+
+#include "gtest/gtest.h"
+
+TEST(FrameStats, Empty) {
+    const Airship::DurationHistogram histogram;
+    EXPECT_EQ(histogram.count(), 0);
+    EXPECT_EQ(histogram.min(), 0);
+    EXPECT_EQ(histogram.max(), 0);
+    EXPECT_EQ(histogram.mean(), 0);
+    EXPECT_EQ(histogram.percentile(0.5), 0);
+}
+
+TEST(FrameStats, SmallValuesAreExact) {
+    Airship::DurationHistogram histogram;
+    for (uint64_t i = 0; i < Airship::DurationHistogram::SUB_BUCKET_COUNT; ++i)
+        histogram.record(i);
+
+    EXPECT_EQ(histogram.count(), Airship::DurationHistogram::SUB_BUCKET_COUNT);
+    EXPECT_EQ(histogram.percentile(0), 0);
+    EXPECT_EQ(histogram.percentile(0.5), 15);
+    EXPECT_EQ(histogram.percentile(1), 31);
+}
+
+TEST(FrameStats, Percentiles) {
+    // 1ms to 10ms in 1µs steps, plus one 100ms hitch
+    Airship::DurationHistogram histogram;
+    for (uint64_t us = 1000; us < 10000; ++us)
+        histogram.record(us * 1000);
+    histogram.record(100'000'000);
+
+    EXPECT_EQ(histogram.count(), 9001);
+    EXPECT_EQ(histogram.min(), 1'000'000);
+    EXPECT_EQ(histogram.max(), 100'000'000);
+
+    // Values are bucketed, so allow for the histogram's relative error
+    const auto expectNear = [](uint64_t actual, double expected) {
+        EXPECT_NEAR(double(actual), expected, expected * 0.035);
+    };
+    expectNear(histogram.percentile(0.5), 5'500'000);
+    expectNear(histogram.percentile(0.99), 9'910'000);
+    EXPECT_EQ(histogram.percentile(1), 100'000'000);
+
+    histogram.reset();
+    EXPECT_EQ(histogram.count(), 0);
+    EXPECT_EQ(histogram.percentile(0.99), 0);
+}
+
+TEST(FrameStats, LargeValues) {
+    Airship::DurationHistogram histogram;
+    histogram.record(UINT64_MAX);
+    histogram.record(uint64_t(1) << 40);
+    EXPECT_EQ(histogram.min(), uint64_t(1) << 40);
+    EXPECT_NEAR(double(histogram.percentile(0)), double(uint64_t(1) << 40), double(uint64_t(1) << 40) * 0.035);
+    EXPECT_EQ(histogram.percentile(1), UINT64_MAX);
+}
@@ -0,0 +1,300 @@
+#include "core/instrumentation.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <memory_resource>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "core/trace_format.h"
+#include "gtest/gtest.h"
+
+namespace {
+using Airship::Profiling::MemoryTag;
+using Airship::Profiling::OverflowPolicy;
+
+constexpr size_t RING_CAPACITY = 8;
+constexpr size_t DEFAULT_CAPACITY = size_t(1) << 16;
+// Names have to outlive the trace, like a scope's
+constexpr const char* SCOPE_NAMES[] = {"ring0", "ring1", "ring2", "ring3", "ring4"};
+
+std::string TracePath() {
+    return (std::filesystem::temp_directory_path() / "airship_instrumentation_test.json").string();
+}
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// Drains every buffer and returns what was in them
+std::string DumpTrace() {
+    const std::string path = TracePath();
+    Airship::Profiling::dump(path);
+    return ReadFile(path);
+}
+
+// Every line between the brackets is one whole event, so the file is valid JSON whichever line it's cut off after
+bool IsTraceArray(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line) || line != "[") return false;
+    while (std::getline(in, line)) {
+        if (line == "{}]") return !std::getline(in, line);
+        if (!line.starts_with(R"({"name":")") || !line.ends_with("},")) return false;
+    }
+    return false;
+}
+
+bool HasScope(const std::string& trace, const char* name) {
+    return trace.find(std::string(R"("name":")") + name + "\"") != std::string::npos;
+}
+
+// Five scopes, ten events, from a thread whose buffer only holds eight of them
+void RecordPastCapacity(OverflowPolicy policy) {
+    Airship::Profiling::setBufferCapacity(RING_CAPACITY);
+    Airship::Profiling::setOverflowPolicy(policy);
+    std::thread([] {
+        for (const char* name : SCOPE_NAMES) {
+            const Airship::Profiling::ScopeTimer timer(name);
+        }
+    }).join();
+    Airship::Profiling::setBufferCapacity(DEFAULT_CAPACITY);
+    Airship::Profiling::setOverflowPolicy(OverflowPolicy::OverwriteOldest);
+}
+
+Airship::Profiling::MemoryCounters TagCounters(MemoryTag tag) {
+    return Airship::Profiling::memoryStats().tags[static_cast<size_t>(tag)];
+}
+} // namespace
+
+TEST(Instrumentation, DropNewest) {
+    if (!Airship::Profiling::instrumentationEnabled()) GTEST_SKIP() << "Built without AIRSHIP_INSTRUMENTATION";
+    DumpTrace();
+    const uint64_t droppedBefore = Airship::Profiling::droppedEventCount();
+
+    RecordPastCapacity(OverflowPolicy::DropNewest);
+    EXPECT_EQ(Airship::Profiling::droppedEventCount() - droppedBefore, 2);
+
+    const std::string trace = DumpTrace();
+    EXPECT_TRUE(HasScope(trace, "ring0"));
+    EXPECT_TRUE(HasScope(trace, "ring3"));
+    EXPECT_FALSE(HasScope(trace, "ring4"));
+    // The thread has exited, so that drain freed its buffer. Its drops still count.
+    EXPECT_EQ(Airship::Profiling::droppedEventCount() - droppedBefore, 2);
+    EXPECT_FALSE(HasScope(DumpTrace(), "ring0"));
+}
+
+TEST(Instrumentation, OverwriteOldest) {
+    if (!Airship::Profiling::instrumentationEnabled()) GTEST_SKIP() << "Built without AIRSHIP_INSTRUMENTATION";
+    DumpTrace();
+    const uint64_t droppedBefore = Airship::Profiling::droppedEventCount();
+
+    // Overwritten events are only counted once the drain notices it was lapped. The oldest survivor goes too: its slot
+    // is the next one the writer overwrites, so the drain can't tell it from a torn read.
+    RecordPastCapacity(OverflowPolicy::OverwriteOldest);
+    const std::string trace = DumpTrace();
+    EXPECT_EQ(Airship::Profiling::droppedEventCount() - droppedBefore, 3);
+    EXPECT_FALSE(HasScope(trace, "ring0"));
+    EXPECT_TRUE(HasScope(trace, "ring2"));
+    EXPECT_TRUE(HasScope(trace, "ring4"));
+}
+
+TEST(Instrumentation, DrainWhileLapped) {
+    if (!Airship::Profiling::instrumentationEnabled()) GTEST_SKIP() << "Built without AIRSHIP_INSTRUMENTATION";
+    DumpTrace();
+    const uint64_t droppedBefore = Airship::Profiling::droppedEventCount();
+
+    // The writer laps a tiny buffer over and over while it's drained, so some copies race with overwrites of the same
+    // slot. Those have to be discarded, leaving only whole events in the trace.
+    Airship::Profiling::setBufferCapacity(RING_CAPACITY);
+    std::atomic<bool> done = false;
+    std::thread writer([&done] {
+        while (!done.load(std::memory_order_relaxed)) {
+            const Airship::Profiling::ScopeTimer timer("lapped");
+        }
+    });
+
+    // Thread names from earlier tests come along as metadata, which isn't read from the buffers
+    constexpr std::string_view METADATA_FIELD = R"("ph":"M")";
+    constexpr std::string_view LAPPED_FIELD = R"({"name":"lapped")";
+    int events = 0;
+    int torn = 0;
+    for (int i = 0; i < 200; ++i) {
+        std::istringstream trace(DumpTrace());
+        std::string line;
+        while (std::getline(trace, line)) {
+            if (!line.starts_with(R"({"name":)") || line.find(METADATA_FIELD) != std::string::npos) continue;
+            ++events;
+            if (!line.starts_with(LAPPED_FIELD)) ++torn;
+        }
+    }
+    done = true;
+    writer.join();
+    Airship::Profiling::setBufferCapacity(DEFAULT_CAPACITY);
+    DumpTrace();
+    EXPECT_GT(events, 0);
+    EXPECT_EQ(torn, 0);
+    EXPECT_GT(Airship::Profiling::droppedEventCount(), droppedBefore);
+}
+
+TEST(Instrumentation, StreamRotation) {
+    if (!Airship::Profiling::instrumentationEnabled()) GTEST_SKIP() << "Built without AIRSHIP_INSTRUMENTATION";
+    DumpTrace();
+
+    std::thread([] { Airship::Profiling::setThreadName("Streamed thread"); }).join();
+
+    const std::string basePath = (std::filesystem::temp_directory_path() / "airship_stream_test").string();
+    // A few events per file, so the one flush on stopping has to rotate partway through
+    ASSERT_TRUE(Airship::Profiling::startStreaming(
+        {.basePath = basePath, .flushInterval = std::chrono::hours(1), .maxFileBytes = 512, .maxFiles = 0}));
+    for (int i = 0; i < 20; ++i) {
+        const Airship::Profiling::ScopeTimer timer("streamed");
+    }
+    Airship::Profiling::stopStreaming();
+
+    // Both files stand alone, thread names included
+    for (const std::string& path : {basePath + ".0.json", basePath + ".1.json"}) {
+        EXPECT_TRUE(IsTraceArray(path)) << path;
+        EXPECT_NE(ReadFile(path).find(R"("args":{"name":"Streamed thread"})"), std::string::npos) << path;
+    }
+    for (uint32_t i = 0; std::filesystem::remove(basePath + "." + std::to_string(i) + ".json"); ++i) {}
+}
+
+TEST(MemoryTracking, TagScopes) {
+    EXPECT_EQ(Airship::Profiling::currentMemoryTag(), MemoryTag::Untagged);
+    {
+        MEMORY_TAG_SCOPE(Game);
+        EXPECT_EQ(Airship::Profiling::currentMemoryTag(), MemoryTag::Game);
+        {
+            MEMORY_TAG_SCOPE(Renderer);
+            EXPECT_EQ(Airship::Profiling::currentMemoryTag(), MemoryTag::Renderer);
+        }
+        EXPECT_EQ(Airship::Profiling::currentMemoryTag(), MemoryTag::Game);
+    }
+    EXPECT_EQ(Airship::Profiling::currentMemoryTag(), MemoryTag::Untagged);
+    EXPECT_EQ(Airship::Profiling::memoryTagName(MemoryTag::Events), "events");
+}
+
+TEST(MemoryTracking, ManualTracking) {
+    const auto before = TagCounters(MemoryTag::Game);
+    Airship::Profiling::trackAllocation(MemoryTag::Game, 100);
+    Airship::Profiling::trackAllocation(MemoryTag::Game, 28);
+    auto during = TagCounters(MemoryTag::Game);
+    EXPECT_EQ(during.liveBytes - before.liveBytes, 128);
+    EXPECT_EQ(during.liveAllocations - before.liveAllocations, 2);
+    EXPECT_EQ(during.totalAllocations - before.totalAllocations, 2);
+
+    Airship::Profiling::trackDeallocation(MemoryTag::Game, 100);
+    Airship::Profiling::trackDeallocation(MemoryTag::Game, 28);
+    const auto after = TagCounters(MemoryTag::Game);
+    EXPECT_EQ(after.liveBytes, before.liveBytes);
+    EXPECT_EQ(after.liveAllocations, before.liveAllocations);
+    EXPECT_EQ(after.totalBytes - before.totalBytes, 128);
+
+    const uint64_t gpuBefore = Airship::Profiling::memoryStats().gpu.liveBytes;
+    Airship::Profiling::trackGpuAllocation(4096);
+    EXPECT_EQ(Airship::Profiling::memoryStats().gpu.liveBytes, gpuBefore + 4096);
+    Airship::Profiling::trackGpuDeallocation(4096);
+    EXPECT_EQ(Airship::Profiling::memoryStats().gpu.liveBytes, gpuBefore);
+}
+
+TEST(MemoryTracking, TaggedResource) {
+    // Counted once whether or not the hooks are on
+    Airship::Profiling::TaggedResource resource(MemoryTag::Events);
+    const auto before = TagCounters(MemoryTag::Events);
+    void* ptr = resource.allocate(1000);
+    EXPECT_EQ(TagCounters(MemoryTag::Events).liveBytes - before.liveBytes, 1000);
+    resource.deallocate(ptr, 1000);
+    EXPECT_EQ(TagCounters(MemoryTag::Events).liveBytes, before.liveBytes);
+
+    std::pmr::vector<int> values(&resource);
+    values.resize(256);
+    EXPECT_GE(TagCounters(MemoryTag::Events).liveBytes - before.liveBytes, 256 * sizeof(int));
+}
+
+TEST(MemoryTracking, FrameAllocations) {
+    Airship::Profiling::markMemoryFrame();
+    for (int i = 0; i < 3; ++i)
+        Airship::Profiling::trackAllocation(MemoryTag::Game, 10);
+    Airship::Profiling::markMemoryFrame();
+    const auto stats = Airship::Profiling::memoryStats();
+    EXPECT_GE(stats.frameAllocations, 3);
+    EXPECT_GE(stats.frameBytes, 30);
+    for (int i = 0; i < 3; ++i)
+        Airship::Profiling::trackDeallocation(MemoryTag::Game, 10);
+}
+
+TEST(MemoryTracking, Hooks) {
+    if (!Airship::Profiling::memoryHooksEnabled()) GTEST_SKIP() << "Built without AIRSHIP_MEMORY_HOOKS";
+
+    const auto before = TagCounters(MemoryTag::Game);
+    std::unique_ptr<std::byte[]> bytes;
+    {
+        MEMORY_TAG_SCOPE(Game);
+        bytes = std::make_unique_for_overwrite<std::byte[]>(12345);
+    }
+    EXPECT_EQ(TagCounters(MemoryTag::Game).liveBytes - before.liveBytes, 12345);
+    // Freed under another tag, but uncounted from the one it was allocated under
+    bytes.reset();
+    EXPECT_EQ(TagCounters(MemoryTag::Game).liveBytes, before.liveBytes);
+
+    struct alignas(256) Aligned {
+        std::byte data[100];
+    };
+    auto aligned = std::make_unique<Aligned>();
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned.get()) % 256, 0);
+}
+
+TEST(TraceFormat, JsonCounter) {
+    std::ostringstream out;
+    Airship::Profiling::writeJsonEvent(out, "heap bytes", Airship::Profiling::TraceEventType::counter, 1'500'250, 3,
+                                       -42);
+    EXPECT_EQ(out.str(), R"({"name":"heap bytes","ph":"C","ts":1500.250,"pid":0,"tid":3,"args":{"value":-42}},)"
+                         "\n");
+}
+
+TEST(TraceFormat, JsonEscaping) {
+    std::ostringstream out;
+    Airship::Profiling::writeJsonEvent(out, "say \"hi\" C:\\\n", Airship::Profiling::TraceEventType::threadName, 0, 1);
+    EXPECT_EQ(out.str(), R"({"name":"thread_name","ph":"M","pid":0,"tid":1,"args":{"name":"say \"hi\" C:\\\u000a"}},)"
+                         "\n");
+}
+
+TEST(TraceFormat, BinaryRoundTrip) {
+    using Airship::Profiling::TraceEventType;
+    std::stringstream stream;
+    {
+        Airship::Profiling::BinaryTraceWriter writer(stream, 1);
+        writer.write("frame", TraceEventType::start, 1000, 0);
+        writer.write("allocations", TraceEventType::counter, 1500, 0, 1234567);
+        writer.write("allocations", TraceEventType::counter, 1600, 0, -5);
+        writer.write("frame", TraceEventType::end, 2000, 0);
+    }
+
+    Airship::Profiling::BinaryTraceReader reader(stream);
+    ASSERT_TRUE(reader.ok());
+    std::vector<Airship::Profiling::BinaryTraceReader::Event> events;
+    Airship::Profiling::BinaryTraceReader::Event event{};
+    while (reader.next(event))
+        events.push_back(event);
+    EXPECT_TRUE(reader.ok());
+    ASSERT_EQ(events.size(), 4);
+    EXPECT_EQ(events[1].name, "allocations");
+    EXPECT_EQ(events[1].type, TraceEventType::counter);
+    EXPECT_EQ(events[1].timestamp, 1500);
+    EXPECT_EQ(events[1].value, 1234567);
+    EXPECT_EQ(events[2].value, -5);
+    EXPECT_EQ(events[3].type, TraceEventType::end);
+    EXPECT_EQ(events[3].timestamp, 2000);
+}
@@ -0,0 +1,151 @@
+#include "core/job_system.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(JobSystem, RunAndWait) {
+    Airship::JobSystem jobs(3);
+    EXPECT_EQ(jobs.WorkerCount(), 3);
+
+    constexpr int JOBS = 1000;
+    std::atomic<int> ran = 0;
+    Airship::JobCounter counter;
+    for (int i = 0; i < JOBS; ++i)
+        jobs.Run([&ran] { ++ran; }, &counter);
+    jobs.Wait(counter);
+    EXPECT_TRUE(counter.IsDone());
+    EXPECT_EQ(ran, JOBS);
+
+    // Counters are reusable, and jobs may schedule and wait on more jobs
+    jobs.Run(
+        [&] {
+            Airship::JobCounter inner;
+            for (int i = 0; i < JOBS; ++i)
+                jobs.Run([&ran] { ++ran; }, &inner);
+            jobs.Wait(inner);
+        },
+        &counter);
+    jobs.Wait(counter);
+    EXPECT_EQ(ran, 2 * JOBS);
+}
+
+// Nothing touches a counter once it's done, so it can go away as soon as Wait() returns or IsDone() says so
+TEST(JobSystem, DestroyCounterWhenDone) {
+    Airship::JobSystem jobs(3);
+    std::atomic<int> ran = 0;
+    for (int i = 0; i < 2000; ++i) {
+        auto counter = std::make_unique<Airship::JobCounter>();
+        auto dependent = std::make_unique<Airship::JobCounter>();
+        for (int j = 0; j < 4; ++j)
+            jobs.Run([&ran] { ++ran; }, counter.get());
+        jobs.Run([&ran] { ++ran; }, dependent.get(), counter.get());
+        if (i % 2 == 0) {
+            jobs.Wait(*dependent);
+        } else {
+            while (!dependent->IsDone())
+                std::this_thread::yield();
+        }
+        dependent.reset();
+        // The dependent job only starts once counter is done
+        EXPECT_TRUE(counter->IsDone());
+        counter.reset();
+    }
+    EXPECT_EQ(ran, 2000 * 5);
+}
+
+TEST(JobSystem, Dependencies) {
+    Airship::JobSystem jobs(2);
+
+    std::atomic<int> producersDone = 0;
+    std::atomic<int> seenByConsumer = -1;
+    Airship::JobCounter producers;
+    Airship::JobCounter consumer;
+    for (int i = 0; i < 8; ++i) {
+        jobs.Run(
+            [&producersDone] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                ++producersDone;
+            },
+            &producers);
+    }
+    // Held back until every producer has finished
+    jobs.Run([&] { seenByConsumer = producersDone.load(); }, &consumer, &producers);
+    jobs.Wait(consumer);
+    EXPECT_EQ(seenByConsumer, 8);
+
+    // A dependency that is already done doesn't hold anything back
+    jobs.Run([&] { seenByConsumer = 0; }, &consumer, &producers);
+    jobs.Wait(consumer);
+    EXPECT_EQ(seenByConsumer, 0);
+}
+
+TEST(JobSystem, ParallelFor) {
+    Airship::JobSystem jobs(3);
+
+    constexpr size_t COUNT = 100000;
+    std::vector<int> visits(COUNT, 0);
+    jobs.ParallelFor(0, COUNT, [&visits](size_t i) { ++visits[i]; });
+    for (size_t i = 0; i < COUNT; ++i)
+        ASSERT_EQ(visits[i], 1) << i;
+
+    // Explicit grains, including ones that don't divide the range, and empty ranges
+    std::atomic<size_t> sum = 0;
+    jobs.ParallelFor(10, 1010, [&sum](size_t i) { sum += i; }, 7);
+    EXPECT_EQ(sum, (10 + 1009) * 1000 / 2);
+    jobs.ParallelFor(5, 5, [](size_t /*i*/) { FAIL(); });
+}
+
+TEST(JobSystem, Exceptions) {
+    Airship::JobSystem jobs(2);
+
+    Airship::JobCounter counter;
+    std::atomic<int> ran = 0;
+    jobs.Run([] { throw std::runtime_error("job failed"); }, &counter);
+    for (int i = 0; i < 10; ++i)
+        jobs.Run([&ran] { ++ran; }, &counter);
+    EXPECT_THROW(jobs.Wait(counter), std::runtime_error);
+    EXPECT_EQ(ran, 10);
+
+    // Every chunk finishes before the exception reaches the caller
+    std::atomic<size_t> visited = 0;
+    const auto visit = [&visited](size_t i) {
+        ++visited;
+        if (i == 599) throw std::runtime_error("chunk failed"); // Last index of its chunk
+    };
+    EXPECT_THROW(jobs.ParallelFor(0, 1000, visit, 100), std::runtime_error);
+    EXPECT_EQ(visited, 1000);
+}
+
+// Threads outside the system can schedule and wait too
+TEST(JobSystem, ForeignThreads) {
+    Airship::JobSystem jobs(2);
+
+    std::atomic<int> ran = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            Airship::JobCounter counter;
+            for (int i = 0; i < 100; ++i)
+                jobs.Run([&ran] { ++ran; }, &counter);
+            jobs.Wait(counter);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    EXPECT_EQ(ran, 400);
+
+    // Jobs left unwaited still run before the system goes away
+    {
+        Airship::JobSystem scoped(1);
+        for (int i = 0; i < 100; ++i)
+            scoped.Run([&ran] { ++ran; });
+    }
+    EXPECT_EQ(ran, 500);
+}
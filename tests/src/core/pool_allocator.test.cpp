@@ -0,0 +1,163 @@
+#include "core/pool_allocator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+Airship::PoolAllocator& Pool() {
+    return Airship::PoolAllocator::Get();
+}
+
+struct Base {
+    virtual ~Base() = default;
+    virtual int Value() const = 0;
+};
+
+struct Derived : Base {
+    explicit Derived(int& destroyed) : destroyed(destroyed) {}
+    ~Derived() override { ++destroyed; }
+    int Value() const override { return 42; }
+
+    int& destroyed;
+    std::byte padding[200]{};
+};
+} // namespace
+
+TEST(PoolAllocator, SizeClasses) {
+    for (const size_t bytes : {1, 8, 16, 17, 100, 250, 512}) {
+        void* p = Pool().Allocate(bytes);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % alignof(std::max_align_t), 0) << bytes;
+        std::memset(p, 0xab, bytes);
+        Pool().Deallocate(p, bytes);
+    }
+
+    // Sizes in the same class share objects
+    void* a = Pool().Allocate(40);
+    Pool().Deallocate(a, 40);
+    void* b = Pool().Allocate(48);
+    EXPECT_EQ(a, b);
+    Pool().Deallocate(b, 48);
+}
+
+TEST(PoolAllocator, Reuse) {
+    // Freed objects are handed straight back out by the same thread
+    void* first = Pool().Allocate(64);
+    Pool().Deallocate(first, 64);
+    void* second = Pool().Allocate(64);
+    EXPECT_EQ(first, second);
+    Pool().Deallocate(second, 64);
+}
+
+TEST(PoolAllocator, LargeAllocations) {
+    const uint64_t before = Pool().GetStats().largeAllocations;
+    void* large = Pool().Allocate(Airship::PoolAllocator::MAX_POOLED_SIZE + 1);
+    EXPECT_EQ(Pool().GetStats().largeAllocations, before + 1);
+    Pool().Deallocate(large, Airship::PoolAllocator::MAX_POOLED_SIZE + 1);
+    EXPECT_EQ(Pool().GetStats().largeAllocations, before);
+}
+
+TEST(PoolAllocator, Stats) {
+    static constexpr size_t BYTES = 320;
+    constexpr size_t PER_SLAB = Airship::PoolAllocator::SLAB_BYTES / BYTES;
+    const auto classStats = [] {
+        const auto stats = Pool().GetStats();
+        return *std::ranges::find(stats.sizeClasses, BYTES, &Airship::PoolAllocator::SizeClassStats::objectSize);
+    };
+    const auto before = classStats();
+
+    // Enough to need at least one more slab
+    std::vector<void*> objects;
+    for (size_t i = 0; i < PER_SLAB + 1; ++i)
+        objects.push_back(Pool().Allocate(BYTES));
+    const auto during = classStats();
+    EXPECT_GT(during.slabs, before.slabs);
+    EXPECT_EQ(during.capacity, during.slabs * PER_SLAB);
+    EXPECT_GE(Pool().GetStats().reservedBytes, during.slabs * Airship::PoolAllocator::SLAB_BYTES);
+
+    // Slabs are kept, and the objects go back to the shared list past what one thread caches
+    for (void* object : objects)
+        Pool().Deallocate(object, BYTES);
+    const auto after = classStats();
+    EXPECT_EQ(after.slabs, during.slabs);
+    EXPECT_GT(after.sharedFree, during.sharedFree);
+    EXPECT_LE(after.sharedFree, after.capacity);
+}
+
+TEST(PoolAllocator, CrossThread) {
+    constexpr size_t THREADS = 4;
+    constexpr size_t OBJECTS = 10000;
+
+    // Producers allocate, the main thread frees, so every object crosses threads
+    std::vector<std::vector<uint64_t*>> produced(THREADS);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&objects = produced[t], t] {
+            for (size_t i = 0; i < OBJECTS; ++i)
+                objects.push_back(Pool().New<uint64_t>((t * OBJECTS) + i));
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    std::vector<uint64_t*> all;
+    for (size_t t = 0; t < THREADS; ++t) {
+        for (size_t i = 0; i < OBJECTS; ++i)
+            EXPECT_EQ(*produced[t][i], (t * OBJECTS) + i);
+        all.insert(all.end(), produced[t].begin(), produced[t].end());
+    }
+    std::ranges::sort(all);
+    EXPECT_EQ(std::ranges::adjacent_find(all), all.end());
+    for (uint64_t* object : all)
+        Pool().Delete(object);
+
+    // And all at once, allocating and freeing on every thread
+    threads.clear();
+    for (size_t t = 0; t < THREADS; ++t) {
+        threads.emplace_back([] {
+            std::vector<Airship::PoolPtr<std::string>> strings;
+            for (size_t i = 0; i < OBJECTS; ++i) {
+                strings.push_back(Airship::MakePooled<std::string>(std::to_string(i)));
+                if (i % 3 == 0) strings.erase(strings.begin() + static_cast<ptrdiff_t>(strings.size() / 2));
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+TEST(PoolAllocator, PoolPtr) {
+    int destroyed = 0;
+    {
+        Airship::PoolPtr<Base> base = Airship::MakePooled<Derived>(destroyed);
+        EXPECT_EQ(base->Value(), 42);
+        EXPECT_EQ(base.get_deleter().bytes, sizeof(Derived));
+    }
+    EXPECT_EQ(destroyed, 1);
+}
+
+TEST(PoolAllocator, MemoryResource) {
+    std::pmr::vector<int> values(Pool().Resource());
+    std::pmr::list<std::pmr::string> strings(Pool().Resource());
+    for (int i = 0; i < 1000; ++i) {
+        values.push_back(i);
+        strings.emplace_back("a string long enough to need its own allocation");
+    }
+    EXPECT_EQ(values.back(), 999);
+    EXPECT_EQ(strings.size(), 1000);
+
+    // Over-aligned requests still work
+    struct alignas(64) Aligned {
+        float values[16];
+    };
+    std::pmr::vector<Aligned> aligned(10, Pool().Resource());
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned.data()) % 64, 0);
+}
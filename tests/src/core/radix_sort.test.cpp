@@ -0,0 +1,74 @@
+#include "core/radix_sort.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+struct Item {
+    uint64_t key = 0;
+    uint32_t index = 0;
+    bool operator==(const Item&) const = default;
+};
+
+std::vector<Item> Sorted(std::vector<Item> items) {
+    std::ranges::stable_sort(items, {}, &Item::key);
+    return items;
+}
+} // namespace
+
+TEST(RadixSort, MatchesStableSort) {
+    std::mt19937_64 rng(1234);
+    std::vector<Item> items;
+    for (uint32_t i = 0; i < 5000; ++i)
+        items.push_back({.key = rng(), .index = i});
+    const std::vector<Item> expected = Sorted(items);
+
+    std::vector<Item> scratch;
+    Airship::Utils::radixSortByKey(items, scratch);
+    EXPECT_EQ(items, expected);
+}
+
+TEST(RadixSort, Stable) {
+    // Few distinct keys, spread over the high and low bytes, so most bytes are skipped and ties are everywhere
+    std::mt19937 rng(99);
+    std::vector<Item> items;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        const uint64_t layer = rng() % 3;
+        const uint64_t low = rng() % 4;
+        items.push_back({.key = (layer << 56) | low, .index = i});
+    }
+    const std::vector<Item> expected = Sorted(items);
+
+    std::vector<Item> scratch;
+    Airship::Utils::radixSortByKey(items, scratch);
+    EXPECT_EQ(items, expected);
+}
+
+TEST(RadixSort, SmallAndUniform) {
+    std::vector<Item> scratch;
+    std::vector<Item> empty;
+    Airship::Utils::radixSortByKey(empty, scratch);
+    EXPECT_TRUE(empty.empty());
+
+    std::vector<Item> one = {{.key = 7, .index = 0}};
+    Airship::Utils::radixSortByKey(one, scratch);
+    EXPECT_EQ(one.front().key, 7);
+
+    // Every pass skipped, so nothing moves
+    std::vector<Item> same(100, {.key = 0x0102030405060708, .index = 0});
+    for (uint32_t i = 0; i < same.size(); ++i)
+        same[i].index = i;
+    const std::vector<Item> expected = same;
+    Airship::Utils::radixSortByKey(same, scratch);
+    EXPECT_EQ(same, expected);
+
+    // An odd number of passes leaves the result in scratch, which has to end up back in items
+    std::vector<Item> odd = {{.key = 3, .index = 0}, {.key = 1, .index = 1}, {.key = 2, .index = 2}};
+    Airship::Utils::radixSortByKey(odd, scratch);
+    EXPECT_EQ(odd, Sorted({{.key = 3, .index = 0}, {.key = 1, .index = 1}, {.key = 2, .index = 2}}));
+}
@@ -0,0 +1,196 @@
+#include "core/task.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/job_system.h"
+#include "gtest/gtest.h"
+
+namespace {
+Airship::Task<int> Add(Airship::TaskScheduler& tasks, int a, int b) {
+    co_await tasks.NextFrame();
+    co_return a + b;
+}
+
+Airship::Task<int> Fail(Airship::TaskScheduler& tasks) {
+    co_await tasks.NextFrame();
+    throw std::runtime_error("task failed");
+}
+} // namespace
+
+TEST(Task, FramesAndDelays) {
+    Airship::TaskScheduler tasks;
+    std::vector<std::string> log;
+    tasks.Spawn([](Airship::TaskScheduler& tasks, std::vector<std::string>& log) -> Airship::Task<> {
+        log.emplace_back("start");
+        const float dt = co_await tasks.NextFrame();
+        log.push_back("frame " + std::to_string(dt));
+        co_await tasks.Delay(0.25f);
+        log.emplace_back("delayed");
+        co_await tasks.Delay(0.0f); // Doesn't suspend
+        log.emplace_back("done");
+    }(tasks, log));
+    EXPECT_TRUE(log.empty()); // Tasks are lazy
+
+    tasks.Update(0.1f);
+    EXPECT_EQ(log, (std::vector<std::string>{"start"}));
+    tasks.Update(0.5f);
+    EXPECT_EQ(log, (std::vector<std::string>{"start", "frame 0.500000"}));
+    tasks.Update(0.1f);
+    tasks.Update(0.1f);
+    EXPECT_EQ(log.size(), 2);
+    EXPECT_EQ(tasks.TaskCount(), 1);
+    tasks.Update(0.1f);
+    EXPECT_EQ(log, (std::vector<std::string>{"start", "frame 0.500000", "delayed", "done"}));
+    EXPECT_EQ(tasks.TaskCount(), 0);
+}
+
+TEST(Task, Nesting) {
+    Airship::TaskScheduler tasks;
+    int sum = 0;
+    bool caught = false;
+    tasks.Spawn([](Airship::TaskScheduler& tasks, int& sum, bool& caught) -> Airship::Task<> {
+        sum = co_await Add(tasks, 1, 2);
+        sum += co_await Add(tasks, sum, 4);
+        try {
+            co_await Fail(tasks);
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+    }(tasks, sum, caught));
+
+    for (int frame = 0; frame < 4; ++frame)
+        tasks.Update(0.016f);
+    EXPECT_EQ(sum, 10);
+    EXPECT_TRUE(caught);
+    EXPECT_EQ(tasks.TaskCount(), 0);
+
+    // Uncaught, it surfaces from Update
+    tasks.Spawn([](Airship::TaskScheduler& tasks) -> Airship::Task<> { co_await Fail(tasks); }(tasks));
+    tasks.Update(0.016f);
+    EXPECT_THROW(tasks.Update(0.016f), std::runtime_error);
+    EXPECT_EQ(tasks.TaskCount(), 0);
+}
+
+TEST(Task, Jobs) {
+    Airship::JobSystem jobs(2);
+    Airship::TaskScheduler tasks(&jobs);
+
+    const auto mainThread = std::this_thread::get_id();
+    std::atomic<bool> onWorker = false;
+    std::optional<int> result;
+    bool resumedOnMain = false;
+    bool caught = false;
+    tasks.Spawn([](Airship::TaskScheduler& tasks, std::thread::id mainThread, std::atomic<bool>& onWorker,
+                   std::optional<int>& result, bool& resumedOnMain, bool& caught) -> Airship::Task<> {
+        result = co_await tasks.RunJob([&] {
+            onWorker = std::this_thread::get_id() != mainThread;
+            return 42;
+        });
+        resumedOnMain = std::this_thread::get_id() == mainThread;
+        try {
+            co_await tasks.RunJob([] { throw std::runtime_error("job failed"); });
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+    }(tasks, mainThread, onWorker, result, resumedOnMain, caught));
+
+    for (int frame = 0; frame < 1000 && tasks.TaskCount() > 0; ++frame) {
+        tasks.Update(0.016f);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(result, 42);
+    EXPECT_TRUE(onWorker);
+    EXPECT_TRUE(resumedOnMain);
+    EXPECT_TRUE(caught);
+
+    // Jobs started elsewhere
+    Airship::JobCounter counter;
+    std::atomic<bool> gate = false;
+    jobs.Run(
+        [&gate] {
+            while (!gate)
+                std::this_thread::yield();
+        },
+        &counter);
+    bool finished = false;
+    tasks.Spawn([](Airship::TaskScheduler& tasks, Airship::JobCounter& counter, bool& finished) -> Airship::Task<> {
+        co_await tasks.WaitFor(counter);
+        finished = true;
+    }(tasks, counter, finished));
+    tasks.Update(0.016f);
+    tasks.Update(0.016f);
+    EXPECT_FALSE(finished);
+    gate = true;
+    jobs.Wait(counter);
+    tasks.Update(0.016f);
+    EXPECT_TRUE(finished);
+}
+
+TEST(Task, ReadFile) {
+    const auto path = std::filesystem::temp_directory_path() / "airship_task_test.txt";
+    std::ofstream(path) << "level data";
+
+    Airship::JobSystem jobs(1);
+    for (Airship::JobSystem* system : {&jobs, static_cast<Airship::JobSystem*>(nullptr)}) {
+        Airship::TaskScheduler tasks(system);
+        std::optional<std::string> contents;
+        std::optional<std::string> missing = "";
+        tasks.Spawn([](Airship::TaskScheduler& tasks, const std::filesystem::path& path,
+                       std::optional<std::string>& contents, std::optional<std::string>& missing) -> Airship::Task<> {
+            contents = co_await tasks.ReadFile(path);
+            missing = co_await tasks.ReadFile(path.string() + ".missing");
+        }(tasks, path, contents, missing));
+        for (int frame = 0; frame < 1000 && tasks.TaskCount() > 0; ++frame) {
+            tasks.Update(0.016f);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        EXPECT_EQ(contents, "level data");
+        EXPECT_EQ(missing, std::nullopt);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(Task, Budget) {
+    Airship::TaskScheduler tasks;
+    int resumed = 0;
+    for (int i = 0; i < 3; ++i) {
+        tasks.Spawn([](int& resumed) -> Airship::Task<> {
+            ++resumed;
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            co_return;
+        }(resumed));
+    }
+    // Each resume overruns the budget, but one always gets through
+    for (int frame = 1; frame <= 3; ++frame) {
+        tasks.Update(0.016f, std::chrono::nanoseconds(0));
+        EXPECT_EQ(resumed, frame);
+    }
+}
+
+TEST(Task, DestroyedWhileSuspended) {
+    Airship::JobSystem jobs(1);
+    bool destroyed = false;
+    {
+        Airship::TaskScheduler tasks(&jobs);
+        struct Guard {
+            bool& destroyed;
+            ~Guard() { destroyed = true; }
+        };
+        tasks.Spawn([](Airship::TaskScheduler& tasks, bool& destroyed) -> Airship::Task<> {
+            const Guard guard{destroyed};
+            co_await tasks.RunJob([] { std::this_thread::sleep_for(std::chrono::milliseconds(5)); });
+            co_await tasks.Delay(100.0f);
+        }(tasks, destroyed));
+        tasks.Update(0.016f);
+        EXPECT_FALSE(destroyed);
+    }
+    EXPECT_TRUE(destroyed);
+}
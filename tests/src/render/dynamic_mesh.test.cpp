@@ -0,0 +1,58 @@
+#include "render/opengl/dynamic_mesh.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+using Range = Airship::DirtyRanges::Range;
+
+std::vector<Range> Ranges(const Airship::DirtyRanges& dirty) {
+    return {dirty.ranges().begin(), dirty.ranges().end()};
+}
+} // namespace
+
+TEST(DirtyRanges, Disjoint) {
+    Airship::DirtyRanges dirty;
+    EXPECT_TRUE(dirty.empty());
+    dirty.add(10, 12);
+    dirty.add(0, 2);
+    dirty.add(20, 21);
+    dirty.add(5, 5); // Empty, so ignored
+    EXPECT_EQ(Ranges(dirty), (std::vector<Range>{{0, 2}, {10, 12}, {20, 21}}));
+
+    dirty.clear();
+    EXPECT_TRUE(dirty.empty());
+}
+
+TEST(DirtyRanges, Merging) {
+    Airship::DirtyRanges dirty;
+    dirty.add(10, 12);
+    dirty.add(12, 14); // Touching
+    EXPECT_EQ(Ranges(dirty), (std::vector<Range>{{10, 14}}));
+    dirty.add(8, 10);
+    EXPECT_EQ(Ranges(dirty), (std::vector<Range>{{8, 14}}));
+    dirty.add(9, 11); // Already covered
+    EXPECT_EQ(Ranges(dirty), (std::vector<Range>{{8, 14}}));
+
+    // One range swallowing several
+    dirty.add(20, 22);
+    dirty.add(30, 32);
+    dirty.add(40, 42);
+    dirty.add(13, 31);
+    EXPECT_EQ(Ranges(dirty), (std::vector<Range>{{8, 32}, {40, 42}}));
+
+    dirty.addAll();
+    EXPECT_EQ(Ranges(dirty), (std::vector<Range>{{0, SIZE_MAX}}));
+}
+
+TEST(DirtyRanges, ManySingleElements) {
+    // Every other element, then the gaps, which should leave one range
+    Airship::DirtyRanges dirty;
+    for (size_t i = 0; i < 100; i += 2)
+        dirty.add(i, i + 1);
+    EXPECT_EQ(dirty.ranges().size(), 50);
+    for (size_t i = 1; i < 100; i += 2)
+        dirty.add(i, i + 1);
+    EXPECT_EQ(Ranges(dirty), (std::vector<Range>{{0, 100}}));
+}
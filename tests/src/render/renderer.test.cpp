@@ -1,14 +1,130 @@
 // #include "core/application.h"
 #include "render/opengl/renderer.h"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "core/utils.hpp"
 #include "core/window.h"
 #include "gtest/gtest.h"
+#include "render/color.h"
+#include "render/opengl/dynamic_mesh.h"
 #include "test/common.h"
 
+namespace {
+
+using VertexType = Airship::Utils::Point<float, 2>;
+using Pixel = std::array<uint8_t, 3>;
+
+// clang-format off
+// 2D positions at location 0, filled with the uColor uniform
+constexpr const char* UNIFORM_COLOR_VERTEX_SHADER =
+    "#version 330 core\n"
+    "layout (location = 0) in vec2 aPos;\n"
+    "void main()\n"
+    "{\n"
+    "   gl_Position = vec4(aPos, 0.0, 1.0);\n"
+    "}\0";
+constexpr const char* UNIFORM_COLOR_FRAGMENT_SHADER =
+    "#version 330 core\n"
+    "uniform vec4 uColor;\n"
+    "out vec4 FragColor;\n"
+    "void main()\n"
+    "{\n"
+    "   FragColor = uColor;\n"
+    "}\0";
+// 2D positions at location 0, and a color per vertex at location 1
+constexpr const char* VERTEX_COLOR_VERTEX_SHADER =
+    "#version 330 core\n"
+    "layout (location = 0) in vec2 aPos;\n"
+    "layout (location = 1) in vec4 aColor;\n"
+    "out vec4 vColor;\n"
+    "void main()\n"
+    "{\n"
+    "   gl_Position = vec4(aPos, 0.0, 1.0);\n"
+    "   vColor = aColor;\n"
+    "}\0";
+constexpr const char* VERTEX_COLOR_FRAGMENT_SHADER =
+    "#version 330 core\n"
+    "in vec4 vColor;\n"
+    "out vec4 FragColor;\n"
+    "void main()\n"
+    "{\n"
+    "   FragColor = vColor;\n"
+    "}\0";
+// clang-format on
+
+// The shaders are only needed until the program is linked
+Airship::Pipeline MakePipeline(const char* vertexShaderSource, const char* fragmentShaderSource,
+                               const std::vector<Airship::Pipeline::VertexAttributeDesc>& attributes) {
+    const Airship::Shader vertexShader(Airship::ShaderType::Vertex, vertexShaderSource);
+    const Airship::Shader fragmentShader(Airship::ShaderType::Fragment, fragmentShaderSource);
+    return {vertexShader, fragmentShader, attributes};
+}
+
+Airship::Pipeline UniformColorPipeline() {
+    return MakePipeline(UNIFORM_COLOR_VERTEX_SHADER, UNIFORM_COLOR_FRAGMENT_SHADER,
+                        {{.name = "Position", .location = 0, .format = Airship::ShaderDataType::Float2}});
+}
+
+Airship::Pipeline VertexColorPipeline() {
+    return MakePipeline(VERTEX_COLOR_VERTEX_SHADER, VERTEX_COLOR_FRAGMENT_SHADER,
+                        {{.name = "Position", .location = 0, .format = Airship::ShaderDataType::Float2},
+                         {.name = "Color", .location = 1, .format = Airship::ShaderDataType::Float4}});
+}
+
+// Tightly packed VertexType positions
+Airship::VertexAttributeStream PositionStream(const Airship::Buffer& buffer) {
+    return {.buffer = &buffer, .stride = sizeof(VertexType), .offset = 0, .format = Airship::ShaderDataType::Float2};
+}
+
+// A hidden window for the GL context, and a small target to render into and read back
+class Offscreen {
+public:
+    static constexpr int SIZE = 16;
+
+    explicit Offscreen(int width = SIZE, int height = SIZE) : m_App(64, 64, false) {
+        m_App.Run();
+        // The target needs the context, so it can only be created once the app is running
+        m_Target.emplace(width, height);
+    }
+
+    [[nodiscard]] const Airship::Renderer& renderer() const { return m_App.GetRenderer(); }
+    [[nodiscard]] Airship::RenderTarget& target() { return *m_Target; }
+
+    // Render into the cleared target, starting with fresh frame stats
+    void begin() const {
+        renderer().setRenderTarget(&*m_Target);
+        renderer().clear();
+        renderer().endFrame();
+    }
+
+    // Draw whatever is queued and wait for the target's contents. Requesting the readback flushes the queue.
+    [[nodiscard]] bool readback() {
+        if (!m_Target->requestReadback()) return false;
+        renderer().setRenderTarget(nullptr);
+        return m_Target->collectReadback(m_Pixels, true);
+    }
+
+    // From the last readback, with (0, 0) in the lower-left corner
+    [[nodiscard]] Pixel pixel(int x, int y) const {
+        const auto width = static_cast<size_t>(m_Target->width());
+        const size_t i = ((static_cast<size_t>(y) * width) + static_cast<size_t>(x)) * 4;
+        return {m_Pixels[i], m_Pixels[i + 1], m_Pixels[i + 2]};
+    }
+
+private:
+    Airship::Test::GameClass m_App;
+    std::optional<Airship::RenderTarget> m_Target;
+    std::vector<uint8_t> m_Pixels;
+};
+
+} // namespace
+
 TEST(Renderer, Init) {
     // Use Application code to handle getting a window
     Airship::Test::GameClass app;
@@ -101,3 +217,369 @@ TEST(Renderer, Init) {
     // TODO: Test some API to verify results without
     // windows, for CI tests.
 }
+
+TEST(Renderer, RenderTargetReadback) {
+    // Offscreen rendering only needs a context, not a visible window
+    constexpr int WIDTH = 32, HEIGHT = 16;
+    Offscreen offscreen(WIDTH, HEIGHT);
+    const Airship::Pipeline pipeline = UniformColorPipeline();
+    Airship::Material material(&pipeline);
+    material.SetUniform("uColor", Airship::Color{1.0f, 0.5f, 0.2f, 1.0f});
+
+    // Lower-left half of the target
+    const std::vector<VertexType> vertices = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {-1.0f, 1.0f}};
+    Airship::Buffer vertexBuffer;
+    vertexBuffer.update(vertices.size() * sizeof(VertexType), vertices.data());
+    Airship::Mesh mesh;
+    mesh.setAttributeStream("Position", PositionStream(vertexBuffer));
+    mesh.setVertexCount(static_cast<int>(vertices.size()));
+
+    const auto& renderer = offscreen.renderer();
+    Airship::RenderTarget& target = offscreen.target();
+    offscreen.begin();
+    renderer.draw(mesh, material);
+
+    // Two readbacks can be in flight at once
+    EXPECT_TRUE(target.requestReadback());
+    EXPECT_TRUE(target.requestReadback());
+    EXPECT_FALSE(target.requestReadback());
+    EXPECT_EQ(target.pendingReadbacks(), 2);
+    renderer.setRenderTarget(nullptr);
+
+    std::vector<uint8_t> pixels;
+    ASSERT_TRUE(target.collectReadback(pixels, true));
+    ASSERT_EQ(pixels.size(), size_t(WIDTH * HEIGHT * 4));
+
+    const auto expectPixel = [&](int x, int y, const Airship::Color& color) {
+        const size_t i = (static_cast<size_t>(y) * WIDTH + static_cast<size_t>(x)) * 4;
+        EXPECT_NEAR(pixels[i + 0], color.r * 255, 1.0);
+        EXPECT_NEAR(pixels[i + 1], color.g * 255, 1.0);
+        EXPECT_NEAR(pixels[i + 2], color.b * 255, 1.0);
+        EXPECT_NEAR(pixels[i + 3], color.a * 255, 1.0);
+    };
+    expectPixel(0, 0, {1.0f, 0.5f, 0.2f});
+    expectPixel(WIDTH - 1, HEIGHT - 1, Airship::Colors::CornflowerBlue);
+
+    EXPECT_TRUE(target.collectReadback(pixels, true));
+    EXPECT_FALSE(target.collectReadback(pixels, true));
+    EXPECT_EQ(target.pendingReadbacks(), 0);
+}
+
+TEST(Renderer, RenderQueue) {
+    Offscreen offscreen;
+    const Airship::Pipeline pipeline = UniformColorPipeline();
+    Airship::Material red(&pipeline);
+    red.SetUniform("uColor", Airship::Color{1.0f, 0.0f, 0.0f, 1.0f});
+    Airship::Material green(&pipeline);
+    green.SetUniform("uColor", Airship::Color{0.0f, 1.0f, 0.0f, 1.0f});
+
+    // The whole target, and its lower-left corner
+    const std::vector<VertexType> fullVertices = {{-1.0f, -1.0f}, {3.0f, -1.0f}, {-1.0f, 3.0f}};
+    const std::vector<VertexType> cornerVertices = {{-1.0f, -1.0f}, {0.0f, -1.0f}, {-1.0f, 0.0f}};
+    Airship::Buffer fullBuffer;
+    fullBuffer.update(fullVertices.size() * sizeof(VertexType), fullVertices.data());
+    Airship::Buffer cornerBuffer;
+    cornerBuffer.update(cornerVertices.size() * sizeof(VertexType), cornerVertices.data());
+    const auto makeMesh = [](const Airship::Buffer& buffer) {
+        Airship::Mesh mesh;
+        mesh.setAttributeStream("Position", PositionStream(buffer));
+        mesh.setVertexCount(3);
+        return mesh;
+    };
+    const Airship::Mesh full = makeMesh(fullBuffer);
+    const Airship::Mesh corner = makeMesh(cornerBuffer);
+
+    const auto& renderer = offscreen.renderer();
+    offscreen.begin();
+
+    // Interleaved materials and a higher layer first; the queue sorts both out
+    constexpr int DRAWS = 100;
+    renderer.submit(corner, green, 1);
+    for (int i = 0; i < DRAWS; ++i)
+        renderer.submit(full, i % 2 == 0 ? green : red);
+    renderer.submit(full, red);
+    renderer.endFrame();
+    const Airship::RenderStats& stats = renderer.frameStats();
+    EXPECT_EQ(stats.draws, DRAWS + 2);
+    EXPECT_EQ(stats.programBinds, 1);
+    EXPECT_LE(stats.uniformUploads, 3);
+    EXPECT_LE(stats.vertexArrayBinds, 3);
+
+    ASSERT_TRUE(offscreen.readback());
+    EXPECT_EQ(offscreen.pixel(1, 1), (Pixel{0, 255, 0}));
+    // Same layer, so either material could land last, but it's one of them
+    const Pixel background = offscreen.pixel(Offscreen::SIZE - 1, Offscreen::SIZE - 1);
+    EXPECT_TRUE(background == (Pixel{255, 0, 0}) || background == (Pixel{0, 255, 0}));
+}
+
+TEST(Renderer, Instancing) {
+    Offscreen offscreen;
+
+    // clang-format off
+    const char* vertexShaderSource =
+        "#version 330 core\n"
+        "layout (location = 0) in vec2 aPos;\n"
+        "layout (location = 1) in vec2 aOffset;\n"
+        "layout (location = 2) in vec4 aColor;\n"
+        "out vec4 vertexColor;\n"
+        "void main()\n"
+        "{\n"
+        "   gl_Position = vec4(aPos + aOffset, 0.0, 1.0);\n"
+        "   vertexColor = aColor;\n"
+        "}\0";
+    const char* fragmentShaderSource =
+        "#version 330 core\n"
+        "in vec4 vertexColor;\n"
+        "out vec4 FragColor;\n"
+        "void main()\n"
+        "{\n"
+        "   FragColor = vertexColor;\n"
+        "}\0";
+    // clang-format on
+    const Airship::Pipeline pipeline =
+        MakePipeline(vertexShaderSource, fragmentShaderSource,
+                     {{.name = "Position", .location = 0, .format = Airship::ShaderDataType::Float2},
+                      {.name = "Offset", .location = 1, .format = Airship::ShaderDataType::Float2},
+                      {.name = "Color", .location = 2, .format = Airship::ShaderDataType::Float4}});
+    const Airship::Material material(&pipeline);
+
+    // One square, drawn into each quarter of the target
+    const std::vector<VertexType> square = {{0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f},
+                                            {0.0f, 0.0f}, {1.0f, 1.0f}, {1.0f, 0.0f}};
+    const std::vector<VertexType> offsets = {{-1.0f, -1.0f}, {0.0f, -1.0f}, {-1.0f, 0.0f}, {0.0f, 0.0f}};
+    const std::vector<Airship::Color> colors = {
+        {1.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 1.0f, 1.0f}};
+    Airship::Buffer squareBuffer;
+    squareBuffer.update(square.size() * sizeof(VertexType), square.data());
+    Airship::Buffer offsetBuffer;
+    offsetBuffer.update(offsets.size() * sizeof(VertexType), offsets.data());
+    Airship::Buffer colorBuffer;
+    colorBuffer.update(colors.size() * sizeof(Airship::Color), colors.data());
+    Airship::Mesh mesh;
+    mesh.setAttributeStream("Position", PositionStream(squareBuffer));
+    mesh.setAttributeStream("Offset", {.buffer = &offsetBuffer,
+                                       .stride = sizeof(VertexType),
+                                       .offset = 0,
+                                       .format = Airship::ShaderDataType::Float2,
+                                       .divisor = 1});
+    mesh.setAttributeStream("Color", {.buffer = &colorBuffer,
+                                      .stride = sizeof(Airship::Color),
+                                      .offset = 0,
+                                      .format = Airship::ShaderDataType::Float4,
+                                      .divisor = 1});
+    mesh.setVertexCount(static_cast<int>(square.size()));
+    mesh.setInstanceCount(static_cast<int>(offsets.size()));
+
+    const auto& renderer = offscreen.renderer();
+    offscreen.begin();
+    renderer.submit(mesh, material);
+    renderer.endFrame();
+    EXPECT_EQ(renderer.frameStats().draws, 1);
+
+    ASSERT_TRUE(offscreen.readback());
+    constexpr int SIZE = Offscreen::SIZE;
+    EXPECT_EQ(offscreen.pixel(2, 2), (Pixel{255, 0, 0}));
+    EXPECT_EQ(offscreen.pixel(SIZE - 2, 2), (Pixel{0, 255, 0}));
+    EXPECT_EQ(offscreen.pixel(2, SIZE - 2), (Pixel{0, 0, 255}));
+    EXPECT_EQ(offscreen.pixel(SIZE - 2, SIZE - 2), (Pixel{255, 255, 255}));
+}
+
+TEST(Renderer, IndexedMeshes) {
+    Offscreen offscreen;
+    const Airship::Pipeline pipeline = UniformColorPipeline();
+    Airship::Material red(&pipeline);
+    red.SetUniform("uColor", Airship::Color{1.0f, 0.0f, 0.0f, 1.0f});
+    Airship::Material green(&pipeline);
+    green.SetUniform("uColor", Airship::Color{0.0f, 1.0f, 0.0f, 1.0f});
+
+    // Two quads, the left and right halves of the target, sharing one vertex and one index buffer
+    const std::vector<VertexType> vertices = {{-1.0f, -1.0f}, {-1.0f, 1.0f}, {0.0f, 1.0f}, {0.0f, -1.0f},
+                                              {0.0f, -1.0f},  {0.0f, 1.0f},  {1.0f, 1.0f}, {1.0f, -1.0f}};
+    const std::vector<uint32_t> indices = {0, 1, 2, 0, 2, 3};
+    Airship::Buffer vertexBuffer;
+    vertexBuffer.update(vertices.size() * sizeof(VertexType), vertices.data());
+    Airship::Buffer indexBuffer;
+    const Airship::IndexType indexType = indexBuffer.updateIndices(indices);
+    EXPECT_EQ(indexType, Airship::IndexType::UInt16);
+
+    Airship::Mesh left;
+    left.setAttributeStream("Position", PositionStream(vertexBuffer));
+    left.setIndexStream({.buffer = &indexBuffer, .type = indexType}, static_cast<int>(indices.size()));
+    Airship::Mesh right = left;
+    right.setBaseVertex(4);
+
+    const auto& renderer = offscreen.renderer();
+    offscreen.begin();
+    renderer.draw(left, red, false);
+    renderer.draw(right, green, false);
+
+    ASSERT_TRUE(offscreen.readback());
+    constexpr int SIZE = Offscreen::SIZE;
+    EXPECT_EQ(offscreen.pixel(2, SIZE / 2), (Pixel{255, 0, 0}));
+    EXPECT_EQ(offscreen.pixel(SIZE - 2, SIZE / 2), (Pixel{0, 255, 0}));
+
+    // Indices past 16 bits switch the whole buffer to 32-bit
+    Airship::Buffer wideBuffer;
+    EXPECT_EQ(wideBuffer.updateIndices(std::vector<uint32_t>{0, 1, 70000}), Airship::IndexType::UInt32);
+}
+
+TEST(Renderer, BufferUsage) {
+    Offscreen offscreen;
+    const Airship::Pipeline pipeline = VertexColorPipeline();
+    const Airship::Material material(&pipeline);
+
+    // One triangle covering the whole target
+    const std::vector<VertexType> vertices = {{-1.0f, -1.0f}, {3.0f, -1.0f}, {-1.0f, 3.0f}};
+    Airship::Buffer vertexBuffer;
+    vertexBuffer.update(vertices.size() * sizeof(VertexType), vertices.data());
+
+    const auto& renderer = offscreen.renderer();
+    using Airship::BufferUsage;
+    for (const auto usage : {BufferUsage::Static, BufferUsage::Dynamic, BufferUsage::Stream}) {
+        Airship::Buffer colorBuffer(usage);
+        EXPECT_EQ(colorBuffer.usage(), usage);
+        Airship::Mesh mesh;
+        mesh.setAttributeStream("Position", PositionStream(vertexBuffer));
+        mesh.setAttributeStream("Color", {.buffer = &colorBuffer,
+                                          .stride = sizeof(Airship::Color),
+                                          .offset = 0,
+                                          .format = Airship::ShaderDataType::Float4});
+        mesh.setVertexCount(static_cast<int>(vertices.size()));
+
+        // More updates than a stream buffer has regions, each drawn before the next
+        for (int frame = 0; frame < 5; ++frame) {
+            const float green = static_cast<float>(frame) / 4.0f;
+            std::vector<Airship::Color> colors(vertices.size(), Airship::Color{1.0f, green, 0.0f});
+            colorBuffer.update(colors.size() * sizeof(Airship::Color), colors.data());
+            if (frame == 4) {
+                // A ranged update of just the blue channels; the rest of the buffer has to survive it
+                const float blue = 1.0f;
+                for (size_t i = 0; i < colors.size(); ++i)
+                    colorBuffer.updateRange((i * sizeof(Airship::Color)) + offsetof(Airship::Color, b), sizeof(float),
+                                            &blue);
+            }
+
+            offscreen.begin();
+            renderer.draw(mesh, material, false);
+            ASSERT_TRUE(offscreen.readback());
+            const Pixel pixel = offscreen.pixel(0, 0);
+            EXPECT_EQ(pixel[0], 255);
+            EXPECT_NEAR(pixel[1], green * 255, 1.0);
+            EXPECT_EQ(pixel[2], frame == 4 ? 255 : 0);
+        }
+        EXPECT_EQ(colorBuffer.size(), vertices.size() * sizeof(Airship::Color));
+    }
+}
+
+TEST(Renderer, StreamBufferQueue) {
+    Offscreen offscreen;
+    const Airship::Pipeline pipeline = VertexColorPipeline();
+    const Airship::Material material(&pipeline);
+
+    // A quad in each quarter of the target, all in one vertex buffer
+    std::vector<VertexType> vertices;
+    for (const VertexType corner : {VertexType{-1.0f, -1.0f}, VertexType{0.0f, -1.0f}, VertexType{-1.0f, 0.0f},
+                                    VertexType{0.0f, 0.0f}}) {
+        for (const VertexType offset :
+             {VertexType{0.0f, 0.0f}, VertexType{0.0f, 1.0f}, VertexType{1.0f, 1.0f}, VertexType{1.0f, 0.0f}})
+            vertices.push_back(corner + offset);
+    }
+    Airship::Buffer vertexBuffer;
+    vertexBuffer.update(vertices.size() * sizeof(VertexType), vertices.data());
+
+    // Each quad rewrites the shared stream buffers just before it's submitted, more times than they have regions, so
+    // every draw has to keep the region that was current when it was submitted, even once the ring comes back round
+    const std::vector<Airship::Color> quadColors = {Airship::Colors::Red, Airship::Colors::Green, Airship::Colors::Blue,
+                                                    Airship::Colors::White};
+    Airship::Buffer colorBuffer(Airship::BufferUsage::Stream);
+    Airship::Buffer indexBuffer(Airship::BufferUsage::Stream);
+    std::vector<Airship::Mesh> meshes(quadColors.size());
+    const auto& renderer = offscreen.renderer();
+    offscreen.begin();
+    for (uint32_t quad = 0; quad < meshes.size(); ++quad) {
+        const std::vector<Airship::Color> colors(vertices.size(), quadColors[quad]);
+        colorBuffer.update(colors.size() * sizeof(Airship::Color), colors.data());
+        const uint32_t base = quad * 4;
+        const std::vector<uint32_t> indices = {base, base + 1, base + 2, base, base + 2, base + 3};
+        const Airship::IndexType indexType = indexBuffer.updateIndices(indices);
+
+        Airship::Mesh& mesh = meshes[quad];
+        mesh.setAttributeStream("Position", PositionStream(vertexBuffer));
+        mesh.setAttributeStream("Color", {.buffer = &colorBuffer,
+                                          .stride = sizeof(Airship::Color),
+                                          .offset = 0,
+                                          .format = Airship::ShaderDataType::Float4});
+        mesh.setIndexStream({.buffer = &indexBuffer, .type = indexType}, static_cast<int>(indices.size()));
+        renderer.submit(mesh, material);
+    }
+    renderer.endFrame();
+    EXPECT_EQ(renderer.frameStats().draws, 4);
+
+    ASSERT_TRUE(offscreen.readback());
+    constexpr int SIZE = Offscreen::SIZE;
+    EXPECT_EQ(offscreen.pixel(2, 2), (Pixel{255, 0, 0}));
+    EXPECT_EQ(offscreen.pixel(SIZE - 2, 2), (Pixel{0, 255, 0}));
+    EXPECT_EQ(offscreen.pixel(2, SIZE - 2), (Pixel{0, 0, 255}));
+    EXPECT_EQ(offscreen.pixel(SIZE - 2, SIZE - 2), (Pixel{255, 255, 255}));
+}
+
+TEST(Renderer, DynamicMesh) {
+    Offscreen offscreen;
+    const Airship::Pipeline pipeline = VertexColorPipeline();
+    const Airship::Material material(&pipeline);
+
+    // Two quads, the left and right halves of the target
+    Airship::DynamicMesh mesh;
+    auto& positions = mesh.addStream<VertexType>("Position", Airship::ShaderDataType::Float2);
+    auto& colors = mesh.addStream<Airship::Color>("Color", Airship::ShaderDataType::Float4);
+    for (const float left : {-1.0f, 0.0f}) {
+        for (const VertexType corner : {VertexType{0.0f, -1.0f}, VertexType{1.0f, -1.0f}, VertexType{1.0f, 1.0f},
+                                        VertexType{0.0f, -1.0f}, VertexType{1.0f, 1.0f}, VertexType{0.0f, 1.0f}}) {
+            positions.push_back(corner + VertexType{left, 0.0f});
+            colors.push_back(Airship::Colors::Red);
+        }
+    }
+    mesh.setVertexCount(static_cast<int>(positions.data().size()));
+
+    const auto render = [&] {
+        offscreen.begin();
+        mesh.draw(offscreen.renderer(), material);
+        return offscreen.readback();
+    };
+    constexpr int SIZE = Offscreen::SIZE;
+    ASSERT_TRUE(render());
+    EXPECT_EQ(offscreen.pixel(2, SIZE / 2), (Pixel{255, 0, 0}));
+    EXPECT_EQ(offscreen.pixel(SIZE - 2, SIZE / 2), (Pixel{255, 0, 0}));
+    EXPECT_TRUE(colors.dirtyRanges().empty());
+
+    // Only the right quad's colors are uploaded, and the left one has to be left as it was
+    for (size_t i = 6; i < 12; ++i)
+        colors.set(i, Airship::Colors::Green);
+    ASSERT_EQ(colors.dirtyRanges().ranges().size(), 1);
+    EXPECT_EQ(colors.dirtyRanges().ranges().front(), (Airship::DirtyRanges::Range{6, 12}));
+    EXPECT_TRUE(positions.dirtyRanges().empty());
+    ASSERT_TRUE(render());
+    EXPECT_EQ(offscreen.pixel(2, SIZE / 2), (Pixel{255, 0, 0}));
+    EXPECT_EQ(offscreen.pixel(SIZE - 2, SIZE / 2), (Pixel{0, 255, 0}));
+
+    // Appending one element at a time only reallocates the buffer when it doubles
+    Airship::OwningStream<float> stream(Airship::ShaderDataType::Float);
+    std::vector<size_t> sizes;
+    for (int i = 0; i < 1000; ++i) {
+        stream.push_back(static_cast<float>(i));
+        stream.sync();
+        if (sizes.empty() || sizes.back() != stream.buffer().size()) sizes.push_back(stream.buffer().size());
+    }
+    EXPECT_LE(sizes.size(), 11);
+    EXPECT_GE(stream.buffer().size(), 1000 * sizeof(float));
+
+    // Reserving up front means no reallocations at all
+    Airship::OwningStream<float> reserved(Airship::ShaderDataType::Float);
+    reserved.reserve(1000);
+    const size_t reservedSize = reserved.buffer().size();
+    for (int i = 0; i < 1000; ++i) {
+        reserved.push_back(static_cast<float>(i));
+        reserved.sync();
+    }
+    EXPECT_EQ(reserved.buffer().size(), reservedSize);
+}
@@ -0,0 +1,56 @@
+// Converts binary Profiling traces (see core/trace_format.h) to chrome-tracing/perfetto.ui JSON.
+// Usage: airship-trace <input.astrace> [output.json]
+
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+
+#include "core/trace_format.h"
+
+int main(int argc, char** argv) {
+    const std::span<char*> args(argv, argc);
+    if (args.size() < 2 || args.size() > 3) {
+        std::cerr << "Usage: " << args[0] << " <input.astrace> [output.json]\n";
+        return 1;
+    }
+
+    const std::string input = args[1];
+    std::string output = args.size() == 3 ? args[2] : input;
+    if (args.size() == 2) {
+        if (output.ends_with(".astrace")) output.resize(output.size() - std::string(".astrace").size());
+        output += ".json";
+    }
+
+    std::ifstream in(input, std::ios::binary);
+    if (!in) {
+        std::cerr << "Unable to open " << input << "\n";
+        return 1;
+    }
+
+    Airship::Profiling::BinaryTraceReader reader(in);
+    if (!reader.ok()) {
+        std::cerr << input << " is not an Airship binary trace\n";
+        return 1;
+    }
+
+    std::ofstream out(output);
+    if (!out) {
+        std::cerr << "Unable to open " << output << " for writing\n";
+        return 1;
+    }
+
+    size_t count = 0;
+    out << "{\"traceEvents\":[\n";
+    Airship::Profiling::BinaryTraceReader::Event e{};
+    while (reader.next(e)) {
+        Airship::Profiling::writeJsonEvent(out, e.name, e.type, e.timestamp * reader.nsPerTick(), e.tid, e.value);
+        ++count;
+    }
+    out << "{}]}";
+
+    // A truncated trace (e.g. from a crash mid-write) still converts up to the damaged record
+    if (!reader.ok()) std::cerr << "Warning: " << input << " is truncated or corrupt after " << count << " events\n";
+    std::cout << "Wrote " << count << " events to " << output << "\n";
+    return 0;
+}